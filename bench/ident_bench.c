@@ -0,0 +1,92 @@
+/*
+ * # Identifier classification
+ *
+ * Classifies the words of an identifier heavy corpus - keywords, builtins and
+ * plain names - as keyword or builtin, with the reserved word hash and with
+ * the strcmp chains it replaced.
+ */
+#include "../src/ast.c"
+#include "../src/builtin.c"
+
+#include <time.h>
+
+#define BENCH_WORDS (1 << 16)
+#define BENCH_ROUNDS 200
+
+static const char *const BENCH_CORPUS[] = {
+    "let",    "fib",   "x",     "if",     "return", "len",  "people",
+    "else",   "total", "fn",    "true",   "push",   "acc",  "false",
+    "result", "first", "rest",  "counter", "puts",  "i",    "last",
+    "map",    "reduce", "arr",  "gc_stats", "value", "key", "index",
+};
+
+static double bench_now_s() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the lookups as they were, for comparison
+static int bench_strcmp_lookup(const char *word) {
+    const char *const keywords[] = {
+        "let", "fn", "true", "false", "if", "else", "return",
+    };
+    for (int i = 0; i < 7; ++i) {
+        if (0 == strcmp(word, keywords[i]))
+            return i;
+    }
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        if (0 == strcmp(word, builtin_names[i]))
+            return 7 + i;
+    }
+    return -1;
+}
+
+static int bench_hash_lookup(const char *word, int len) {
+    enum tok_Type type = tok_lookup_identifier(word, len);
+    if (type != tok_IDENT)
+        return type;
+    obj_Object *builtin = builtin_from_keyword(word, len);
+    return builtin != NULL ? (int)builtin->m_builtin : -1;
+}
+
+int main() {
+    const int corpus_len = sizeof(BENCH_CORPUS) / sizeof(BENCH_CORPUS[0]);
+    const char **words = malloc(BENCH_WORDS * sizeof(char *));
+    int *lens = malloc(BENCH_WORDS * sizeof(int));
+    srand(42);
+    for (int i = 0; i < BENCH_WORDS; ++i) {
+        words[i] = BENCH_CORPUS[rand() % corpus_len];
+        lens[i] = strlen(words[i]);
+    }
+
+    long found = 0;
+    double start = bench_now_s();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        for (int i = 0; i < BENCH_WORDS; ++i) {
+            found += bench_strcmp_lookup(words[i]) != -1;
+        }
+    }
+    double strcmp_s = bench_now_s() - start;
+
+    start = bench_now_s();
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        for (int i = 0; i < BENCH_WORDS; ++i) {
+            found -= bench_hash_lookup(words[i], lens[i]) != -1;
+        }
+    }
+    double hash_s = bench_now_s() - start;
+
+    // both must agree on what's reserved
+    assert(found == 0);
+
+    double n = (double)BENCH_WORDS * BENCH_ROUNDS;
+    printf(
+        "ident: strcmp %.1f ns/word, hash %.1f ns/word\n",
+        strcmp_s / n * 1e9,
+        hash_s / n * 1e9
+    );
+    free(words);
+    free(lens);
+    return 0;
+}
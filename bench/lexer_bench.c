@@ -0,0 +1,76 @@
+/*
+ * # Lexer throughput
+ *
+ * Lexes large buffers of plain ascii source and prints MB/s, the target is at
+ * least 100MB/s. The generated source has the long names, deep indentation
+ * and long strings of machine written scripts. Build and run with
+ * `make bench`.
+ */
+#include "../src/lexer.c"
+
+#include <time.h>
+
+#define BENCH_INPUT_SIZE (64 * 1024 * 1024)
+#define BENCH_RUNS 3
+
+static const char BENCH_SOURCE[] = "\
+let fib = fn(x) {\n\
+    if (x < 2) { return x; } else { fib(x - 1) + fib(x - 2) }\n\
+};\n\
+let people = [{\"name\": \"Alice\", \"age\": 24}, {\"name\": \"Anna\"}];\n\
+let total = len(people) * 100 / 7 - 3;\n\
+if (total != 10 == !true) { puts(\"looks fine\"); }\n";
+
+static const char BENCH_GENERATED[] = "\
+        let customer_account_balance_after_monthly_interest = fn(amount) {\n\
+                return calculate_compound_interest_for_account(amount);\n\
+        };\n\
+        let generated_report_header_text = \"Customer account summary, \
+generated for the monthly statement\";\n\
+        puts(generated_report_header_text, \"                          \");\n";
+
+static double bench_now_s() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_lex(const char *name, const char *source, int source_len) {
+    // repeated snippets, without a NUL after them
+    char *input = malloc(BENCH_INPUT_SIZE);
+    int len = 0;
+    while (len + source_len <= BENCH_INPUT_SIZE) {
+        memcpy(input + len, source, source_len);
+        len += source_len;
+    }
+
+    double best = 0;
+    long tokens = 0;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        double start = bench_now_s();
+
+        tokens = 0;
+        struct lex_Lexer lexer = lex_Lexer_create_len(input, len);
+        while (lex_next_token(&lexer).type != tok_EOF) {
+            tokens++;
+        }
+
+        double mb_per_s = len / (1024.0 * 1024.0) / (bench_now_s() - start);
+        best = mb_per_s > best ? mb_per_s : best;
+    }
+
+    printf(
+        "lexer %s: %d MB, %ld tokens, %.1f MB/s\n",
+        name,
+        len / (1024 * 1024),
+        tokens,
+        best
+    );
+    free(input);
+}
+
+int main() {
+    bench_lex("handwritten", BENCH_SOURCE, sizeof(BENCH_SOURCE) - 1);
+    bench_lex("generated", BENCH_GENERATED, sizeof(BENCH_GENERATED) - 1);
+    return 0;
+}
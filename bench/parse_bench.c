@@ -0,0 +1,84 @@
+/*
+ * # Lexing and parsing
+ *
+ * Times lexing a large script up front into a token array, parsing that
+ * array, and parsing while streaming tokens from the lexer as the repl does.
+ * Build and run with `make bench`.
+ */
+#include "../src/parser.c"
+
+#include <time.h>
+
+#define BENCH_INPUT_SIZE (8 * 1024 * 1024)
+#define BENCH_RUNS 3
+
+static const char BENCH_SOURCE[] = "\
+let fib = fn(x) {\n\
+    if (x < 2) { return x; } else { fib(x - 1) + fib(x - 2) }\n\
+};\n\
+let people = [{\"name\": \"Alice\", \"age\": 24}, {\"name\": \"Anna\"}];\n\
+let total = len(people) * 100 / 7 - 3;\n\
+if (total != 10 == !true) { puts(\"looks fine\"); }\n";
+
+static double bench_now_s() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_parse(const char *input, int len, bool token_array) {
+    struct lex_Lexer lexer = lex_Lexer_create_len(input, len);
+    struct par_Parser *parser = token_array ? par_alloc_token_parser(&lexer)
+                                            : par_alloc_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+
+    double start = bench_now_s();
+    par_parse_program(parser, program);
+    double elapsed = bench_now_s() - start;
+
+    assert(stbds_arrlen(parser->errors_da) == 0);
+    par_free_parser(parser);
+    ast_free_program(program);
+    return elapsed;
+}
+
+static double bench_tokenize(const char *input, int len) {
+    struct lex_Lexer lexer = lex_Lexer_create_len(input, len);
+    double start = bench_now_s();
+    struct tok_Token *tokens_da = lex_tokenize(&lexer);
+    double elapsed = bench_now_s() - start;
+    stbds_arrfree(tokens_da);
+    return elapsed;
+}
+
+int main() {
+    char *input = malloc(BENCH_INPUT_SIZE);
+    int snippet_len = sizeof(BENCH_SOURCE) - 1;
+    int len = 0;
+    while (len + snippet_len <= BENCH_INPUT_SIZE) {
+        memcpy(input + len, BENCH_SOURCE, snippet_len);
+        len += snippet_len;
+    }
+
+    double lex = 1e9, parse = 1e9, stream = 1e9;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        double t = bench_tokenize(input, len);
+        lex = t < lex ? t : lex;
+        t = bench_parse(input, len, true);
+        parse = t < parse ? t : parse;
+        t = bench_parse(input, len, false);
+        stream = t < stream ? t : stream;
+    }
+
+    double mb = len / (1024.0 * 1024.0);
+    printf(
+        "parse: %.0f MB, lex to array %.1f MB/s, parse array %.1f MB/s, "
+        "lex and parse streaming %.1f MB/s\n",
+        mb,
+        mb / lex,
+        mb / parse,
+        mb / stream
+    );
+    free(input);
+    return 0;
+}
@@ -1,205 +1,36 @@
 #pragma once
 #include "ast.h"
 
-struct ast_Expr **ast_deepcpy_fn_params(struct ast_Expr **params) {
-    struct ast_Expr **res_da = NULL;
-
-    for (int i = 0; i < stbds_arrlen(params); ++i) {
-        struct ast_Expr *elem = ast_deepcopy_expr(params[i]);
-        stbds_arrput(res_da, elem);
+const char *ast_operator_str(enum ast_Operator op) {
+    switch (op) {
+#define __ENUMERATE_OPERATOR(op, str) \
+    case op: \
+        return str;
+        ENUMERATE_OPERATORS
+#undef __ENUMERATE_OPERATOR
     }
-    return res_da;
+    assert(0 && "unreachable");
 }
 
-struct ast_Expr *ast_deepcopy_expr(const struct ast_Expr *expr) {
-    if (expr == NULL)
-        return NULL;
-    struct ast_Expr *new_expr = malloc(sizeof(struct ast_Expr));
-    memcpy(new_expr, expr, sizeof(struct ast_Expr));
+struct ast_Expr *
+ast_alloc_expr(struct util_Arena *arena, enum ast_expr_tag tag) {
+    struct ast_Expr *expr = util_arena_alloc(arena, sizeof(struct ast_Expr));
+    expr->tag = tag;
 
-    switch (expr->tag) {
+    switch (tag) {
         case ast_IDENT_EXPR:
-        case ast_INT_LIT_EXPR:
-        case ast_BOOL_EXPR:
-        case ast_STR_LIT_EXPR:
-            break;
-
-        case ast_PREFIX_EXPR:
-            new_expr->data.pf.right = ast_deepcopy_expr(expr->data.pf.right);
+            expr->data.ident.value = NULL;
+            expr->data.ident.depth = AST_IDENT_UNRESOLVED;
+            expr->data.ident.slot = -1;
             break;
-
-        case ast_INFIX_EXPR:
-            new_expr->data.inf.left = ast_deepcopy_expr(expr->data.inf.left);
-            new_expr->data.inf.right = ast_deepcopy_expr(expr->data.inf.right);
-            break;
-
-        case ast_IF_EXPR:
-            new_expr->data.ife.cond = ast_deepcopy_expr(expr->data.ife.cond);
-            new_expr->data.ife.conseq =
-                ast_deepcopy_stmt(expr->data.ife.conseq);
-            new_expr->data.ife.alt = ast_deepcopy_stmt(expr->data.ife.alt);
-            break;
-
-        case ast_FN_LIT_EXPR: {
-            new_expr->data.fn_lit.params_da = NULL;
-            for (int i = 0; i < stbds_arrlen(expr->data.fn_lit.params_da);
-                 i++) {
-                struct ast_Expr *elem =
-                    ast_deepcopy_expr(expr->data.fn_lit.params_da[i]);
-                stbds_arrput(new_expr->data.fn_lit.params_da, elem);
-            }
-            new_expr->data.fn_lit.body =
-                ast_deepcopy_stmt(expr->data.fn_lit.body);
-            break;
-        }
-
-        case ast_CALL_EXPR: {
-            new_expr->data.call.func = ast_deepcopy_expr(expr->data.call.func);
-            new_expr->data.call.args_da = NULL;
-            for (int i = 0; i < stbds_arrlen(expr->data.call.args_da); i++) {
-                struct ast_Expr *elem =
-                    ast_deepcopy_expr(expr->data.call.args_da[i]);
-                stbds_arrput(new_expr->data.call.args_da, elem);
-            }
-            break;
-        }
-        case ast_ARR_LIT_EXPR:
-            new_expr->data.arr.elems_da = NULL;
-            for (int i = 0; i < stbds_arrlen(expr->data.arr.elems_da); i++) {
-                struct ast_Expr *elem =
-                    ast_deepcopy_expr(expr->data.arr.elems_da[i]);
-                stbds_arrput(new_expr->data.arr.elems_da, elem);
-            }
-            break;
-        case ast_IDX_EXPR:
-            new_expr->data.idx.left = ast_deepcopy_expr(expr->data.idx.left);
-            new_expr->data.idx.index = ast_deepcopy_expr(expr->data.idx.index);
-            break;
-        case ast_HASH_LIT_EXPR:
-            new_expr->data.hash.hash_da = NULL;
-            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); i++) {
-                struct ast_Hash_elem *elem =
-                    malloc(sizeof(struct ast_Hash_elem));
-                elem->key = ast_deepcopy_expr(expr->data.hash.hash_da[i]->key);
-                elem->val = ast_deepcopy_expr(expr->data.hash.hash_da[i]->val);
-                stbds_arrput(new_expr->data.hash.hash_da, elem);
-            }
-            break;
-    }
-
-    return new_expr;
-}
-
-struct ast_Stmt *ast_deepcopy_stmt(const struct ast_Stmt *stmt) {
-    if (stmt == NULL)
-        return NULL;
-
-    struct ast_Stmt *new_stmt = malloc(sizeof(struct ast_Stmt));
-    memcpy(new_stmt, stmt, sizeof(struct ast_Stmt));
-
-    switch (stmt->tag) {
-        case ast_LET_STMT:
-            new_stmt->data.let.name = ast_deepcopy_expr(stmt->data.let.name);
-            new_stmt->data.let.value = ast_deepcopy_expr(stmt->data.let.value);
-            break;
-        case ast_RET_STMT:
-            new_stmt->data.ret.ret_val =
-                ast_deepcopy_expr(stmt->data.ret.ret_val);
-            break;
-        case ast_EXPR_STMT:
-            new_stmt->data.expr.expr = ast_deepcopy_expr(stmt->data.expr.expr);
-            break;
-        case ast_BLOCK_STMT: {
-
-            new_stmt->data.block.stmts_da = NULL;
-            for (int i = 0; i < stbds_arrlen(stmt->data.block.stmts_da); i++) {
-                struct ast_Stmt *elem =
-                    ast_deepcopy_stmt(stmt->data.block.stmts_da[i]);
-                stbds_arrput(new_stmt->data.block.stmts_da, elem);
-            }
-            break;
-        }
-    }
-
-    return new_stmt;
-}
-
-void ast_free_expr(struct ast_Expr *expr) {
-    if (expr == NULL)
-        return;
-    switch (expr->tag) {
-        case ast_IDENT_EXPR:
         case ast_INT_LIT_EXPR:
         case ast_BOOL_EXPR:
-        case ast_STR_LIT_EXPR:
+        case ast_NULL_EXPR:
             // NOTHING
             break;
-        case ast_PREFIX_EXPR:
-            ast_free_expr(expr->data.pf.right);
-            break;
-        case ast_INFIX_EXPR:
-            ast_free_expr(expr->data.inf.left);
-            ast_free_expr(expr->data.inf.right);
-            break;
-        case ast_IF_EXPR:
-            ast_free_expr(expr->data.ife.cond);
-            ast_free_stmt(expr->data.ife.conseq);
-            ast_free_stmt(expr->data.ife.alt);
-            break;
-        case ast_FN_LIT_EXPR:
-            for (int i = 0; i < stbds_arrlen(expr->data.fn_lit.params_da);
-                 ++i) {
-                struct ast_Expr *param = expr->data.fn_lit.params_da[i];
-                ast_free_expr(param);
-            }
-            stbds_arrfree(expr->data.fn_lit.params_da);
-
-            ast_free_stmt(expr->data.fn_lit.body);
-            break;
-        case ast_CALL_EXPR:
-            for (int i = 0; i < stbds_arrlen(expr->data.call.args_da); ++i) {
-                struct ast_Expr *arg = expr->data.call.args_da[i];
-                ast_free_expr(arg);
-            }
-            stbds_arrfree(expr->data.call.args_da);
-
-            ast_free_expr(expr->data.call.func);
-            break;
-        case ast_ARR_LIT_EXPR:
-            for (int i = 0; i < stbds_arrlen(expr->data.arr.elems_da); ++i) {
-                struct ast_Expr *elem = expr->data.arr.elems_da[i];
-                ast_free_expr(elem);
-            }
-            stbds_arrfree(expr->data.arr.elems_da);
-            break;
-        case ast_IDX_EXPR:
-            ast_free_expr(expr->data.idx.left);
-            ast_free_expr(expr->data.idx.index);
-            break;
-        case ast_HASH_LIT_EXPR:
-            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); ++i) {
-                ast_free_expr(expr->data.hash.hash_da[i]->key);
-                ast_free_expr(expr->data.hash.hash_da[i]->val);
-            }
-
-            stbds_arrfree(expr->data.hash.hash_da);
-            break;
-        default:
-            assert(0 && "unreachable");
-    }
-    free(expr);
-};
-
-struct ast_Expr *ast_alloc_expr(enum ast_expr_tag tag) {
-    struct ast_Expr *expr = malloc(sizeof(struct ast_Expr));
-    expr->tag = tag;
-
-    switch (tag) {
-        case ast_IDENT_EXPR:
-        case ast_INT_LIT_EXPR:
-        case ast_BOOL_EXPR:
         case ast_STR_LIT_EXPR:
-            // NOTHING
+            expr->data.str.value = NULL;
+            expr->data.str.len = 0;
             break;
         case ast_PREFIX_EXPR:
             expr->data.pf.right = NULL;
@@ -216,12 +47,26 @@ struct ast_Expr *ast_alloc_expr(enum ast_expr_tag tag) {
         case ast_FN_LIT_EXPR:
             expr->data.fn_lit.params_da = NULL;
             expr->data.fn_lit.body = NULL;
+            expr->data.fn_lit.num_slots = 0;
+            util_arena_own_da(arena, &expr->data.fn_lit.params_da);
+            break;
+        case ast_CALL_EXPR:
+            expr->data.call.func = NULL;
+            expr->data.call.args_da = NULL;
+            expr->data.call.tail = false;
+            util_arena_own_da(arena, &expr->data.call.args_da);
             break;
         case ast_ARR_LIT_EXPR:
             expr->data.arr.elems_da = NULL;
+            util_arena_own_da(arena, &expr->data.arr.elems_da);
+            break;
+        case ast_IDX_EXPR:
+            expr->data.idx.left = NULL;
+            expr->data.idx.index = NULL;
             break;
         case ast_HASH_LIT_EXPR:
             expr->data.hash.hash_da = NULL;
+            util_arena_own_da(arena, &expr->data.hash.hash_da);
             break;
         default:
             assert(0 && "unreachable");
@@ -238,14 +83,27 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
             // FIXME: could be made simpler with gbString?
             str = gb_append_cstring(str, expr->data.ident.value);
             break;
-        case ast_INT_LIT_EXPR:
+        case ast_INT_LIT_EXPR: {
+            char num[16];
+            sprintf(num, "%d", expr->data.int_lit.value);
+            str = gb_append_cstring(str, num);
+            break;
+        }
         case ast_BOOL_EXPR:
+            str = gb_append_cstring(
+                str,
+                expr->data.boolean.value ? "true" : "false"
+            );
+            break;
         case ast_STR_LIT_EXPR:
-            str = gb_append_cstring(str, expr->token.literal);
+            str = gb_append_cstring(str, expr->data.str.value);
+            break;
+        case ast_NULL_EXPR:
+            str = gb_append_cstring(str, "null");
             break;
         case ast_PREFIX_EXPR:
             str = gb_append_cstring(str, "(");
-            str = gb_append_cstring(str, expr->data.pf.operator);
+            str = gb_append_cstring(str, ast_operator_str(expr->data.pf.op));
             str = gb_append_string(str, ast_make_expr_str(expr->data.pf.right));
             str = gb_append_cstring(str, ")");
             break;
@@ -253,7 +111,7 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
             str = gb_append_cstring(str, "(");
             str = gb_append_string(str, ast_make_expr_str(expr->data.inf.left));
             str = gb_append_cstring(str, " ");
-            str = gb_append_cstring(str, expr->data.inf.operator);
+            str = gb_append_cstring(str, ast_operator_str(expr->data.inf.op));
             str = gb_append_cstring(str, " ");
             str =
                 gb_append_string(str, ast_make_expr_str(expr->data.inf.right));
@@ -275,7 +133,7 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
             }
             break;
         case ast_FN_LIT_EXPR:
-            str = gb_append_cstring(str, expr->token.literal);
+            str = gb_append_cstring(str, "fn");
 
             str = gb_append_cstring(str, "(");
             struct ast_Expr **params = expr->data.fn_lit.params_da;
@@ -293,8 +151,10 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
             gbString body = ast_make_stmt_str(expr->data.fn_lit.body);
             str = gb_append_string(str, body);
             break;
-        case ast_CALL_EXPR:
-            str = gb_append_cstring(str, expr->data.call.func->token.literal);
+        case ast_CALL_EXPR: {
+            gbString func = ast_make_expr_str(expr->data.call.func);
+            str = gb_append_string(str, func);
+            gb_free_string(func);
             str = gb_append_cstring(str, "(");
 
             struct ast_Expr **args = expr->data.call.args_da;
@@ -310,6 +170,7 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
 
             str = gb_append_cstring(str, ")");
             break;
+        }
         case ast_ARR_LIT_EXPR:
             str = gb_append_cstring(str, "[");
             struct ast_Expr **elems = expr->data.arr.elems_da;
@@ -357,43 +218,9 @@ gbString ast_make_expr_str(struct ast_Expr *expr) {
     return str;
 }
 
-void ast_free_stmt(struct ast_Stmt *stmt) {
-    if (stmt == NULL)
-        return;
-
-    switch (stmt->tag) {
-        case ast_LET_STMT:
-            // FIXME: assert might not be needed
-            assert(
-                (stmt->data.let.name != NULL) &&
-                (stmt->data.let.name->tag == ast_IDENT_EXPR) &&
-                "let_stmt should have a identifier"
-            );
-            ast_free_expr(stmt->data.let.name);
-            ast_free_expr(stmt->data.let.value);
-            break;
-        case ast_RET_STMT:
-            ast_free_expr(stmt->data.ret.ret_val);
-            break;
-        case ast_EXPR_STMT:
-            ast_free_expr(stmt->data.expr.expr);
-            break;
-        case ast_BLOCK_STMT:
-            for (int i = 0; i < stbds_arrlen(stmt->data.block.stmts_da); ++i) {
-                struct ast_Stmt *stmt_ptr = stmt->data.block.stmts_da[i];
-                ast_free_stmt(stmt_ptr);
-            }
-            stbds_arrfree(stmt->data.block.stmts_da);
-            break;
-        default:
-            assert(0 && "unreachable");
-    }
-
-    free(stmt);
-}
-
-struct ast_Stmt *ast_alloc_stmt(enum ast_stmt_tag tag) {
-    struct ast_Stmt *stmt = malloc(sizeof(struct ast_Stmt));
+struct ast_Stmt *
+ast_alloc_stmt(struct util_Arena *arena, enum ast_stmt_tag tag) {
+    struct ast_Stmt *stmt = util_arena_alloc(arena, sizeof(struct ast_Stmt));
     stmt->tag = tag;
 
     switch (tag) {
@@ -409,6 +236,7 @@ struct ast_Stmt *ast_alloc_stmt(enum ast_stmt_tag tag) {
             break;
         case ast_BLOCK_STMT:
             stmt->data.block.stmts_da = NULL;
+            util_arena_own_da(arena, &stmt->data.block.stmts_da);
             break;
         default:
             assert(0 && "unreachable");
@@ -423,8 +251,7 @@ gbString ast_make_stmt_str(struct ast_Stmt *stmt) {
 
     switch (stmt->tag) {
         case ast_LET_STMT:
-            str = gb_append_cstring(str, stmt->token.literal);
-            str = gb_append_cstring(str, " ");
+            str = gb_append_cstring(str, "let ");
 
             gbString expr = ast_make_expr_str(stmt->data.let.name);
             str = gb_append_string(str, expr);
@@ -441,8 +268,7 @@ gbString ast_make_stmt_str(struct ast_Stmt *stmt) {
             str = gb_append_cstring(str, ";");
             break;
         case ast_RET_STMT:
-            str = gb_append_cstring(str, stmt->token.literal);
-            str = gb_append_cstring(str, " ");
+            str = gb_append_cstring(str, "return ");
 
             if (stmt->data.ret.ret_val != NULL) {
                 gbString expr = ast_make_expr_str(stmt->data.ret.ret_val);
@@ -478,31 +304,18 @@ gbString ast_make_stmt_str(struct ast_Stmt *stmt) {
 struct ast_Program *ast_alloc_program() {
     struct ast_Program *program = malloc(sizeof(struct ast_Program));
     program->statement_ptrs_da = NULL;
+    program->arena = util_alloc_arena();
     return program;
 };
 
-// FIXME: very weird code why only the first statements token literal
-char *ast_Program_token_literal(struct ast_Program *program) {
-    if (stbds_arrlen(program->statement_ptrs_da) > 0) {
-        struct ast_Stmt *stmt_ptr = program->statement_ptrs_da[0];
-        return (stmt_ptr->token.literal);
-    } else {
-        return "";
-    }
-}
-
 void ast_free_program(struct ast_Program *program) {
     if (program == NULL)
         return;
-    // travel all statements and free each type of statement
-    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
-        struct ast_Stmt *stmt = program->statement_ptrs_da[i];
-        ast_free_stmt(stmt);
-    }
-
-    // free statement_ptrs_da with stb
     stbds_arrfree(program->statement_ptrs_da);
 
+    // the nodes go with the arena, unless fn objects still hold it
+    util_arena_release(program->arena);
+
     // free program
     free(program);
 }
@@ -535,23 +348,27 @@ bool ast_is_expr_same(struct ast_Expr *a, struct ast_Expr *b) {
     // Then do deep comparison based on tag
     switch (a->tag) {
         case ast_IDENT_EXPR:
-            return strcmp(a->data.ident.value, b->data.ident.value) == 0;
+            // interned
+            return a->data.ident.value == b->data.ident.value;
 
         case ast_INT_LIT_EXPR:
             return a->data.int_lit.value == b->data.int_lit.value;
 
         case ast_PREFIX_EXPR:
-            return strcmp(a->data.pf.operator, b->data.pf.operator) == 0 &&
+            return a->data.pf.op == b->data.pf.op &&
                    ast_is_expr_same(a->data.pf.right, b->data.pf.right);
 
         case ast_INFIX_EXPR:
-            return strcmp(a->data.inf.operator, b->data.inf.operator) == 0 &&
+            return a->data.inf.op == b->data.inf.op &&
                    ast_is_expr_same(a->data.inf.left, b->data.inf.left) &&
                    ast_is_expr_same(a->data.inf.right, b->data.inf.right);
 
         case ast_BOOL_EXPR:
             return a->data.boolean.value == b->data.boolean.value;
 
+        case ast_NULL_EXPR:
+            return true;
+
         case ast_IF_EXPR:
             return ast_is_expr_same(a->data.ife.cond, b->data.ife.cond) &&
                    ast_is_stmt_same(a->data.ife.conseq, b->data.ife.conseq) &&
@@ -1,16 +1,55 @@
 #pragma once
 #include "malloc.h"
-#include "token.c"
 #include "util.c"
 
 #include <stdbool.h>
 
+/*
+ * # Nodes
+ *
+ * Nodes keep no tokens or inline literals - names and string literals are
+ * interned and operators are an enum - so the tree stays proportional to the
+ * source.
+ *
+ * Every node of a program is bump allocated in the program's arena and freed
+ * with it at once. Fn objects share their literal instead of copying it, so
+ * they keep a ref on the arena it is in.
+ */
+
+// ---------------------- Operator
+
+#define ENUMERATE_OPERATORS \
+    __ENUMERATE_OPERATOR(ast_OP_PLUS, "+") \
+    __ENUMERATE_OPERATOR(ast_OP_MINUS, "-") \
+    __ENUMERATE_OPERATOR(ast_OP_ASTERISK, "*") \
+    __ENUMERATE_OPERATOR(ast_OP_SLASH, "/") \
+    __ENUMERATE_OPERATOR(ast_OP_LT, "<") \
+    __ENUMERATE_OPERATOR(ast_OP_GT, ">") \
+    __ENUMERATE_OPERATOR(ast_OP_EQ, "==") \
+    __ENUMERATE_OPERATOR(ast_OP_NOT_EQ, "!=") \
+    __ENUMERATE_OPERATOR(ast_OP_BANG, "!")
+
+enum ast_Operator {
+#define __ENUMERATE_OPERATOR(op, str) op,
+    ENUMERATE_OPERATORS
+#undef __ENUMERATE_OPERATOR
+};
+
+enum {
+#define __ENUMERATE_OPERATOR(op, str) +1
+    ast_OPERATOR_COUNT = 0 ENUMERATE_OPERATORS
+#undef __ENUMERATE_OPERATOR
+};
+
+const char *ast_operator_str(enum ast_Operator op);
+
 // ---------------------- Expression
 
+#define AST_IDENT_UNRESOLVED (-1)
+#define AST_IDENT_BUILTIN (-2)
+
 // TODO: convert union to anonymous
 struct ast_Expr {
-    struct tok_Token token;
-
     enum ast_expr_tag {
         ast_IDENT_EXPR,
         ast_INT_LIT_EXPR,
@@ -24,11 +63,17 @@ struct ast_Expr {
         ast_ARR_LIT_EXPR,
         ast_IDX_EXPR,
         ast_HASH_LIT_EXPR,
+        ast_NULL_EXPR, // only made by the optimizer
     } tag;
 
     union {
         struct ast_Ident {
-            sstring value;
+            const char *value; // interned
+
+            // lexical address set by the resolver - the slot in the frame
+            // depth fns out, for builtins slot is the builtin instead
+            int depth;
+            int slot;
         } ident;
 
         struct ast_Int_lit {
@@ -36,13 +81,13 @@ struct ast_Expr {
         } int_lit;
 
         struct ast_Prefix {
-            sstring operator;
+            enum ast_Operator op;
             struct ast_Expr *right;
         } pf;
 
         struct ast_Infix {
             struct ast_Expr *left;
-            sstring operator;
+            enum ast_Operator op;
             struct ast_Expr *right;
         } inf;
 
@@ -60,16 +105,20 @@ struct ast_Expr {
             // dyn arr of identifier_ptrs -- always identifier expressions
             struct ast_Expr **params_da;
             struct ast_Stmt *body; // always block stmts
+            int num_slots; // frame size, set by the resolver
         } fn_lit;
 
         struct ast_Call {
             struct ast_Expr *func; // identifier or function expr
             // expr_ptrs da --not sure if its only identifiers or func exprs too
             struct ast_Expr **args_da;
+            // the last thing its fn does, set by the resolver
+            bool tail;
         } call;
 
         struct ast_Str_lit {
-            sstring value;
+            const char *value; // interned
+            int len;
         } str;
 
         struct ast_Arr_lit {
@@ -96,8 +145,6 @@ struct ast_Expr {
 
 // TODO: convert union to anonymous
 struct ast_Stmt {
-    struct tok_Token token;
-
     enum ast_stmt_tag {
         ast_LET_STMT,
         ast_RET_STMT,
@@ -128,13 +175,10 @@ struct ast_Stmt {
 
 gbString ast_make_stmt_str(struct ast_Stmt *stmt);
 
-struct ast_Stmt *ast_alloc_stmt(enum ast_stmt_tag tag);
-void ast_free_stmt(struct ast_Stmt *stmt);
-void ast_free_expr(struct ast_Expr *expr);
-
-struct ast_Expr *ast_deepcopy_expr(const struct ast_Expr *expr);
-struct ast_Stmt *ast_deepcopy_stmt(const struct ast_Stmt *stmt);
-struct ast_Expr **ast_deepcpy_fn_params(struct ast_Expr **params);
+struct ast_Expr *
+ast_alloc_expr(struct util_Arena *arena, enum ast_expr_tag tag);
+struct ast_Stmt *
+ast_alloc_stmt(struct util_Arena *arena, enum ast_stmt_tag tag);
 
 gbString ast_make_expr_str(struct ast_Expr *expr);
 gbString ast_make_stmt_str(struct ast_Stmt *stmt);
@@ -145,6 +189,7 @@ bool ast_is_stmt_same(struct ast_Stmt *a, struct ast_Stmt *b);
 struct ast_Program {
     // dynamic array of statement_ptrs
     struct ast_Stmt **statement_ptrs_da;
+    struct util_Arena *arena; // holds the nodes
 };
 
 typedef struct {
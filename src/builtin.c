@@ -1,163 +1,193 @@
 #pragma once
+#include "gc.c"
 #include "object.c"
+#include "token.c"
 #include "util.c"
 
-obj_Object *builtin_from_keyword(const char *keyword) {
-    obj_Object *obj = obj_alloc_object(obj_BUILTIN);
-
-    if (0 == strcmp(keyword, "len")) {
-        obj->m_builtin = BUILTIN_LEN;
-    } else if (0 == strcmp(keyword, "first")) {
-        obj->m_builtin = BUILTIN_FIRST;
-    } else if (0 == strcmp(keyword, "last")) {
-        obj->m_builtin = BUILTIN_LAST;
-    } else if (0 == strcmp(keyword, "rest")) {
-        obj->m_builtin = BUILTIN_REST;
-    } else if (0 == strcmp(keyword, "push")) {
-        obj->m_builtin = BUILTIN_PUSH;
-    } else if (0 == strcmp(keyword, "puts")) {
-        obj->m_builtin = BUILTIN_PUTS;
-    } else {
-        return NULL;
-    }
-
-    return obj;
+// builtin names indexed by builtin - also the compiler's builtin symbol order
+static const char *const builtin_names[] = {
+    [BUILTIN_LEN] = "len",     [BUILTIN_FIRST] = "first",
+    [BUILTIN_LAST] = "last",   [BUILTIN_REST] = "rest",
+    [BUILTIN_PUSH] = "push",   [BUILTIN_PUTS] = "puts",
+    [BUILTIN_GC_STATS] = "gc_stats",
+};
+
+#define BUILTIN_COUNT (int)(sizeof(builtin_names) / sizeof(builtin_names[0]))
+
+// Native builtin objects to be referenced by ptrs from the vm
+static obj_Object BUILTIN_OBJECTS[] = {
+    [BUILTIN_LEN] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_LEN },
+    [BUILTIN_FIRST] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_FIRST },
+    [BUILTIN_LAST] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_LAST },
+    [BUILTIN_REST] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_REST },
+    [BUILTIN_PUSH] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_PUSH },
+    [BUILTIN_PUTS] = { .type = obj_BUILTIN, .m_builtin = BUILTIN_PUTS },
+    [BUILTIN_GC_STATS] = { .type = obj_BUILTIN,
+                           .m_builtin = BUILTIN_GC_STATS },
+};
+
+static const struct tok_Word builtin_words[TOK_WORD_SLOTS] = {
+    TOK_WORD("len", 'l', 'n', BUILTIN_LEN),
+    TOK_WORD("first", 'f', 't', BUILTIN_FIRST),
+    TOK_WORD("last", 'l', 't', BUILTIN_LAST),
+    TOK_WORD("rest", 'r', 't', BUILTIN_REST),
+    TOK_WORD("push", 'p', 'h', BUILTIN_PUSH),
+    TOK_WORD("puts", 'p', 's', BUILTIN_PUTS),
+    TOK_WORD("gc_stats", 'g', 's', BUILTIN_GC_STATS),
+};
+
+// returns NULL if the name is no builtin
+obj_Object *builtin_from_keyword(const char *keyword, int len) {
+    int builtin = tok_lookup_word(builtin_words, keyword, len, -1);
+    return builtin == -1 ? NULL : &BUILTIN_OBJECTS[builtin];
 }
 
-obj_Object *builtin_eval_len(obj_Object **args) {
-    if (stbds_arrlen(args) != 1) {
+obj_Object *builtin_eval_len(obj_Object **args, int num_args) {
+    if (num_args != 1) {
         return obj_alloc_err_object(
             "wrong number of arguments. got=%d, want=1",
-            stbds_arrlen(args)
+            num_args
         );
     }
     obj_Object *arg = args[0];
 
-    obj_Object *obj = obj_alloc_object(obj_INTEGER);
-    switch (arg->type) {
+    switch (obj_type(arg)) {
         case obj_STRING:
-            obj->m_int = strlen(arg->m_str);
-            break;
+            return obj_int(obj_str_len(arg));
         case obj_ARRAY:
-            obj->m_int = stbds_arrlen(arg->m_arr_da);
-            break;
+            return obj_int(obj_arr_len(arg));
         default:
-            obj = obj_alloc_err_object(
+            return obj_alloc_err_object(
                 "argument to `len` not supported, got %s",
-                obj_object_name(arg->type)
+                obj_object_name(obj_type(arg))
             );
     }
-
-    return obj;
 }
 
-obj_Object *builtin_eval_first(obj_Object **args) {
-    if (stbds_arrlen(args) != 1) {
+obj_Object *builtin_eval_first(obj_Object **args, int num_args) {
+    if (num_args != 1) {
         return obj_alloc_err_object(
             "wrong number of arguments. got=%d, want=1",
-            stbds_arrlen(args)
+            num_args
         );
     }
 
     obj_Object *arr = args[0];
-    if (arr->type != obj_ARRAY) {
+    if (obj_type(arr) != obj_ARRAY) {
         return obj_alloc_err_object(
             "argument to `first` must be obj_ARRAY, got %s",
-            obj_object_name(arr->type)
+            obj_object_name(obj_type(arr))
         );
     }
 
-    if (stbds_arrlen(arr->m_arr_da) == 0) {
+    if (obj_arr_len(arr) == 0) {
         return obj_null();
     }
-    assert(stbds_arrlen(arr->m_arr_da) > 0);
-    return obj_deepcpy(arr->m_arr_da[0]);
+    return obj_arr_elems(arr)[0];
 }
 
-obj_Object *builtin_eval_last(obj_Object **args) {
-    if (stbds_arrlen(args) != 1) {
+obj_Object *builtin_eval_last(obj_Object **args, int num_args) {
+    if (num_args != 1) {
         return obj_alloc_err_object(
             "wrong number of arguments. got=%d, want=1",
-            stbds_arrlen(args)
+            num_args
         );
     }
 
     obj_Object *arr = args[0];
-    if (arr->type != obj_ARRAY) {
+    if (obj_type(arr) != obj_ARRAY) {
         return obj_alloc_err_object(
             "argument to `last` must be obj_ARRAY, got %s",
-            obj_object_name(arr->type)
+            obj_object_name(obj_type(arr))
         );
     }
 
-    int n = stbds_arrlen(arr->m_arr_da);
+    int n = obj_arr_len(arr);
     if (n == 0) {
         return obj_null();
     }
-    assert(n - 1 >= 0);
-    return obj_deepcpy(arr->m_arr_da[n - 1]);
+    return obj_arr_elems(arr)[n - 1];
 }
 
-obj_Object *builtin_eval_rest(obj_Object **args) {
-    if (stbds_arrlen(args) != 1) {
+obj_Object *builtin_eval_rest(obj_Object **args, int num_args) {
+    if (num_args != 1) {
         return obj_alloc_err_object(
             "wrong number of arguments. got=%d, want=1",
-            stbds_arrlen(args)
+            num_args
         );
     }
 
     obj_Object *arr = args[0];
-    if (arr->type != obj_ARRAY) {
+    if (obj_type(arr) != obj_ARRAY) {
         return obj_alloc_err_object(
             "argument to `rest` must be obj_ARRAY, got %s",
-            obj_object_name(arr->type)
+            obj_object_name(obj_type(arr))
         );
     }
 
-    int n = stbds_arrlen(arr->m_arr_da);
-    if (n == 0) {
+    if (obj_arr_len(arr) == 0) {
         return obj_null();
     }
 
-    obj_Object *obj = obj_alloc_object(obj_ARRAY);
-    for (int i = 1; i < n; ++i) {
-        obj_Object *elem = obj_deepcpy(arr->m_arr_da[i]);
-        stbds_arrput(obj->m_arr_da, elem);
-    }
-    return obj;
+    // a view of the same elements, nothing is copied
+    return obj_arr_rest(arr);
 }
 
-obj_Object *builtin_eval_push(obj_Object **args) {
-    if (stbds_arrlen(args) != 2) {
+obj_Object *builtin_eval_push(obj_Object **args, int num_args) {
+    if (num_args != 2) {
         return obj_alloc_err_object(
             "wrong number of arguments. got=%d, want=2",
-            stbds_arrlen(args)
+            num_args
         );
     }
 
     obj_Object *arr = args[0];
-    if (arr->type != obj_ARRAY) {
+    if (obj_type(arr) != obj_ARRAY) {
         return obj_alloc_err_object(
             "argument to `push` must be obj_ARRAY, got %s",
-            obj_object_name(arr->type)
+            obj_object_name(obj_type(arr))
         );
     }
 
-    int n = stbds_arrlen(arr->m_arr_da);
-
-    obj_Object *new_arr = obj_deepcpy(arr);
-    obj_Object *new_elem = obj_deepcpy(args[1]);
-    stbds_arrput(new_arr->m_arr_da, new_elem);
-
-    assert(stbds_arrlen(new_arr->m_arr_da) == n + 1);
-    return new_arr;
+    // elements are shared with the original array
+    return obj_arr_push(arr, args[1]);
 }
 
-obj_Object *builtin_eval_puts(obj_Object **args) {
-    int n = stbds_arrlen(args);
-    for (int i = 0; i < n; ++i) {
+obj_Object *builtin_eval_puts(obj_Object **args, int num_args) {
+    for (int i = 0; i < num_args; ++i) {
         printf("%s\n", obj_object_inspect(args[i]));
     }
 
     return NULL;
 }
+
+static void
+builtin_put_stat(obj_Object *hash, const char *name, long long val) {
+    obj_Object *key = obj_alloc_cstr(name);
+    obj_hash_put(hash, key, obj_int(val > INT_MAX ? INT_MAX : (int)val));
+}
+
+obj_Object *builtin_eval_gc_stats(obj_Object **args, int num_args) {
+    (void)args;
+    if (num_args != 0) {
+        return obj_alloc_err_object(
+            "wrong number of arguments. got=%d, want=0",
+            num_args
+        );
+    }
+
+    struct gc_Stats stats = gc_stats();
+    obj_Object *hash = obj_alloc_object(obj_HASH);
+    builtin_put_stat(hash, "collections", stats.collections);
+    builtin_put_stat(hash, "heap_bytes", stats.heap_bytes);
+    builtin_put_stat(hash, "freed_bytes", stats.freed_bytes);
+    builtin_put_stat(hash, "freed_objects", stats.freed_objects);
+    builtin_put_stat(hash, "threshold", gc_threshold());
+    builtin_put_stat(hash, "last_pause_us", stats.last_pause_us);
+    builtin_put_stat(hash, "total_pause_us", stats.total_pause_us);
+
+    struct util_Slab_stats slab = util_slab_stats();
+    builtin_put_stat(hash, "slab_allocs", slab.allocs);
+    builtin_put_stat(hash, "slab_mallocs", slab.mallocs);
+    return hash;
+}
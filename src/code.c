@@ -0,0 +1,194 @@
+#pragma once
+#include "util.c"
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/*
+ * # Bytecode
+ *
+ * Instructions are a flat dynamic array of bytes - an opcode byte followed by
+ * its operands. Operands are unsigned and big endian, their widths are fixed
+ * per opcode and listed in ENUMERATE_OPCODES as (opcode, width, width) where a
+ * width of 0 means no operand.
+ */
+
+#define ENUMERATE_OPCODES \
+    __ENUMERATE_OPCODE(op_CONSTANT, 4, 0) \
+    __ENUMERATE_OPCODE(op_POP, 0, 0) \
+    __ENUMERATE_OPCODE(op_ADD, 0, 0) \
+    __ENUMERATE_OPCODE(op_SUB, 0, 0) \
+    __ENUMERATE_OPCODE(op_MUL, 0, 0) \
+    __ENUMERATE_OPCODE(op_DIV, 0, 0) \
+    __ENUMERATE_OPCODE(op_TRUE, 0, 0) \
+    __ENUMERATE_OPCODE(op_FALSE, 0, 0) \
+    __ENUMERATE_OPCODE(op_NULL, 0, 0) \
+    __ENUMERATE_OPCODE(op_EQUAL, 0, 0) \
+    __ENUMERATE_OPCODE(op_NOT_EQUAL, 0, 0) \
+    __ENUMERATE_OPCODE(op_LESS_THAN, 0, 0) \
+    __ENUMERATE_OPCODE(op_GREATER_THAN, 0, 0) \
+    __ENUMERATE_OPCODE(op_MINUS, 0, 0) \
+    __ENUMERATE_OPCODE(op_BANG, 0, 0) \
+    __ENUMERATE_OPCODE(op_JUMP_NOT_TRUTHY, 4, 0) \
+    __ENUMERATE_OPCODE(op_JUMP, 4, 0) \
+    __ENUMERATE_OPCODE(op_GET_GLOBAL, 2, 0) \
+    __ENUMERATE_OPCODE(op_SET_GLOBAL, 2, 0) \
+    __ENUMERATE_OPCODE(op_GET_LOCAL, 2, 0) \
+    __ENUMERATE_OPCODE(op_SET_LOCAL, 2, 0) \
+    __ENUMERATE_OPCODE(op_GET_BUILTIN, 1, 0) \
+    __ENUMERATE_OPCODE(op_GET_FREE, 1, 0) \
+    __ENUMERATE_OPCODE(op_CURRENT_CLOSURE, 0, 0) \
+    __ENUMERATE_OPCODE(op_ARRAY, 4, 0) \
+    __ENUMERATE_OPCODE(op_HASH, 4, 0) \
+    __ENUMERATE_OPCODE(op_INDEX, 0, 0) \
+    __ENUMERATE_OPCODE(op_CALL, 1, 0) \
+    __ENUMERATE_OPCODE(op_TAIL_CALL, 1, 0) \
+    __ENUMERATE_OPCODE(op_RETURN_VALUE, 0, 0) \
+    __ENUMERATE_OPCODE(op_RETURN, 0, 0) \
+    __ENUMERATE_OPCODE(op_CLOSURE, 4, 1)
+
+enum code_Opcode {
+#define __ENUMERATE_OPCODE(op, w1, w2) op,
+    ENUMERATE_OPCODES
+#undef __ENUMERATE_OPCODE
+};
+
+#define CODE_MAX_OPERANDS 2
+
+struct code_Definition {
+    const char *name;
+    int operand_count;
+    int operand_widths[CODE_MAX_OPERANDS];
+};
+
+static const struct code_Definition code_definitions[] = {
+#define __ENUMERATE_OPCODE(op, w1, w2) \
+    [op] = { \
+        .name = #op, \
+        .operand_count = ((w1) != 0) + ((w2) != 0), \
+        .operand_widths = { w1, w2 }, \
+    },
+    ENUMERATE_OPCODES
+#undef __ENUMERATE_OPCODE
+};
+
+const struct code_Definition *code_lookup(uint8_t op) {
+    size_t n = sizeof(code_definitions) / sizeof(code_definitions[0]);
+    return op < n ? &code_definitions[op] : NULL;
+}
+
+static inline uint16_t code_read_u16(const uint8_t *ins) {
+    return (uint16_t)((ins[0] << 8) | ins[1]);
+}
+
+static inline uint32_t code_read_u32(const uint8_t *ins) {
+    return ((uint32_t)ins[0] << 24) | ((uint32_t)ins[1] << 16) |
+           ((uint32_t)ins[2] << 8) | (uint32_t)ins[3];
+}
+
+void code_write_operand(uint8_t *ins, int width, uint32_t operand) {
+    switch (width) {
+        case 4:
+            ins[0] = (uint8_t)(operand >> 24);
+            ins[1] = (uint8_t)(operand >> 16);
+            ins[2] = (uint8_t)(operand >> 8);
+            ins[3] = (uint8_t)operand;
+            break;
+        case 2:
+            ins[0] = (uint8_t)(operand >> 8);
+            ins[1] = (uint8_t)operand;
+            break;
+        case 1:
+            ins[0] = (uint8_t)operand;
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+uint32_t code_read_operand(const uint8_t *ins, int width) {
+    switch (width) {
+        case 4:
+            return code_read_u32(ins);
+        case 2:
+            return code_read_u16(ins);
+        case 1:
+            return ins[0];
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+// total length in bytes of an instruction of the given opcode
+int code_instruction_len(uint8_t op) {
+    const struct code_Definition *def = code_lookup(op);
+    assert(def != NULL);
+
+    int len = 1;
+    for (int i = 0; i < def->operand_count; ++i) {
+        len += def->operand_widths[i];
+    }
+    return len;
+}
+
+/*
+ * Appends an instruction to the instructions dyn arr, operands are passed as
+ * ints - as many as the opcode definition expects.
+ * Returns the position of the new instruction.
+ */
+int code_emit(uint8_t **ins_da, enum code_Opcode op, ...) {
+    const struct code_Definition *def = code_lookup(op);
+    assert(def != NULL);
+
+    int pos = stbds_arrlen(*ins_da);
+    uint8_t *ins = stbds_arraddnptr(*ins_da, code_instruction_len(op));
+    ins[0] = op;
+
+    va_list args;
+    va_start(args, op);
+    int offset = 1;
+    for (int i = 0; i < def->operand_count; ++i) {
+        int width = def->operand_widths[i];
+        code_write_operand(ins + offset, width, (uint32_t)va_arg(args, int));
+        offset += width;
+    }
+    va_end(args);
+
+    return pos;
+}
+
+// free after using
+gbString code_instructions_str(const uint8_t *ins_da) {
+    gbString str = gb_make_string("");
+
+    int i = 0;
+    while (i < stbds_arrlen(ins_da)) {
+        const struct code_Definition *def = code_lookup(ins_da[i]);
+        if (def == NULL) {
+            char line[64];
+            sprintf(line, "ERROR: opcode %d undefined\n", ins_da[i]);
+            str = gb_append_cstring(str, line);
+            i++;
+            continue;
+        }
+
+        char line[128];
+        int n = sprintf(line, "%04d %s", i, def->name);
+        int offset = 1;
+        for (int j = 0; j < def->operand_count; ++j) {
+            int width = def->operand_widths[j];
+            n += sprintf(
+                line + n,
+                " %" PRIu32,
+                code_read_operand(ins_da + i + offset, width)
+            );
+            offset += width;
+        }
+        sprintf(line + n, "\n");
+        str = gb_append_cstring(str, line);
+
+        i += offset;
+    }
+
+    return str;
+}
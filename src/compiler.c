@@ -0,0 +1,650 @@
+#pragma once
+#include "ast.h"
+#include "builtin.c"
+#include "code.c"
+#include "object.c"
+#include "resolver.c"
+
+#include <limits.h>
+#include <stdarg.h>
+
+/*
+ * # Compiler
+ *
+ * Lowers an ast_Program into bytecode for the vm - a flat instruction dyn arr
+ * plus a constant pool of obj_Objects (integers, strings and compiled fns).
+ * Identifiers are resolved at compile time through a chain of symbol tables,
+ * one per function scope, so the vm addresses variables by index.
+ */
+
+// ---------------------- Symbol table
+
+enum cmp_Symbol_scope {
+    cmp_GLOBAL_SCOPE,
+    cmp_LOCAL_SCOPE,
+    cmp_BUILTIN_SCOPE,
+    cmp_FREE_SCOPE,
+    cmp_FUNCTION_SCOPE, // the name of the function currently being compiled
+};
+
+struct cmp_Symbol {
+    char *name;
+    enum cmp_Symbol_scope scope;
+    int index;
+};
+
+struct cmp_Symbol_table {
+    struct cmp_Symbol_table *outer;
+    struct cmp_Symbol *store_da;
+    // symbols of enclosing scopes captured by this scope, in capture order
+    struct cmp_Symbol *free_symbols_da;
+    int num_definitions;
+};
+
+struct cmp_Symbol_table *
+cmp_alloc_symbol_table(struct cmp_Symbol_table *outer) {
+    struct cmp_Symbol_table *table = malloc(sizeof(struct cmp_Symbol_table));
+    table->outer = outer;
+    table->store_da = NULL;
+    table->free_symbols_da = NULL;
+    table->num_definitions = 0;
+    return table;
+}
+
+void cmp_free_symbol_table(struct cmp_Symbol_table *table) {
+    if (table == NULL)
+        return;
+    for (int i = 0; i < stbds_arrlen(table->store_da); ++i) {
+        free(table->store_da[i].name);
+    }
+    stbds_arrfree(table->store_da);
+    stbds_arrfree(table->free_symbols_da);
+    free(table);
+}
+
+// latest definition of the name in this table only
+struct cmp_Symbol *
+cmp_symbol_lookup(struct cmp_Symbol_table *table, const char *name) {
+    for (int i = stbds_arrlen(table->store_da) - 1; i >= 0; --i) {
+        if (strcmp(table->store_da[i].name, name) == 0) {
+            return &table->store_da[i];
+        }
+    }
+    return NULL;
+}
+
+struct cmp_Symbol cmp_symbol_put(
+    struct cmp_Symbol_table *table,
+    const char *name,
+    enum cmp_Symbol_scope scope,
+    int index
+) {
+    struct cmp_Symbol symbol = {
+        .name = util_str_deepcopy(name),
+        .scope = scope,
+        .index = index,
+    };
+    stbds_arrput(table->store_da, symbol);
+    return symbol;
+}
+
+struct cmp_Symbol
+cmp_symbol_define(struct cmp_Symbol_table *table, const char *name) {
+    enum cmp_Symbol_scope scope =
+        table->outer == NULL ? cmp_GLOBAL_SCOPE : cmp_LOCAL_SCOPE;
+
+    // rebinding a name in the same scope reuses its slot
+    struct cmp_Symbol *exists = cmp_symbol_lookup(table, name);
+    if (exists != NULL && exists->scope == scope) {
+        return *exists;
+    }
+    return cmp_symbol_put(table, name, scope, table->num_definitions++);
+}
+
+struct cmp_Symbol cmp_symbol_define_builtin(
+    struct cmp_Symbol_table *table,
+    int index,
+    const char *name
+) {
+    return cmp_symbol_put(table, name, cmp_BUILTIN_SCOPE, index);
+}
+
+struct cmp_Symbol cmp_symbol_define_function_name(
+    struct cmp_Symbol_table *table,
+    const char *name
+) {
+    return cmp_symbol_put(table, name, cmp_FUNCTION_SCOPE, 0);
+}
+
+struct cmp_Symbol
+cmp_symbol_define_free(struct cmp_Symbol_table *table, struct cmp_Symbol orig) {
+    stbds_arrput(table->free_symbols_da, orig);
+    return cmp_symbol_put(
+        table,
+        orig.name,
+        cmp_FREE_SCOPE,
+        stbds_arrlen(table->free_symbols_da) - 1
+    );
+}
+
+// returns false if the name is not defined in any enclosing scope
+bool cmp_symbol_resolve(
+    struct cmp_Symbol_table *table,
+    const char *name,
+    struct cmp_Symbol *res
+) {
+    struct cmp_Symbol *exists = cmp_symbol_lookup(table, name);
+    if (exists != NULL) {
+        *res = *exists;
+        return true;
+    }
+    if (table->outer == NULL) {
+        return false;
+    }
+
+    struct cmp_Symbol outer;
+    if (!cmp_symbol_resolve(table->outer, name, &outer)) {
+        return false;
+    }
+    if (outer.scope == cmp_GLOBAL_SCOPE || outer.scope == cmp_BUILTIN_SCOPE) {
+        *res = outer;
+        return true;
+    }
+
+    // local of an enclosing function - capture it as a free variable
+    *res = cmp_symbol_define_free(table, outer);
+    return true;
+}
+
+// returns NULL if no global has the index
+const char *cmp_global_name(struct cmp_Symbol_table *globals, int index) {
+    for (int i = 0; i < stbds_arrlen(globals->store_da); ++i) {
+        struct cmp_Symbol symbol = globals->store_da[i];
+        if (symbol.scope == cmp_GLOBAL_SCOPE && symbol.index == index) {
+            return symbol.name;
+        }
+    }
+    return NULL;
+}
+
+// the outermost table with all builtins defined
+struct cmp_Symbol_table *cmp_alloc_global_symbol_table() {
+    struct cmp_Symbol_table *table = cmp_alloc_symbol_table(NULL);
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        cmp_symbol_define_builtin(table, i, builtin_names[i]);
+    }
+    return table;
+}
+
+// ---------------------- Compiler
+
+struct cmp_Emitted_ins {
+    enum code_Opcode op;
+    int pos;
+};
+
+struct cmp_Scope {
+    uint8_t *instructions_da;
+    struct cmp_Emitted_ins last;
+    struct cmp_Emitted_ins prev;
+};
+
+struct cmp_Compiler {
+    obj_Object **constants_da; // shared with the caller, may be reallocated
+    struct cmp_Symbol_table *symbols;
+    struct cmp_Scope *scopes_da; // innermost scope is the last
+    gbString *errors_da; // dynamic arr of err_strings
+    struct util_Arena *arena; // of the program being compiled
+};
+
+struct cmp_Bytecode {
+    uint8_t *instructions_da;
+    obj_Object **constants_da;
+    struct cmp_Symbol_table *globals; // names of the globals, for errors
+};
+
+void cmp_compile_stmt(struct cmp_Compiler *compiler, struct ast_Stmt *stmt);
+void cmp_compile_expr(struct cmp_Compiler *compiler, struct ast_Expr *expr);
+
+// constructor - globals and constants are kept by the caller across compiles
+struct cmp_Compiler *cmp_alloc_compiler(
+    struct cmp_Symbol_table *globals,
+    obj_Object **constants_da
+) {
+    struct cmp_Compiler *compiler = malloc(sizeof(struct cmp_Compiler));
+    compiler->constants_da = constants_da;
+    compiler->symbols = globals;
+    compiler->scopes_da = NULL;
+    compiler->errors_da = NULL;
+    compiler->arena = NULL;
+
+    struct cmp_Scope main_scope = { .instructions_da = NULL };
+    stbds_arrput(compiler->scopes_da, main_scope);
+    return compiler;
+}
+
+void cmp_free_compiler(struct cmp_Compiler *compiler) {
+    if (compiler == NULL)
+        return;
+    for (int i = 0; i < stbds_arrlen(compiler->scopes_da); ++i) {
+        stbds_arrfree(compiler->scopes_da[i].instructions_da);
+    }
+    stbds_arrfree(compiler->scopes_da);
+    for (int i = 0; i < stbds_arrlen(compiler->errors_da); ++i) {
+        gb_free_string(compiler->errors_da[i]);
+    }
+    stbds_arrfree(compiler->errors_da);
+    free(compiler);
+}
+
+// the bytecode is valid as long as the compiler is not freed
+struct cmp_Bytecode cmp_bytecode(struct cmp_Compiler *compiler) {
+    return (struct cmp_Bytecode){
+        .instructions_da = stbds_arrlast(compiler->scopes_da).instructions_da,
+        .constants_da = compiler->constants_da,
+        .globals = compiler->symbols,
+    };
+}
+
+void cmp_error(struct cmp_Compiler *compiler, const char *format, ...) {
+    char msg[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg, sizeof(msg), format, args);
+    va_end(args);
+
+    stbds_arrput(compiler->errors_da, gb_make_string(msg));
+}
+
+struct cmp_Scope *cmp_curr_scope(struct cmp_Compiler *compiler) {
+    return &stbds_arrlast(compiler->scopes_da);
+}
+
+int cmp_add_constant(struct cmp_Compiler *compiler, obj_Object *obj) {
+    stbds_arrput(compiler->constants_da, obj);
+    return stbds_arrlen(compiler->constants_da) - 1;
+}
+
+int cmp_emit(struct cmp_Compiler *compiler, enum code_Opcode op, ...) {
+    struct cmp_Scope *scope = cmp_curr_scope(compiler);
+    const struct code_Definition *def = code_lookup(op);
+
+    int operands[CODE_MAX_OPERANDS] = { 0 };
+    va_list args;
+    va_start(args, op);
+    for (int i = 0; i < def->operand_count; ++i) {
+        operands[i] = va_arg(args, int);
+    }
+    va_end(args);
+
+    // too many args, locals, globals or free vars for the operand's width
+    for (int i = 0; i < def->operand_count; ++i) {
+        int width = def->operand_widths[i];
+        long long max = width < 4 ? (1LL << (8 * width)) - 1 : INT_MAX;
+        if (operands[i] < 0 || operands[i] > max) {
+            cmp_error(
+                compiler, "%s operand %d out of range (max %lld)", def->name,
+                operands[i], max
+            );
+        }
+    }
+
+    int pos = code_emit(&scope->instructions_da, op, operands[0], operands[1]);
+
+    scope->prev = scope->last;
+    scope->last = (struct cmp_Emitted_ins){ .op = op, .pos = pos };
+    return pos;
+}
+
+bool cmp_last_ins_is(struct cmp_Compiler *compiler, enum code_Opcode op) {
+    struct cmp_Scope *scope = cmp_curr_scope(compiler);
+    if (stbds_arrlen(scope->instructions_da) == 0) {
+        return false;
+    }
+    return scope->last.op == op;
+}
+
+void cmp_remove_last_pop(struct cmp_Compiler *compiler) {
+    struct cmp_Scope *scope = cmp_curr_scope(compiler);
+    stbds_arrsetlen(scope->instructions_da, scope->last.pos);
+    scope->last = scope->prev;
+}
+
+void cmp_replace_last_pop_with_return(struct cmp_Compiler *compiler) {
+    struct cmp_Scope *scope = cmp_curr_scope(compiler);
+    assert(scope->last.op == op_POP);
+    scope->instructions_da[scope->last.pos] = op_RETURN_VALUE;
+    scope->last.op = op_RETURN_VALUE;
+}
+
+// rewrites the single operand of an already emitted jump
+void cmp_patch_jump(struct cmp_Compiler *compiler, int pos, int target) {
+    uint8_t *ins = cmp_curr_scope(compiler)->instructions_da + pos;
+    const struct code_Definition *def = code_lookup(ins[0]);
+    assert(def->operand_count == 1);
+    code_write_operand(ins + 1, def->operand_widths[0], (uint32_t)target);
+}
+
+void cmp_enter_scope(struct cmp_Compiler *compiler) {
+    struct cmp_Scope scope = { .instructions_da = NULL };
+    stbds_arrput(compiler->scopes_da, scope);
+    compiler->symbols = cmp_alloc_symbol_table(compiler->symbols);
+}
+
+// caller owns the returned instructions
+uint8_t *cmp_leave_scope(struct cmp_Compiler *compiler) {
+    uint8_t *ins_da = stbds_arrpop(compiler->scopes_da).instructions_da;
+
+    struct cmp_Symbol_table *inner = compiler->symbols;
+    compiler->symbols = inner->outer;
+    cmp_free_symbol_table(inner);
+    return ins_da;
+}
+
+void cmp_load_symbol(struct cmp_Compiler *compiler, struct cmp_Symbol symbol) {
+    switch (symbol.scope) {
+        case cmp_GLOBAL_SCOPE:
+            cmp_emit(compiler, op_GET_GLOBAL, symbol.index);
+            break;
+        case cmp_LOCAL_SCOPE:
+            cmp_emit(compiler, op_GET_LOCAL, symbol.index);
+            break;
+        case cmp_BUILTIN_SCOPE:
+            cmp_emit(compiler, op_GET_BUILTIN, symbol.index);
+            break;
+        case cmp_FREE_SCOPE:
+            cmp_emit(compiler, op_GET_FREE, symbol.index);
+            break;
+        case cmp_FUNCTION_SCOPE:
+            cmp_emit(compiler, op_CURRENT_CLOSURE);
+            break;
+    }
+}
+
+// compiles a block whose value is left on the stack
+void cmp_compile_block_expr(
+    struct cmp_Compiler *compiler,
+    struct ast_Stmt *block
+) {
+    cmp_compile_stmt(compiler, block);
+
+    if (cmp_last_ins_is(compiler, op_POP)) {
+        cmp_remove_last_pop(compiler);
+    } else if (!cmp_last_ins_is(compiler, op_RETURN_VALUE)) {
+        cmp_emit(compiler, op_NULL);
+    }
+}
+
+void cmp_compile_if_expr(struct cmp_Compiler *compiler, struct ast_Expr *expr) {
+    cmp_compile_expr(compiler, expr->data.ife.cond);
+
+    // placeholder target, patched once the consequence is compiled
+    int jump_not_truthy_pos = cmp_emit(compiler, op_JUMP_NOT_TRUTHY, 0);
+    cmp_compile_block_expr(compiler, expr->data.ife.conseq);
+
+    int jump_pos = cmp_emit(compiler, op_JUMP, 0);
+    cmp_patch_jump(
+        compiler,
+        jump_not_truthy_pos,
+        stbds_arrlen(cmp_curr_scope(compiler)->instructions_da)
+    );
+
+    if (expr->data.ife.alt == NULL) {
+        cmp_emit(compiler, op_NULL);
+    } else {
+        cmp_compile_block_expr(compiler, expr->data.ife.alt);
+    }
+    cmp_patch_jump(
+        compiler,
+        jump_pos,
+        stbds_arrlen(cmp_curr_scope(compiler)->instructions_da)
+    );
+}
+
+void cmp_compile_fn_lit(
+    struct cmp_Compiler *compiler,
+    struct ast_Expr *expr,
+    const char *name // binding name for recursive calls, could be NULL
+) {
+    cmp_enter_scope(compiler);
+
+    if (name != NULL) {
+        cmp_symbol_define_function_name(compiler->symbols, name);
+    }
+
+    struct ast_Expr **params = expr->data.fn_lit.params_da;
+    for (int i = 0; i < stbds_arrlen(params); ++i) {
+        cmp_symbol_define(compiler->symbols, params[i]->data.ident.value);
+    }
+
+    // the vm reuses the frame for calls whose value is returned
+    res_mark_tail_stmt(expr->data.fn_lit.body, true);
+    cmp_compile_stmt(compiler, expr->data.fn_lit.body);
+
+    // implicit return of the last expression
+    if (cmp_last_ins_is(compiler, op_POP)) {
+        cmp_replace_last_pop_with_return(compiler);
+    }
+    if (!cmp_last_ins_is(compiler, op_RETURN_VALUE)) {
+        cmp_emit(compiler, op_RETURN);
+    }
+
+    struct cmp_Symbol *free_symbols_da = NULL;
+    for (int i = 0; i < stbds_arrlen(compiler->symbols->free_symbols_da); ++i) {
+        stbds_arrput(free_symbols_da, compiler->symbols->free_symbols_da[i]);
+    }
+    int num_locals = compiler->symbols->num_definitions;
+    uint8_t *ins_da = cmp_leave_scope(compiler);
+
+    // captured values are pushed for op_CLOSURE to pick up
+    for (int i = 0; i < stbds_arrlen(free_symbols_da); ++i) {
+        cmp_load_symbol(compiler, free_symbols_da[i]);
+    }
+
+    obj_Object *fn = obj_alloc_object(obj_COMPILED_FUNCTION);
+    fn->m_compiled_fn->instructions_da = ins_da;
+    fn->m_compiled_fn->num_locals = num_locals;
+    fn->m_compiled_fn->num_params = stbds_arrlen(params);
+    fn->m_compiled_fn->lit = expr;
+    fn->m_compiled_fn->arena = util_arena_retain(compiler->arena);
+    fn->m_compiled_fn->params = params;
+    fn->m_compiled_fn->body = expr->data.fn_lit.body;
+
+    cmp_emit(
+        compiler,
+        op_CLOSURE,
+        cmp_add_constant(compiler, fn),
+        (int)stbds_arrlen(free_symbols_da)
+    );
+    stbds_arrfree(free_symbols_da);
+}
+
+enum code_Opcode cmp_infix_opcode(enum ast_Operator op) {
+    switch (op) {
+        case ast_OP_PLUS:
+            return op_ADD;
+        case ast_OP_MINUS:
+            return op_SUB;
+        case ast_OP_ASTERISK:
+            return op_MUL;
+        case ast_OP_SLASH:
+            return op_DIV;
+        case ast_OP_LT:
+            return op_LESS_THAN;
+        case ast_OP_GT:
+            return op_GREATER_THAN;
+        case ast_OP_EQ:
+            return op_EQUAL;
+        case ast_OP_NOT_EQ:
+            return op_NOT_EQUAL;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+void cmp_compile_expr(struct cmp_Compiler *compiler, struct ast_Expr *expr) {
+    if (expr == NULL) {
+        cmp_error(compiler, "invalid expression");
+        return;
+    }
+
+    obj_Object *obj = NULL;
+    struct cmp_Symbol symbol;
+    switch (expr->tag) {
+        case ast_INT_LIT_EXPR:
+            obj = obj_int(expr->data.int_lit.value);
+            cmp_emit(compiler, op_CONSTANT, cmp_add_constant(compiler, obj));
+            break;
+        case ast_STR_LIT_EXPR:
+            obj = obj_alloc_interned_str(
+                expr->data.str.value,
+                expr->data.str.len
+            );
+            cmp_emit(compiler, op_CONSTANT, cmp_add_constant(compiler, obj));
+            break;
+        case ast_BOOL_EXPR:
+            cmp_emit(compiler, expr->data.boolean.value ? op_TRUE : op_FALSE);
+            break;
+        case ast_NULL_EXPR:
+            cmp_emit(compiler, op_NULL);
+            break;
+        case ast_PREFIX_EXPR:
+            cmp_compile_expr(compiler, expr->data.pf.right);
+            if (expr->data.pf.op == ast_OP_BANG) {
+                cmp_emit(compiler, op_BANG);
+            } else {
+                assert(expr->data.pf.op == ast_OP_MINUS);
+                cmp_emit(compiler, op_MINUS);
+            }
+            break;
+        case ast_INFIX_EXPR:
+            cmp_compile_expr(compiler, expr->data.inf.left);
+            cmp_compile_expr(compiler, expr->data.inf.right);
+            cmp_emit(compiler, cmp_infix_opcode(expr->data.inf.op));
+            break;
+        case ast_IF_EXPR:
+            cmp_compile_if_expr(compiler, expr);
+            break;
+        case ast_IDENT_EXPR:
+            if (!cmp_symbol_resolve(
+                    compiler->symbols,
+                    expr->data.ident.value,
+                    &symbol
+                )) {
+                cmp_error(
+                    compiler,
+                    "identifier not found: %s",
+                    expr->data.ident.value
+                );
+                break;
+            }
+            cmp_load_symbol(compiler, symbol);
+            break;
+        case ast_FN_LIT_EXPR:
+            cmp_compile_fn_lit(compiler, expr, NULL);
+            break;
+        case ast_CALL_EXPR:
+            cmp_compile_expr(compiler, expr->data.call.func);
+            for (int i = 0; i < stbds_arrlen(expr->data.call.args_da); ++i) {
+                cmp_compile_expr(compiler, expr->data.call.args_da[i]);
+            }
+            cmp_emit(
+                compiler,
+                expr->data.call.tail ? op_TAIL_CALL : op_CALL,
+                (int)stbds_arrlen(expr->data.call.args_da)
+            );
+            break;
+        case ast_ARR_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.arr.elems_da); ++i) {
+                cmp_compile_expr(compiler, expr->data.arr.elems_da[i]);
+            }
+            cmp_emit(
+                compiler,
+                op_ARRAY,
+                (int)stbds_arrlen(expr->data.arr.elems_da)
+            );
+            break;
+        case ast_IDX_EXPR:
+            cmp_compile_expr(compiler, expr->data.idx.left);
+            cmp_compile_expr(compiler, expr->data.idx.index);
+            cmp_emit(compiler, op_INDEX);
+            break;
+        case ast_HASH_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); ++i) {
+                cmp_compile_expr(compiler, expr->data.hash.hash_da[i]->key);
+                cmp_compile_expr(compiler, expr->data.hash.hash_da[i]->val);
+            }
+            cmp_emit(
+                compiler,
+                op_HASH,
+                (int)stbds_arrlen(expr->data.hash.hash_da) * 2
+            );
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+void cmp_compile_stmt(struct cmp_Compiler *compiler, struct ast_Stmt *stmt) {
+    struct cmp_Symbol symbol;
+    struct ast_Expr *value = NULL;
+    switch (stmt->tag) {
+        case ast_EXPR_STMT:
+            cmp_compile_expr(compiler, stmt->data.expr.expr);
+            cmp_emit(compiler, op_POP);
+            break;
+        case ast_BLOCK_STMT:
+            for (int i = 0; i < stbds_arrlen(stmt->data.block.stmts_da); ++i) {
+                cmp_compile_stmt(compiler, stmt->data.block.stmts_da[i]);
+            }
+            break;
+        case ast_RET_STMT:
+            cmp_compile_expr(compiler, stmt->data.ret.ret_val);
+            cmp_emit(compiler, op_RETURN_VALUE);
+            break;
+        case ast_LET_STMT:
+            value = stmt->data.let.value;
+            if (value != NULL && value->tag == ast_FN_LIT_EXPR) {
+                cmp_compile_fn_lit(
+                    compiler,
+                    value,
+                    stmt->data.let.name->data.ident.value
+                );
+            } else {
+                cmp_compile_expr(compiler, value);
+            }
+
+            symbol = cmp_symbol_define(
+                compiler->symbols,
+                stmt->data.let.name->data.ident.value
+            );
+            if (symbol.scope == cmp_GLOBAL_SCOPE) {
+                cmp_emit(compiler, op_SET_GLOBAL, symbol.index);
+            } else {
+                cmp_emit(compiler, op_SET_LOCAL, symbol.index);
+            }
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+// globals are defined up front like the resolver does
+void cmp_compile_program(
+    struct cmp_Compiler *compiler,
+    struct ast_Program *program
+) {
+    compiler->arena = program->arena;
+    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
+        struct ast_Stmt *stmt = program->statement_ptrs_da[i];
+        if (stmt->tag == ast_LET_STMT) {
+            cmp_symbol_define(
+                compiler->symbols,
+                stmt->data.let.name->data.ident.value
+            );
+        }
+    }
+    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
+        cmp_compile_stmt(compiler, program->statement_ptrs_da[i]);
+    }
+}
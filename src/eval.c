@@ -1,5 +1,97 @@
+#pragma once
 #include "eval.h"
 
+#include <limits.h>
+
+// call args only live for the call, they are bump allocated and rewound after
+static struct util_Arena EVAL_SCRATCH = { .refcount = 1 };
+
+// the arena of the ast being evaluated, fn objects made from it keep a ref
+static struct util_Arena *EVAL_ARENA = NULL;
+
+/*
+ * # Frame stack
+ *
+ * Calls, blocks, ifs and every expr with operands are evaluated on a stack of
+ * frames on the heap instead of by recursing, so how deep a program recurses
+ * doesn't depend on the c stack. A frame which needs the value of an operand
+ * pushes a frame for it and is stepped again with the value once that one
+ * returns. Leaves - literals, identifiers and fn literals - and operators on
+ * leaves are evaluated in place, and an if or a call hands its frame over to
+ * the block or fn body it runs.
+ *
+ * The gc only collects when a fn body starts or between the program's
+ * statements, so operands are only rooted once a frame is pushed after them.
+ *
+ * A call past the max depth, or any frame past EVAL_MAX_FRAMES, evaluates to
+ * a "stack overflow" error. By default only EVAL_MAX_FRAMES limits the depth.
+ */
+#define EVAL_MAX_FRAMES (1 << 20)
+
+enum eval_Frame_tag {
+    eval_FRAME_EXPR,
+    eval_FRAME_STMTS, // of a block or the program
+    eval_FRAME_FUNC, // a fn body, and the bodies of the tail calls it ends in
+    eval_FRAME_OVERFLOW, // pushed instead of a frame past EVAL_MAX_FRAMES
+};
+
+struct eval_Frame {
+    enum eval_Frame_tag tag;
+    int step; // times the frame was stepped, operands evaluated for an expr
+    int roots; // gc root stack depth before the frame rooted anything
+    obj_Env *env;
+    union {
+        struct ast_Expr *expr;
+        struct {
+            struct ast_Stmt **stmts;
+            int len;
+            bool prg; // returns are unwrapped
+        };
+    };
+
+    // a left operand, the callee, the hash being filled or the block's value
+    obj_Object *tmp;
+    union {
+        obj_Object *key; // of the hash elem being evaluated
+        struct util_Arena *arena; // EVAL_ARENA of the fn's caller
+    };
+    obj_Object **args; // call args and array elems, in EVAL_SCRATCH
+    struct util_Arena_mark scratch;
+    int rooted; // operands of a call or array rooted so far
+};
+
+static struct {
+    struct eval_Frame *frames_da;
+    int depth; // fn bodies running
+    int max_depth;
+} EVAL_STACK = { .max_depth = INT_MAX };
+
+// returned by a step which left a frame to run before it's done
+static obj_Object EVAL_RUNNING = { .type = obj_NULL };
+
+/*
+ * # Tail calls
+ *
+ * A call the resolver marked as tail doesn't run the fn itself. It leaves the
+ * fn and its new env in EVAL_TAIL and returns EVAL_TAIL_CALL, which unwinds
+ * like a return value to the frame running the caller's body, and that one
+ * runs the new body in its place. So tail recursion, mutual too, runs in
+ * constant space and only the envs still referenced stay alive.
+ */
+static obj_Object EVAL_TAIL_CALL = { .type = obj_RETURN_VALUE };
+static struct {
+    obj_Object *func;
+    obj_Env *env;
+} EVAL_TAIL;
+
+void eval_set_max_depth(int max_depth) {
+    EVAL_STACK.max_depth = max_depth;
+}
+
+int eval_max_depth() {
+    return EVAL_STACK.max_depth;
+}
+
 obj_Object *eval_bang_operator_expr(obj_Object *right) {
     if (obj_is_same(right, &TRUE_OBJECT)) {
         return obj_native_bool_object(false);
@@ -13,461 +105,799 @@ obj_Object *eval_bang_operator_expr(obj_Object *right) {
 }
 
 obj_Object *eval_minus_operator_prefix_expr(obj_Object *right) {
-    if (right->type != obj_INTEGER) {
+    if (obj_type(right) != obj_INTEGER) {
         obj_Object *res = obj_alloc_err_object(
             "unknown operator: -%s",
-            obj_object_name(right->type)
+            obj_object_name(obj_type(right))
         );
-        obj_free_object(right);
         return res;
+    } else if (obj_int_val(right) == INT_MIN) {
+        return obj_alloc_err_object("integer overflow: -(%d)", INT_MIN);
     }
 
-    right->m_int = -right->m_int;
-    return right;
+    return obj_int(-obj_int_val(right));
 }
 
-obj_Object *eval_prefix_expr(char *operator, obj_Object * right) {
-    if (strcmp(operator, "!") == 0) {
-        return eval_bang_operator_expr(right);
-    } else if (strcmp(operator, "-") == 0) {
-        return eval_minus_operator_prefix_expr(right);
-    } else {
-        obj_Object *res = obj_alloc_err_object(
-            "unknown operator: %s%s",
-            operator,
-            obj_object_name(right->type)
-        );
-        obj_free_object(right);
-        return res;
+obj_Object *eval_prefix_expr(enum ast_Operator op, obj_Object *right) {
+    switch (op) {
+        case ast_OP_BANG:
+            return eval_bang_operator_expr(right);
+        case ast_OP_MINUS:
+            return eval_minus_operator_prefix_expr(right);
+        default:
+            return obj_alloc_err_object(
+                "unknown operator: %s%s",
+                ast_operator_str(op),
+                obj_object_name(obj_type(right))
+            );
     }
 }
 
-obj_Object *
-eval_int_infix_expr(char *operator, obj_Object * left, obj_Object *right) {
-    if (strcmp(operator, "+") == 0) {
-        left->m_int += right->m_int;
-        return left;
-    } else if (strcmp(operator, "-") == 0) {
-        left->m_int -= right->m_int;
-        return left;
-    } else if (strcmp(operator, "*") == 0) {
-        left->m_int *= right->m_int;
-        return left;
-    } else if (strcmp(operator, "/") == 0) {
-        left->m_int /= right->m_int;
-        return left;
-    } else if (strcmp(operator, "<") == 0) {
-        obj_Object *cmp = obj_native_bool_object(left->m_int < right->m_int);
-        return cmp;
-    } else if (strcmp(operator, ">") == 0) {
-        obj_Object *cmp = obj_native_bool_object(left->m_int > right->m_int);
-        return cmp;
-    } else if (strcmp(operator, "==") == 0) {
-        obj_Object *cmp = obj_native_bool_object(left->m_int == right->m_int);
-        return cmp;
-    } else if (strcmp(operator, "!=") == 0) {
-        obj_Object *cmp = obj_native_bool_object(left->m_int != right->m_int);
-        return cmp;
-    } else {
-        obj_Object *res = obj_alloc_err_object(
-            "unknown operator: %s %s %s",
-            obj_object_name(left->type),
-            operator,
-            obj_object_name(right->type)
-        );
-        return res;
-    }
+obj_Object *eval_unknown_infix_op_err(
+    enum ast_Operator op,
+    obj_Object *left,
+    obj_Object *right
+) {
+    return obj_alloc_err_object(
+        "unknown operator: %s %s %s",
+        obj_object_name(obj_type(left)),
+        ast_operator_str(op),
+        obj_object_name(obj_type(right))
+    );
 }
 
-obj_Object *
-eval_str_infix_expr(char *operator, obj_Object * left, obj_Object *right) {
-    if (0 != strcmp(operator, "+")) {
-        obj_Object *res = obj_alloc_err_object(
-            "unknown operator: %s %s %s",
-            obj_object_name(left->type),
-            operator,
-            obj_object_name(right->type)
-        );
-        return res;
+/*
+ * # Infix dispatch
+ *
+ * Operations defined on a pair of operand types are looked up in a
+ * (type, type, op) table. Everything else - comparing other types by
+ * identity, type mismatches and unknown operators - is a NULL entry and goes
+ * through eval_infix_fallback.
+ *
+ * Int arithmetic never wraps - a result which doesn't fit an int, like a
+ * division by zero, is an error.
+ */
+
+typedef obj_Object *(*eval_Infix_fn)(obj_Object *left, obj_Object *right);
+
+static obj_Object *eval_int_overflow_err(int l, const char *op, int r) {
+    return obj_alloc_err_object("integer overflow: %d %s %d", l, op, r);
+}
+
+#define EVAL_INT_OP(name, expr)                                               \
+    static obj_Object *name(obj_Object *left, obj_Object *right) {             \
+        int l = obj_int_val(left);                                             \
+        int r = obj_int_val(right);                                            \
+        return expr;                                                           \
     }
 
-    obj_Object *obj = obj_alloc_object(obj_STRING);
-    strcpy(obj->m_str, left->m_str);
-    strcat(obj->m_str, right->m_str);
-    return obj;
+#define EVAL_INT_ARITH_OP(name, overflows, op)                                \
+    static obj_Object *name(obj_Object *left, obj_Object *right) {             \
+        int l = obj_int_val(left);                                             \
+        int r = obj_int_val(right);                                            \
+        int res = 0;                                                           \
+        if (overflows(l, r, &res)) {                                           \
+            return eval_int_overflow_err(l, op, r);                            \
+        }                                                                      \
+        return obj_int(res);                                                   \
+    }
+
+EVAL_INT_ARITH_OP(eval_int_plus, __builtin_add_overflow, "+")
+EVAL_INT_ARITH_OP(eval_int_minus, __builtin_sub_overflow, "-")
+EVAL_INT_ARITH_OP(eval_int_asterisk, __builtin_mul_overflow, "*")
+EVAL_INT_OP(eval_int_lt, obj_native_bool_object(l < r))
+EVAL_INT_OP(eval_int_gt, obj_native_bool_object(l > r))
+EVAL_INT_OP(eval_int_eq, obj_native_bool_object(l == r))
+EVAL_INT_OP(eval_int_not_eq, obj_native_bool_object(l != r))
+
+#undef EVAL_INT_OP
+#undef EVAL_INT_ARITH_OP
+
+static obj_Object *eval_int_slash(obj_Object *left, obj_Object *right) {
+    int l = obj_int_val(left);
+    int r = obj_int_val(right);
+    if (r == 0) {
+        return obj_alloc_err_object("division by zero");
+    } else if (l == INT_MIN && r == -1) {
+        return eval_int_overflow_err(l, "/", r);
+    }
+    return obj_int(l / r);
 }
 
-obj_Object *
-eval_infix_expr(char *operator, obj_Object * left, obj_Object *right) {
-    if (left->type == obj_INTEGER && right->type == obj_INTEGER) {
-        return eval_int_infix_expr(operator, left, right);
-    } else if (left->type == obj_STRING && right->type == obj_STRING) {
-        return eval_str_infix_expr(operator, left, right);
-    } else if (strcmp(operator, "==") == 0) {
-        obj_Object *cmp = obj_native_bool_object(obj_is_same(left, right));
-        return cmp;
-    } else if (strcmp(operator, "!=") == 0) {
-        obj_Object *cmp = obj_native_bool_object(!obj_is_same(left, right));
-        return cmp;
-    } else if (left->type != right->type) {
-        obj_Object *res = obj_alloc_err_object(
+static obj_Object *eval_str_plus(obj_Object *left, obj_Object *right) {
+    if (obj_str_len(left) + obj_str_len(right) > OBJ_STR_MAX_LEN) {
+        return obj_alloc_err_object("string too long");
+    }
+    return obj_str_concat(left, right);
+}
+
+static const eval_Infix_fn
+    eval_infix_table[obj_TYPE_COUNT][obj_TYPE_COUNT][ast_OPERATOR_COUNT] = {
+        [obj_INTEGER][obj_INTEGER] = {
+            [ast_OP_PLUS] = eval_int_plus,
+            [ast_OP_MINUS] = eval_int_minus,
+            [ast_OP_ASTERISK] = eval_int_asterisk,
+            [ast_OP_SLASH] = eval_int_slash,
+            [ast_OP_LT] = eval_int_lt,
+            [ast_OP_GT] = eval_int_gt,
+            [ast_OP_EQ] = eval_int_eq,
+            [ast_OP_NOT_EQ] = eval_int_not_eq,
+        },
+        [obj_STRING][obj_STRING] = {
+            [ast_OP_PLUS] = eval_str_plus,
+        },
+};
+
+static obj_Object *
+eval_infix_fallback(enum ast_Operator op, obj_Object *left, obj_Object *right) {
+    if (obj_type(left) == obj_type(right) &&
+        (obj_type(left) == obj_INTEGER || obj_type(left) == obj_STRING)) {
+        return eval_unknown_infix_op_err(op, left, right);
+    } else if (op == ast_OP_EQ) {
+        return obj_native_bool_object(obj_is_same(left, right));
+    } else if (op == ast_OP_NOT_EQ) {
+        return obj_native_bool_object(!obj_is_same(left, right));
+    } else if (obj_type(left) != obj_type(right)) {
+        return obj_alloc_err_object(
             "type mismatch: %s %s %s",
-            obj_object_name(left->type),
-            operator,
-            obj_object_name(right->type)
+            obj_object_name(obj_type(left)),
+            ast_operator_str(op),
+            obj_object_name(obj_type(right))
         );
-        return res;
     } else {
-        obj_Object *res = obj_alloc_err_object(
-            "unknown operator: %s %s %s",
-            obj_object_name(left->type),
-            operator,
-            obj_object_name(right->type)
-        );
-        return res;
+        return eval_unknown_infix_op_err(op, left, right);
     }
 }
 
-obj_Object *eval_if_expr(struct ast_Expr *if_expr, obj_Env *env) {
-    obj_Object *cond = eval_expr(if_expr->data.ife.cond, env);
-    if (obj_is_err(cond)) {
-        return cond;
-    }
-
-    if (obj_is_truthy(cond)) {
-        return eval_stmt(if_expr->data.ife.conseq, env);
-    } else if (if_expr->data.ife.alt != NULL) {
-        return eval_stmt(if_expr->data.ife.alt, env);
-    } else {
-        return obj_null();
+obj_Object *
+eval_infix_expr(enum ast_Operator op, obj_Object *left, obj_Object *right) {
+    eval_Infix_fn fn = eval_infix_table[obj_type(left)][obj_type(right)][op];
+    if (fn != NULL) {
+        return fn(left, right);
     }
+    return eval_infix_fallback(op, left, right);
 }
 
 obj_Object *eval_identifier(struct ast_Expr *ident_expr, obj_Env *env) {
-    obj_Object *exists = obj_env_get(env, ident_expr->data.ident.value);
+    struct ast_Ident *ident = &ident_expr->data.ident;
+    assert(ident->depth != AST_IDENT_UNRESOLVED && "resolve before eval");
 
-    if (exists == NULL) {
-        obj_Object *builtin =
-            builtin_from_keyword(ident_expr->data.ident.value);
-
-        if (builtin == NULL) {
-            return obj_alloc_err_object(
-                "identifier not found: %s",
-                ident_expr->data.ident.value
-            );
-        }
+    if (ident->depth == AST_IDENT_BUILTIN) {
+        return &BUILTIN_OBJECTS[ident->slot];
+    }
 
-        return builtin;
+    // resolved but never set - ex: let in an if branch not taken
+    obj_Object *exists = obj_env_get(env, ident->depth, ident->slot);
+    if (exists == NULL) {
+        return obj_alloc_err_object("identifier not found: %s", ident->value);
     }
 
-    obj_Object *val = obj_deepcpy(exists);
-    return val;
+    // values are shared with the env, nothing mutates them in place
+    return exists;
 }
 
-obj_Object **eval_expressions(struct ast_Expr **expr_da, obj_Env *env) {
-    obj_Object **obj_da = NULL;
-
-    for (int i = 0; i < stbds_arrlen(expr_da); ++i) {
-        struct ast_Expr *expr = expr_da[i];
-        obj_Object *evaluated = eval_expr(expr, env);
-        if (obj_is_err(evaluated)) {
-            // FIXME: free correctly or use arena
-            stbds_arrfree(obj_da);
-
-            obj_da = NULL;
-            stbds_arrput(obj_da, evaluated);
-            return obj_da;
-        }
-        stbds_arrput(obj_da, evaluated);
+// returns NULL if a call passes as many args as there are params
+obj_Object *eval_check_num_args(int num_params, int num_args) {
+    if (num_args == num_params) {
+        return NULL;
     }
-
-    return obj_da;
+    return obj_alloc_err_object(
+        "wrong number of arguments: want=%d, got=%d",
+        num_params,
+        num_args
+    );
 }
 
-obj_Env *eval_extend_func_env(obj_Object *func, obj_Object **args) {
-    obj_Env *env = obj_alloc_enclosed_env(func->m_func.env);
+// the number of args must be checked already
+obj_Env *
+eval_extend_func_env(obj_Object *func, obj_Object **args, int num_args) {
+    obj_Env *env =
+        obj_alloc_enclosed_env(func->m_func->env, func->m_func->num_slots);
 
-    for (int i = 0; i < stbds_arrlen(func->m_func.params); ++i) {
-        obj_env_set(env, func->m_func.params[i]->data.ident.value, args[i]);
+    for (int i = 0; i < num_args; ++i) {
+        obj_env_set(env, func->m_func->params[i]->data.ident.slot, args[i]);
     }
     return env;
 }
 
 obj_Object *eval_unwrap_return_val(obj_Object *obj) {
-    if (obj->type == obj_RETURN_VALUE) {
+    if (obj_type(obj) == obj_RETURN_VALUE) {
         return obj->m_return_obj;
     }
     return obj;
 }
 
-obj_Object *eval_builtins(obj_Object *func, obj_Object **args) {
-    assert(func->type == obj_BUILTIN);
+obj_Object *
+eval_builtins(obj_Object *func, obj_Object **args, int num_args) {
+    assert(obj_type(func) == obj_BUILTIN);
 
     switch (func->m_builtin) {
         case BUILTIN_LEN:
-            return builtin_eval_len(args);
+            return builtin_eval_len(args, num_args);
         case BUILTIN_FIRST:
-            return builtin_eval_first(args);
+            return builtin_eval_first(args, num_args);
         case BUILTIN_LAST:
-            return builtin_eval_last(args);
+            return builtin_eval_last(args, num_args);
         case BUILTIN_REST:
-            return builtin_eval_rest(args);
+            return builtin_eval_rest(args, num_args);
         case BUILTIN_PUSH:
-            return builtin_eval_push(args);
+            return builtin_eval_push(args, num_args);
         case BUILTIN_PUTS:
-            return builtin_eval_puts(args);
+            return builtin_eval_puts(args, num_args);
+        case BUILTIN_GC_STATS:
+            return builtin_eval_gc_stats(args, num_args);
         default:
             assert(0 && "unreachable");
     }
 }
 
-obj_Object *eval_apply_func(obj_Object *func, obj_Object **args) {
-    obj_Env *extended_env = NULL;
-
-    switch (func->type) {
-        case obj_FUNCTION:
-            extended_env = eval_extend_func_env(func, args);
-            obj_Object *evaluated = eval_stmt(func->m_func.body, extended_env);
-            return eval_unwrap_return_val(evaluated);
-        case obj_BUILTIN:
-            return eval_builtins(func, args);
-        default:
-            return obj_alloc_err_object("not a function: %d", func->type);
-    }
-}
-
 obj_Object *eval_arr_idx_expr(obj_Object *arr, obj_Object *index) {
-    int idx = index->m_int;
-    int max_idx = stbds_arrlen(arr->m_arr_da) - 1;
+    int idx = obj_int_val(index);
+    int max_idx = obj_arr_len(arr) - 1;
 
     if (idx < 0 || idx > max_idx) {
         return obj_null();
     }
-    return arr->m_arr_da[idx];
+    return obj_arr_elems(arr)[idx];
+}
+
+obj_Object *eval_unusable_hash_key_err(obj_Object *key) {
+    return obj_alloc_err_object(
+        "unusable as hash key: %s",
+        obj_object_name(obj_type(key))
+    );
 }
 
 obj_Object *eval_hash_idx_expr(obj_Object *hash, obj_Object *index) {
-    int n = stbds_arrlen(hash->m_hash.hash_da);
-    for (int i = 0; i < n; ++i) {
-        if (obj_is_same(index, hash->m_hash.hash_da[i]->key)) {
-            return hash->m_hash.hash_da[i]->val;
-        }
+    if (!obj_is_hashable(index)) {
+        return eval_unusable_hash_key_err(index);
+    }
+    obj_Object *val = obj_hash_get(hash, index);
+    return val == NULL ? obj_null() : val;
+}
+
+// returns the hash or an error for an unhashable key
+obj_Object *eval_hash_put(obj_Object *hash, obj_Object *key, obj_Object *val) {
+    if (!obj_is_hashable(key)) {
+        return eval_unusable_hash_key_err(key);
     }
-    return obj_null();
+    obj_hash_put(hash, key, val);
+    return hash;
 }
 
 obj_Object *eval_idx_expr(obj_Object *left, obj_Object *index) {
-    if (left->type == obj_ARRAY && index->type == obj_INTEGER) {
+    if (obj_type(left) == obj_ARRAY && obj_type(index) == obj_INTEGER) {
         return eval_arr_idx_expr(left, index);
-    } else if (left->type == obj_HASH) {
+    } else if (obj_type(left) == obj_HASH) {
         return eval_hash_idx_expr(left, index);
     } else {
         return obj_alloc_err_object(
             "index operator not supported: %s",
-            obj_object_name(left->type)
+            obj_object_name(obj_type(left))
         );
     }
 }
 
-obj_Object *eval_expr(struct ast_Expr *expr, obj_Env *env) {
-    obj_Object *obj = NULL;
 
-    obj_Object *left = NULL;
-    obj_Object *right = NULL;
+// ---------------------- Frames
+
+// the frame goes on top of the stack, frame pointers held before are stale
+static void eval_push_frame(struct eval_Frame frame) {
+    if (stbds_arrlen(EVAL_STACK.frames_da) >= EVAL_MAX_FRAMES) {
+        frame.tag = eval_FRAME_OVERFLOW;
+    }
+    frame.roots = gc_save_roots();
+    stbds_arrput(EVAL_STACK.frames_da, frame);
+}
+
+static void eval_push_stmts(struct ast_Stmt **stmts, int len, obj_Env *env) {
+    eval_push_frame((struct eval_Frame){
+        .tag = eval_FRAME_STMTS,
+        .env = env,
+        .stmts = stmts,
+        .len = len,
+    });
+}
 
-    obj_Object *func = NULL;
-    obj_Object **args = NULL;
+// evaluates exprs without operands, returns false for others
+static bool eval_leaf(struct ast_Expr *expr, obj_Env *env, obj_Object **val) {
+    obj_Object *obj = NULL;
     switch (expr->tag) {
         case ast_INT_LIT_EXPR:
-            obj = obj_alloc_object(obj_INTEGER);
-            obj->m_int = expr->data.int_lit.value;
-            break;
+            *val = obj_int(expr->data.int_lit.value);
+            return true;
         case ast_BOOL_EXPR:
-            obj = obj_native_bool_object(expr->data.boolean.value);
-            break;
-        case ast_PREFIX_EXPR:
-            right = eval_expr(expr->data.pf.right, env);
-            if (obj_is_err(right)) {
-                return right;
-            }
-            obj = eval_prefix_expr(expr->data.pf.operator, right);
-            break;
-        case ast_INFIX_EXPR:
-            left = eval_expr(expr->data.inf.left, env);
-            if (obj_is_err(left)) {
-                return left;
-            }
-            right = eval_expr(expr->data.inf.right, env);
-            if (obj_is_err(right)) {
-                return right;
-            }
-            obj = eval_infix_expr(expr->data.inf.operator, left, right);
-            break;
-        case ast_IF_EXPR:
-            obj = eval_if_expr(expr, env);
-            break;
+            *val = obj_native_bool_object(expr->data.boolean.value);
+            return true;
+        case ast_NULL_EXPR:
+            *val = obj_null();
+            return true;
+        case ast_STR_LIT_EXPR:
+            *val = obj_alloc_interned_str(
+                expr->data.str.value,
+                expr->data.str.len
+            );
+            return true;
         case ast_IDENT_EXPR:
-            obj = eval_identifier(expr, env);
-            break;
+            *val = eval_identifier(expr, env);
+            return true;
         case ast_FN_LIT_EXPR:
             obj = obj_alloc_object(obj_FUNCTION);
-            obj->m_func.params =
-                ast_deepcpy_fn_params(expr->data.fn_lit.params_da);
-            obj->m_func.body = ast_deepcopy_stmt(expr->data.fn_lit.body);
-            obj->m_func.env = obj_env_deepcpy(env);
-            break;
-        case ast_CALL_EXPR:
-            func = eval_expr(expr->data.call.func, env);
-            if (obj_is_err(func)) {
-                return func;
-            }
+            obj->m_func->lit = expr;
+            obj->m_func->arena = util_arena_retain(EVAL_ARENA);
+            obj->m_func->params = expr->data.fn_lit.params_da;
+            obj->m_func->body = expr->data.fn_lit.body;
+            obj->m_func->num_slots = expr->data.fn_lit.num_slots;
+            obj->m_func->env = env;
+            *val = obj;
+            return true;
+        default:
+            return false;
+    }
+}
 
-            args = eval_expressions(expr->data.call.args_da, env);
-            if (stbds_arrlen(args) == 1 && obj_is_err(args[0])) {
-                return args[0];
-            }
-            obj = eval_apply_func(func, args);
-            break;
+static bool eval_is_leaf(struct ast_Expr *expr) {
+    switch (expr->tag) {
+        case ast_INT_LIT_EXPR:
+        case ast_BOOL_EXPR:
+        case ast_NULL_EXPR:
         case ast_STR_LIT_EXPR:
-            obj = obj_alloc_object(obj_STRING);
-            strcpy(obj->m_str, expr->data.str.value);
-            break;
-        case ast_ARR_LIT_EXPR:
-            obj = obj_alloc_object(obj_ARRAY);
-            obj_Object **elems = eval_expressions(expr->data.arr.elems_da, env);
-            if (stbds_arrlen(elems) == 1 && obj_is_err(elems[0])) {
-                return elems[0];
+        case ast_IDENT_EXPR:
+        case ast_FN_LIT_EXPR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// evaluates leaves and operators on leaves, returns false for other exprs -
+// nothing collects in between, so the left operand needs no root
+static bool
+eval_in_place(struct ast_Expr *expr, obj_Env *env, obj_Object **val) {
+    struct ast_Expr *left = NULL;
+    struct ast_Expr *right = NULL;
+    switch (expr->tag) {
+        case ast_PREFIX_EXPR:
+            if (!eval_is_leaf(expr->data.pf.right))
+                return false;
+            eval_leaf(expr->data.pf.right, env, val);
+            if (!obj_is_err(*val)) {
+                *val = eval_prefix_expr(expr->data.pf.op, *val);
             }
-            obj->m_arr_da = elems;
+            return true;
+        case ast_INFIX_EXPR:
+            left = expr->data.inf.left;
+            right = expr->data.inf.right;
             break;
         case ast_IDX_EXPR:
-            left = eval_expr(expr->data.idx.left, env);
-            if (obj_is_err(left)) {
-                return left;
-            }
-            obj_Object *index = eval_expr(expr->data.idx.index, env);
-            if (obj_is_err(index)) {
-                return index;
-            }
-            obj = eval_idx_expr(left, index);
+            left = expr->data.idx.left;
+            right = expr->data.idx.index;
             break;
-        case ast_HASH_LIT_EXPR:
-            obj = obj_alloc_object(obj_HASH);
-
-            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); ++i) {
-                obj_Object *key =
-                    eval_expr(expr->data.hash.hash_da[i]->key, env);
-                if (obj_is_err(key)) {
-                    return key;
-                }
-                obj_Object *val =
-                    eval_expr(expr->data.hash.hash_da[i]->val, env);
-                if (obj_is_err(val)) {
-                    return val;
-                }
+        default:
+            return eval_leaf(expr, env, val);
+    }
+
+    if (!eval_is_leaf(left) || !eval_is_leaf(right))
+        return false;
+    obj_Object *l = NULL;
+    eval_leaf(left, env, &l);
+    if (obj_is_err(l)) {
+        *val = l;
+        return true;
+    }
+    eval_leaf(right, env, val);
+    if (!obj_is_err(*val)) {
+        *val = expr->tag == ast_INFIX_EXPR
+                   ? eval_infix_expr(expr->data.inf.op, l, *val)
+                   : eval_idx_expr(l, *val);
+    }
+    return true;
+}
+
+// returns true if it pushed a frame for expr, else its value is in val
+static bool
+eval_push_expr(struct ast_Expr *expr, obj_Env *env, obj_Object **val) {
+    if (eval_in_place(expr, env, val)) {
+        return false;
+    }
+    eval_push_frame((struct eval_Frame){
+        .tag = eval_FRAME_EXPR,
+        .env = env,
+        .expr = expr,
+    });
+    return true;
+}
+
+// the first num operands of a call - its callee and args - or of an array
+static void eval_root_operands(struct eval_Frame *frame, int num) {
+    bool call = frame->expr->tag == ast_CALL_EXPR;
+    for (int i = frame->rooted; i < num; ++i) {
+        if (call) {
+            gc_push_root(i == 0 ? frame->tmp : frame->args[i - 1]);
+        } else {
+            gc_push_root(frame->args[i]);
+        }
+    }
+    frame->rooted = num;
+}
+
+// the frame runs the fn body from now on, the fn and env are rooted by it
+static void
+eval_run_body(struct eval_Frame *frame, obj_Object *func, obj_Env *env) {
+    gc_restore_roots(frame->roots);
+    gc_push_root(func);
+    gc_push_env_root(env);
+    gc_maybe_collect();
+
+    // fn literals in the body are in the arena of the func's own
+    EVAL_ARENA = func->m_func->arena;
+    struct ast_Stmt **stmts = func->m_func->body->data.block.stmts_da;
+    frame->env = env;
+    frame->stmts = stmts;
+    frame->len = stbds_arrlen(stmts);
+    frame->prg = false;
+    frame->step = 0;
+    frame->tmp = NULL;
+}
+
+// the number of args must be checked already - the call's frame is handed
+// over to the fn body
+static obj_Object *
+eval_enter_func(struct eval_Frame *frame, obj_Object *func, obj_Env *env) {
+    if (EVAL_STACK.depth >= EVAL_STACK.max_depth) {
+        return obj_alloc_err_object("stack overflow");
+    }
+    EVAL_STACK.depth++;
+
+    frame->tag = eval_FRAME_FUNC;
+    frame->arena = EVAL_ARENA;
+    eval_run_body(frame, func, env);
+    return &EVAL_RUNNING;
+}
 
-                obj_hash_put(obj, key, val);
+// the args are evaluated
+static obj_Object *eval_call(struct eval_Frame *frame) {
+    obj_Object *func = frame->tmp;
+    int num_args = stbds_arrlen(frame->expr->data.call.args_da);
+    obj_Object *res = NULL;
+    obj_Env *env = NULL;
+
+    // the args are reachable through the env from here on
+    gc_restore_roots(frame->roots);
+    switch (obj_type(func)) {
+        case obj_FUNCTION:
+            res = eval_check_num_args(
+                stbds_arrlen(func->m_func->params),
+                num_args
+            );
+            if (res == NULL) {
+                env = eval_extend_func_env(func, frame->args, num_args);
             }
             break;
+        case obj_BUILTIN:
+            res = eval_builtins(func, frame->args, num_args);
+            break;
         default:
-            assert(0 && "unreachable");
+            res = obj_alloc_err_object("not a function: %d", obj_type(func));
+            break;
     }
-    return obj;
+    util_arena_rewind(&EVAL_SCRATCH, frame->scratch);
+
+    if (env == NULL) {
+        return res;
+    } else if (frame->expr->data.call.tail) {
+        EVAL_TAIL.func = func;
+        EVAL_TAIL.env = env;
+        return &EVAL_TAIL_CALL;
+    }
+    return eval_enter_func(frame, func, env);
 }
 
-obj_Object *eval_block_stmts(struct ast_Stmt **stmts, obj_Env *env) {
-    obj_Object *obj = NULL;
-    for (int i = 0; i < stbds_arrlen(stmts); ++i) {
-        obj = eval_stmt(stmts[i], env);
+// val is the value of the operand evaluated last
+static obj_Object *eval_step_expr(struct eval_Frame *frame, obj_Object *val) {
+    struct ast_Expr *expr = frame->expr;
+    obj_Env *env = frame->env;
+    struct ast_Expr **elems_da = NULL;
+    int next = 0;
+
+    // a step which gets an operand's value in place goes on to the next one
+    for (;;) {
+        int step = frame->step++;
+        if (step > 0 && obj_is_err(val)) {
+            if (frame->args != NULL) {
+                util_arena_rewind(&EVAL_SCRATCH, frame->scratch);
+            }
+            return val;
+        }
 
-        // Here we are not unwrapping return val here and sending it to caller
-        // as return val
-        if (obj != NULL &&
-            (obj->type == obj_RETURN_VALUE || obj->type == obj_ERROR)) {
-            return obj;
+        switch (expr->tag) {
+            case ast_PREFIX_EXPR:
+                if (step == 0) {
+                    if (eval_push_expr(expr->data.pf.right, env, &val))
+                        return &EVAL_RUNNING;
+                    continue;
+                }
+                return eval_prefix_expr(expr->data.pf.op, val);
+            case ast_INFIX_EXPR:
+            case ast_IDX_EXPR: {
+                bool infix = expr->tag == ast_INFIX_EXPR;
+                if (step == 0) {
+                    struct ast_Expr *left =
+                        infix ? expr->data.inf.left : expr->data.idx.left;
+                    if (eval_push_expr(left, env, &val))
+                        return &EVAL_RUNNING;
+                    continue;
+                } else if (step == 1) {
+                    frame->tmp = val;
+                    struct ast_Expr *right =
+                        infix ? expr->data.inf.right : expr->data.idx.index;
+                    if (eval_in_place(right, env, &val))
+                        continue;
+                    gc_push_root(frame->tmp);
+                    eval_push_expr(right, env, &val);
+                    return &EVAL_RUNNING;
+                }
+                if (infix) {
+                    return eval_infix_expr(expr->data.inf.op, frame->tmp, val);
+                }
+                return eval_idx_expr(frame->tmp, val);
+            }
+            case ast_IF_EXPR: {
+                if (step == 0) {
+                    if (eval_push_expr(expr->data.ife.cond, env, &val))
+                        return &EVAL_RUNNING;
+                    continue;
+                }
+
+                // the frame is handed over to the branch taken
+                struct ast_Stmt *branch = obj_is_truthy(val)
+                                              ? expr->data.ife.conseq
+                                              : expr->data.ife.alt;
+                if (branch == NULL) {
+                    return obj_null();
+                }
+                frame->tag = eval_FRAME_STMTS;
+                frame->stmts = branch->data.block.stmts_da;
+                frame->len = stbds_arrlen(frame->stmts);
+                frame->prg = false;
+                frame->step = 0;
+                return &EVAL_RUNNING;
+            }
+            case ast_CALL_EXPR:
+            case ast_ARR_LIT_EXPR: {
+                bool call = expr->tag == ast_CALL_EXPR;
+                elems_da =
+                    call ? expr->data.call.args_da : expr->data.arr.elems_da;
+                if (call && step == 0) {
+                    if (eval_push_expr(expr->data.call.func, env, &val))
+                        return &EVAL_RUNNING;
+                    continue;
+                }
+
+                // evaluated into scratch, until the call or array is made
+                next = call ? step - 1 : step;
+                if (next == 0) {
+                    if (call) {
+                        frame->tmp = val;
+                    }
+                    frame->scratch = util_arena_mark(&EVAL_SCRATCH);
+                    frame->args = util_arena_alloc(
+                        &EVAL_SCRATCH,
+                        stbds_arrlen(elems_da) * sizeof(obj_Object *)
+                    );
+                } else {
+                    frame->args[next - 1] = val;
+                }
+
+                if (next < stbds_arrlen(elems_da)) {
+                    if (eval_in_place(elems_da[next], env, &val))
+                        continue;
+                    eval_root_operands(frame, call ? next + 1 : next);
+                    eval_push_expr(elems_da[next], env, &val);
+                    return &EVAL_RUNNING;
+                } else if (call) {
+                    return eval_call(frame);
+                }
+                obj_Object *arr = obj_alloc_arr(frame->args, next);
+                util_arena_rewind(&EVAL_SCRATCH, frame->scratch);
+                return arr;
+            }
+            case ast_HASH_LIT_EXPR: {
+                struct ast_Hash_elem **hash_da = expr->data.hash.hash_da;
+                if (step == 0) {
+                    frame->tmp = obj_alloc_object(obj_HASH);
+                    gc_push_root(frame->tmp);
+                } else if (step % 2 == 1) {
+                    frame->key = val;
+                    struct ast_Expr *val_expr = hash_da[step / 2]->val;
+                    if (eval_in_place(val_expr, env, &val))
+                        continue;
+                    gc_push_root(frame->key);
+                    eval_push_expr(val_expr, env, &val);
+                    return &EVAL_RUNNING;
+                } else {
+                    obj_Object *hash =
+                        eval_hash_put(frame->tmp, frame->key, val);
+                    if (obj_is_err(hash)) {
+                        return hash;
+                    }
+                }
+
+                if (step / 2 < stbds_arrlen(hash_da)) {
+                    if (eval_push_expr(hash_da[step / 2]->key, env, &val))
+                        return &EVAL_RUNNING;
+                    continue;
+                }
+                return frame->tmp;
+            }
+            default:
+                assert(0 && "unreachable");
         }
     }
-    return obj;
 }
 
-obj_Object *eval_stmt(struct ast_Stmt *stmt, obj_Env *env) {
+// the value of the stmt, given the value of its expr
+static obj_Object *
+eval_stmt_value(struct ast_Stmt *stmt, obj_Env *env, obj_Object *val) {
     obj_Object *obj = NULL;
-    obj_Object *val = NULL;
     switch (stmt->tag) {
         case ast_EXPR_STMT:
-            obj = eval_expr(stmt->data.expr.expr, env);
-            break;
         case ast_BLOCK_STMT:
-            obj = eval_block_stmts(stmt->data.block.stmts_da, env);
-            break;
+            return val;
         case ast_RET_STMT:
-            val = eval_expr(stmt->data.ret.ret_val, env);
-            if (obj_is_err(val)) {
+            if (obj_is_err(val) || val == &EVAL_TAIL_CALL) {
                 return val;
             }
             obj = obj_alloc_object(obj_RETURN_VALUE);
             obj->m_return_obj = val;
-            break;
+            return obj;
         case ast_LET_STMT:
-            val = eval_expr(stmt->data.let.value, env);
             if (obj_is_err(val)) {
                 return val;
             }
 
-            if (val->type == obj_FUNCTION) {
-                obj_env_set(
-                    val->m_func.env,
-                    stmt->data.let.name->data.ident.value,
-                    val
-                );
-            }
-
-            obj_env_set(env, stmt->data.let.name->data.ident.value, val);
-            break;
+            // a fn literal shares this frame, so it also sees its own name
+            obj_env_set(env, stmt->data.let.name->data.ident.slot, val);
+            return NULL;
         default:
             assert(0 && "unreachable");
     }
-    return obj;
 }
 
-obj_Object *eval_prg(struct ast_Stmt **stmts, obj_Env *env) {
-    obj_Object *obj = NULL;
-    for (int i = 0; i < stbds_arrlen(stmts); ++i) {
-        obj = eval_stmt(stmts[i], env);
-        if (obj == NULL) {
-            continue;
+// a block's value is its last stmt's, returns and errors end it early
+static obj_Object *eval_step_stmts(struct eval_Frame *frame, obj_Object *val) {
+    for (;;) {
+        int step = frame->step++;
+        if (step > 0) {
+            obj_Object *obj =
+                eval_stmt_value(frame->stmts[step - 1], frame->env, val);
+            if (obj != NULL && obj_type(obj) == obj_RETURN_VALUE) {
+                // the program's value is what it returns
+                return frame->prg ? obj->m_return_obj : obj;
+            } else if (obj != NULL && obj_type(obj) == obj_ERROR) {
+                return obj;
+            }
+            frame->tmp = obj;
+        }
+        if (step == frame->len) {
+            return frame->tmp;
         }
 
-        obj_Object *ret = NULL;
-        switch (obj->type) {
-            case obj_RETURN_VALUE:
-                // Here we are unwrapping the return val and convert it as
-                // normal object to the caller - since programs are not
-                // recursive and need to evaluate calculatable value
-                ret = obj->m_return_obj;
-                free(obj);
-                return ret;
-            case obj_ERROR:
-                return obj;
+        if (frame->prg) {
+            gc_maybe_collect();
+        }
+        struct ast_Stmt *stmt = frame->stmts[step];
+        struct ast_Expr *expr = NULL;
+        switch (stmt->tag) {
+            case ast_EXPR_STMT:
+                expr = stmt->data.expr.expr;
+                break;
+            case ast_RET_STMT:
+                expr = stmt->data.ret.ret_val;
+                break;
+            case ast_LET_STMT:
+                expr = stmt->data.let.value;
+                break;
+            case ast_BLOCK_STMT:
+                eval_push_stmts(
+                    stmt->data.block.stmts_da,
+                    stbds_arrlen(stmt->data.block.stmts_da),
+                    frame->env
+                );
+                return &EVAL_RUNNING;
             default:
+                assert(0 && "unreachable");
+        }
+        if (eval_push_expr(expr, frame->env, &val)) {
+            return &EVAL_RUNNING;
+        }
+    }
+}
+
+// a tail call in the body ends it, its fn runs in the body's place
+static obj_Object *eval_step_func(struct eval_Frame *frame, obj_Object *val) {
+    if (val == &EVAL_TAIL_CALL) {
+        eval_run_body(frame, EVAL_TAIL.func, EVAL_TAIL.env);
+        val = NULL;
+    }
+    obj_Object *res = eval_step_stmts(frame, val);
+    return res == &EVAL_RUNNING ? res : eval_unwrap_return_val(res);
+}
+
+// steps the frames above base until they all returned, returns the value of
+// the one at base
+static obj_Object *eval_run(int base) {
+    obj_Object *val = NULL;
+    while (stbds_arrlen(EVAL_STACK.frames_da) > base) {
+        struct eval_Frame *frame = &stbds_arrlast(EVAL_STACK.frames_da);
+        obj_Object *res = NULL;
+        switch (frame->tag) {
+            case eval_FRAME_EXPR:
+                res = eval_step_expr(frame, val);
+                break;
+            case eval_FRAME_STMTS:
+                res = eval_step_stmts(frame, val);
+                break;
+            case eval_FRAME_FUNC:
+                res = eval_step_func(frame, val);
                 break;
+            case eval_FRAME_OVERFLOW:
+                res = obj_alloc_err_object("stack overflow");
+                break;
+        }
+        if (res == &EVAL_RUNNING) {
+            continue;
         }
+
+        // the step didn't push, so the frame is still on top
+        frame = &stbds_arrlast(EVAL_STACK.frames_da);
+        gc_restore_roots(frame->roots);
+        if (frame->tag == eval_FRAME_FUNC) {
+            EVAL_ARENA = frame->arena;
+            EVAL_STACK.depth--;
+        }
+        stbds_arrpop(EVAL_STACK.frames_da);
+        val = res;
     }
-    return obj;
+    return val;
 }
 
 /*
  * Evaluates Program, Statemtents, Expressions as ast_Node
  */
 obj_Object *eval_eval(ast_Node node, obj_Env *env) {
+    // the env is the root of everything the program can still reach
+    int roots = gc_save_roots();
+    gc_push_env_root(env);
+
+    int base = stbds_arrlen(EVAL_STACK.frames_da);
+    struct util_Arena *arena = EVAL_ARENA;
+    obj_Object *obj = NULL;
     switch (node.tag) {
         case ast_NODE_PRG:
-            return eval_prg(node.prg->statement_ptrs_da, env);
+            EVAL_ARENA = node.prg->arena;
+            eval_push_stmts(
+                node.prg->statement_ptrs_da,
+                stbds_arrlen(node.prg->statement_ptrs_da),
+                env
+            );
+            stbds_arrlast(EVAL_STACK.frames_da).prg = true;
+            break;
         case ast_NODE_EXPR:
-            return eval_expr(node.expr, env);
+            if (!eval_push_expr(node.expr, env, &obj)) {
+                gc_restore_roots(roots);
+                return obj;
+            }
+            break;
         case ast_NODE_STMT:
-            return eval_stmt(node.stmt, env);
+            eval_push_stmts(&node.stmt, 1, env);
+            break;
         default:
             assert(0 && "unreachable");
     }
+
+    obj = eval_run(base);
+    EVAL_ARENA = arena;
+    gc_restore_roots(roots);
+    return obj;
 }
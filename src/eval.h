@@ -1,8 +1,7 @@
+#pragma once
 #include "ast.h"
 #include "builtin.c"
 #include "object.c"
 #include "object_env.h"
 
-obj_Object *eval_expr(struct ast_Expr *expr, obj_Env *env);
-
-obj_Object *eval_stmt(struct ast_Stmt *stmt, obj_Env *env);
+obj_Object *eval_eval(ast_Node node, obj_Env *env);
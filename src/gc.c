@@ -0,0 +1,324 @@
+#pragma once
+#include "gc.h"
+#include "object.c"
+#include "object_env.c"
+
+#include <time.h>
+
+/*
+ * # Garbage collector
+ *
+ * Tracing mark and sweep over every heap obj_Object and obj_Env. Allocations
+ * are registered in intrusive lists, so values are shared freely and never
+ * copied or freed by hand.
+ *
+ * Roots are only what the engine running says is live, pushed on a root
+ * stack: the evaluator's envs and the temporaries it holds across a nested
+ * eval, the vm's value stack, globals and constants as ranges it keeps
+ * filling. Collections only happen at safe points - gc_maybe_collect - never
+ * inside an allocation, so code which doesn't eval in between needs no
+ * rooting.
+ */
+
+#define GC_DEFAULT_THRESHOLD (8 * 1024 * 1024)
+
+struct gc_Root {
+    enum { gc_ROOT_OBJECT, gc_ROOT_ENV, gc_ROOT_RANGE } tag;
+    union {
+        obj_Object *obj;
+        obj_Env *env;
+        struct {
+            obj_Object **objs;
+            const int *len; // read when marking, the range may change
+        } range;
+    };
+};
+
+struct gc_Stats {
+    int collections;
+    size_t heap_bytes; // live after the last collection
+    size_t freed_bytes;
+    size_t freed_objects;
+    long last_pause_us;
+    long total_pause_us;
+};
+
+static struct gc_Heap {
+    obj_Object *objects; // linked through gc_next
+    obj_Env *envs;
+    struct gc_Root *roots_da;
+
+    // marked but not yet traced
+    obj_Object **gray_da;
+    obj_Env **gray_envs_da;
+
+    size_t allocated; // bytes since the last collection
+    size_t buffer_bytes; // of the buffers shared by strings and arrays
+    size_t threshold; // set by the user, the heap may grow past it
+    size_t next_collection;
+
+    struct gc_Stats stats;
+} GC = {
+    .threshold = GC_DEFAULT_THRESHOLD,
+    .next_collection = GC_DEFAULT_THRESHOLD,
+};
+
+// ---------------------- Registry
+
+// bytes owned by the object, including its own dyn arrs - shared buffers are
+// counted apart, once each
+static size_t gc_object_size(obj_Object *obj) {
+    size_t size = sizeof(obj_Object);
+    switch (obj->type) {
+        case obj_ERROR:
+            size += MAX_ERR_STRING_LEN;
+            break;
+        case obj_FUNCTION:
+            size += sizeof(struct obj_Func);
+            size += stbds_arrcap(obj->m_func->free_da) * sizeof(obj_Object *);
+            break;
+        case obj_COMPILED_FUNCTION:
+            size += sizeof(struct obj_Compiled_fn);
+            size += stbds_arrcap(obj->m_compiled_fn->instructions_da);
+            break;
+        case obj_HASH:
+            size += sizeof(struct obj_Hash);
+            size += OBJ_HASH_ELEMS_SIZE(obj->m_hash->slots_cap);
+            size += obj->m_hash->slots_cap * sizeof(int);
+            break;
+        default:
+            break;
+    }
+    return size;
+}
+
+void gc_track_object(obj_Object *obj) {
+    obj->gc_marked = false;
+    obj->gc_next = GC.objects;
+    GC.objects = obj;
+    GC.allocated += gc_object_size(obj);
+}
+
+static size_t gc_env_size(obj_Env *env) {
+    return sizeof(obj_Env) + env->num_slots * sizeof(obj_Object *);
+}
+
+void gc_track_env(obj_Env *env) {
+    env->gc_marked = false;
+    env->gc_next = GC.envs;
+    GC.envs = env;
+    GC.allocated += gc_env_size(env);
+}
+
+// a tracked object or env got bigger
+void gc_track_growth(size_t bytes) {
+    GC.allocated += bytes;
+}
+
+// a buffer shared by strings or arrays, freed along with the last of them
+void gc_track_buffer(size_t bytes) {
+    GC.allocated += bytes;
+    GC.buffer_bytes += bytes;
+}
+
+void gc_untrack_buffer(size_t bytes) {
+    GC.buffer_bytes -= bytes;
+}
+
+void gc_set_threshold(size_t bytes) {
+    GC.threshold = bytes;
+    GC.next_collection = bytes;
+}
+
+struct gc_Stats gc_stats() {
+    return GC.stats;
+}
+
+size_t gc_threshold() {
+    return GC.threshold;
+}
+
+// ---------------------- Roots
+
+int gc_save_roots() {
+    return stbds_arrlen(GC.roots_da);
+}
+
+void gc_restore_roots(int depth) {
+    assert(depth <= stbds_arrlen(GC.roots_da));
+    stbds_arrsetlen(GC.roots_da, depth);
+}
+
+void gc_push_root(obj_Object *obj) {
+    struct gc_Root root = { .tag = gc_ROOT_OBJECT, .obj = obj };
+    stbds_arrput(GC.roots_da, root);
+}
+
+void gc_push_env_root(obj_Env *env) {
+    struct gc_Root root = { .tag = gc_ROOT_ENV, .env = env };
+    stbds_arrput(GC.roots_da, root);
+}
+
+// the first *len of objs, unset ones are NULL
+void gc_push_range_root(obj_Object **objs, const int *len) {
+    struct gc_Root root = {
+        .tag = gc_ROOT_RANGE,
+        .range = { .objs = objs, .len = len },
+    };
+    stbds_arrput(GC.roots_da, root);
+}
+
+// ---------------------- Mark
+
+// natives and immediates get marked too, they just never get swept
+static void gc_mark_object(obj_Object *obj) {
+    if (obj == NULL || obj_is_tagged_int(obj) || obj->gc_marked)
+        return;
+    obj->gc_marked = true;
+    stbds_arrput(GC.gray_da, obj);
+}
+
+static void gc_mark_env(obj_Env *env) {
+    if (env == NULL || env->gc_marked)
+        return;
+    env->gc_marked = true;
+    stbds_arrput(GC.gray_envs_da, env);
+}
+
+static void gc_trace_object(obj_Object *obj) {
+    switch (obj->type) {
+        case obj_RETURN_VALUE:
+            gc_mark_object(obj->m_return_obj);
+            break;
+        case obj_FUNCTION:
+            gc_mark_env(obj->m_func->env);
+            gc_mark_object(obj->m_func->compiled);
+            for (int i = 0; i < stbds_arrlen(obj->m_func->free_da); ++i) {
+                gc_mark_object(obj->m_func->free_da[i]);
+            }
+            break;
+        case obj_ARRAY:
+            // elems outside the view are marked by the arrays seeing them
+            for (int i = 0; i < obj_arr_len(obj); ++i) {
+                gc_mark_object(obj_arr_elems(obj)[i]);
+            }
+            break;
+        case obj_HASH:
+            for (int i = 0; i < obj->m_hash->len; ++i) {
+                gc_mark_object(obj->m_hash->elems[i].key);
+                gc_mark_object(obj->m_hash->elems[i].val);
+            }
+            break;
+        default:
+            // NOTHING - no references
+            break;
+    }
+}
+
+static void gc_trace_env(obj_Env *env) {
+    for (int i = 0; i < env->num_slots; ++i) {
+        gc_mark_object(env->slots[i]);
+    }
+    gc_mark_env(env->outer);
+}
+
+// iterative so deep structures don't blow the c stack
+static void gc_mark() {
+    for (int i = 0; i < stbds_arrlen(GC.roots_da); ++i) {
+        struct gc_Root root = GC.roots_da[i];
+        switch (root.tag) {
+            case gc_ROOT_OBJECT:
+                gc_mark_object(root.obj);
+                break;
+            case gc_ROOT_ENV:
+                gc_mark_env(root.env);
+                break;
+            case gc_ROOT_RANGE:
+                for (int j = 0; j < *root.range.len; ++j) {
+                    gc_mark_object(root.range.objs[j]);
+                }
+                break;
+        }
+    }
+
+    while (stbds_arrlen(GC.gray_da) > 0 || stbds_arrlen(GC.gray_envs_da) > 0) {
+        if (stbds_arrlen(GC.gray_da) > 0) {
+            gc_trace_object(stbds_arrpop(GC.gray_da));
+        } else {
+            gc_trace_env(stbds_arrpop(GC.gray_envs_da));
+        }
+    }
+}
+
+// ---------------------- Sweep
+
+// returns the live bytes
+static size_t gc_sweep() {
+    size_t live = 0;
+    size_t buffer_bytes = GC.buffer_bytes;
+
+    obj_Object **obj = &GC.objects;
+    while (*obj != NULL) {
+        obj_Object *curr = *obj;
+        size_t size = gc_object_size(curr);
+        if (curr->gc_marked) {
+            curr->gc_marked = false;
+            live += size;
+            obj = &curr->gc_next;
+        } else {
+            *obj = curr->gc_next;
+            GC.stats.freed_bytes += size;
+            GC.stats.freed_objects++;
+            obj_free_object(curr);
+        }
+    }
+
+    obj_Env **env = &GC.envs;
+    while (*env != NULL) {
+        obj_Env *curr = *env;
+        size_t size = gc_env_size(curr);
+        if (curr->gc_marked) {
+            curr->gc_marked = false;
+            live += size;
+            env = &curr->gc_next;
+        } else {
+            *env = curr->gc_next;
+            GC.stats.freed_bytes += size;
+            GC.stats.freed_objects++;
+            obj_free_env(curr);
+        }
+    }
+
+    // buffers go when the last object reading them does
+    GC.stats.freed_bytes += buffer_bytes - GC.buffer_bytes;
+    return live + GC.buffer_bytes;
+}
+
+static long gc_now_us() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+void gc_collect() {
+    long start = gc_now_us();
+
+    gc_mark();
+    size_t live = gc_sweep();
+
+    // let the heap double before the next collection
+    GC.allocated = 0;
+    GC.next_collection = live > GC.threshold ? live : GC.threshold;
+
+    GC.stats.collections++;
+    GC.stats.heap_bytes = live;
+    GC.stats.last_pause_us = gc_now_us() - start;
+    GC.stats.total_pause_us += GC.stats.last_pause_us;
+}
+
+// a safe point - every object the caller still needs must be reachable
+void gc_maybe_collect() {
+    if (GC.allocated >= GC.next_collection) {
+        gc_collect();
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stddef.h>
+
+// forward decl
+typedef struct obj_Object obj_Object;
+typedef struct obj_Env obj_Env;
+
+void gc_track_object(obj_Object *obj);
+void gc_track_env(obj_Env *env);
+void gc_track_growth(size_t bytes);
+void gc_track_buffer(size_t bytes);
+void gc_untrack_buffer(size_t bytes);
+
+int gc_save_roots();
+void gc_restore_roots(int depth);
+void gc_push_root(obj_Object *obj);
+void gc_push_env_root(obj_Env *env);
+void gc_push_range_root(obj_Object **objs, const int *len);
+
+void gc_maybe_collect();
+void gc_collect();
+void gc_set_threshold(size_t bytes);
@@ -8,15 +8,26 @@
 #include <stdbool.h>
 #include <string.h>
 
+// the wasm build has no x86 simd, it always takes the scalar path
+#if defined(__AVX2__) && !defined(__EMSCRIPTEN__)
+#include <immintrin.h>
+#define LEX_SIMD_WIDTH 32
+#elif defined(__SSE2__) && !defined(__EMSCRIPTEN__)
+#include <emmintrin.h>
+#define LEX_SIMD_WIDTH 16
+#endif
+
+// the input is a ptr and a length, it doesn't need to be NUL terminated
 struct lex_Lexer {
     const char *input;
+    int input_len;
     int position; // current position in input (points to current char)
     int read_position; // current reading position in input (after current ch
     char ch; // current input char under examination
 };
 
 void lex_read_char(struct lex_Lexer *lexer) {
-    if (lexer->read_position >= (int)strlen(lexer->input)) {
+    if (lexer->read_position >= lexer->input_len) {
         lexer->ch = 0; // NUL ascii char
     } else {
         lexer->ch = lexer->input[lexer->read_position];
@@ -26,17 +37,28 @@ void lex_read_char(struct lex_Lexer *lexer) {
 }
 
 // constructor
-struct lex_Lexer lex_Lexer_create(const char *input) {
+struct lex_Lexer lex_Lexer_create_len(const char *input, int input_len) {
     struct lex_Lexer lex = {
         .input = input,
+        .input_len = input_len,
         .position = 0,
         .read_position = 0,
-        .ch = input[0],
+        .ch = 0,
     };
     lex_read_char(&lex);
     return lex;
 }
 
+struct lex_Lexer lex_Lexer_create(const char *input) {
+    return lex_Lexer_create_len(input, strlen(input));
+}
+
+// moves the lexer to position, past the end reads as NUL
+void lex_seek(struct lex_Lexer *lexer, int position) {
+    lexer->read_position = position;
+    lex_read_char(lexer);
+}
+
 bool lex_is_letter(char ch) {
     return isalpha(ch) || ch == '_';
 }
@@ -45,149 +67,278 @@ bool lex_is_alnum(char ch) {
     return isalnum(ch);
 }
 
-void lex_read_identifier(struct lex_Lexer *lexer, sstring str) {
-    int position = lexer->position;
-    while (lex_is_letter(lexer->ch)) {
-        lex_read_char(lexer);
+bool lex_is_space(char ch) {
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+bool lex_is_string_char(char ch) {
+    return ch != '"' && ch != '\0';
+}
+
+/*
+ * # Scanning
+ *
+ * Runs of whitespace, identifier and number chars and string bodies are
+ * skipped a whole vector at a time: each lex_mask_* sets bit i if byte i of
+ * the vector belongs to the run, the first clear bit is where the run ends.
+ * The last bytes of the input, short of a vector, go through the scalar
+ * lex_is_* predicates, which are also all the wasm build uses.
+ *
+ * Only ascii is classified, bytes >= 0x80 end every run but a string body's.
+ */
+#ifdef LEX_SIMD_WIDTH
+
+#if LEX_SIMD_WIDTH == 32
+typedef __m256i lex_Vec;
+#define LEX_MASK_ALL 0xFFFFFFFFu
+#define lex_vec_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define lex_vec_set(ch) _mm256_set1_epi8(ch)
+#define lex_vec_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define lex_vec_gt(a, b) _mm256_cmpgt_epi8(a, b)
+#define lex_vec_or(a, b) _mm256_or_si256(a, b)
+#define lex_vec_and(a, b) _mm256_and_si256(a, b)
+#define lex_vec_mask(a) ((unsigned)_mm256_movemask_epi8(a))
+#else
+typedef __m128i lex_Vec;
+#define LEX_MASK_ALL 0xFFFFu
+#define lex_vec_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define lex_vec_set(ch) _mm_set1_epi8(ch)
+#define lex_vec_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define lex_vec_gt(a, b) _mm_cmpgt_epi8(a, b)
+#define lex_vec_or(a, b) _mm_or_si128(a, b)
+#define lex_vec_and(a, b) _mm_and_si128(a, b)
+#define lex_vec_mask(a) ((unsigned)_mm_movemask_epi8(a))
+#endif
+
+// lo <= v <= hi, the compares are signed so bytes >= 0x80 are never in range
+static inline lex_Vec lex_vec_in_range(lex_Vec v, char lo, char hi) {
+    return lex_vec_and(
+        lex_vec_gt(v, lex_vec_set(lo - 1)),
+        lex_vec_gt(lex_vec_set(hi + 1), v)
+    );
+}
+
+// setting 0x20 folds upper to lower case and no other char into a-z
+static inline lex_Vec lex_vec_alpha(lex_Vec v) {
+    return lex_vec_in_range(lex_vec_or(v, lex_vec_set(0x20)), 'a', 'z');
+}
+
+static inline unsigned lex_mask_letter(const char *p) {
+    lex_Vec v = lex_vec_load(p);
+    return lex_vec_mask(
+        lex_vec_or(lex_vec_alpha(v), lex_vec_eq(v, lex_vec_set('_')))
+    );
+}
+
+static inline unsigned lex_mask_alnum(const char *p) {
+    lex_Vec v = lex_vec_load(p);
+    return lex_vec_mask(
+        lex_vec_or(lex_vec_alpha(v), lex_vec_in_range(v, '0', '9'))
+    );
+}
+
+static inline unsigned lex_mask_space(const char *p) {
+    lex_Vec v = lex_vec_load(p);
+    lex_Vec space = lex_vec_or(
+        lex_vec_eq(v, lex_vec_set(' ')),
+        lex_vec_eq(v, lex_vec_set('\n'))
+    );
+    lex_Vec control = lex_vec_or(
+        lex_vec_eq(v, lex_vec_set('\r')),
+        lex_vec_eq(v, lex_vec_set('\t'))
+    );
+    return lex_vec_mask(lex_vec_or(space, control));
+}
+
+static inline unsigned lex_mask_string_char(const char *p) {
+    lex_Vec v = lex_vec_load(p);
+    lex_Vec end = lex_vec_or(
+        lex_vec_eq(v, lex_vec_set('"')),
+        lex_vec_eq(v, lex_vec_set('\0'))
+    );
+    return ~lex_vec_mask(end) & LEX_MASK_ALL;
+}
+
+// the whole vectors, returns where the run ends or the position of the tail
+#define LEX_SCAN_VECTORS(input, position, input_len, mask)                    \
+    while (position + LEX_SIMD_WIDTH <= input_len) {                           \
+        unsigned end = ~mask(input + position) & LEX_MASK_ALL;                 \
+        if (end != 0) {                                                        \
+            return position + __builtin_ctz(end);                              \
+        }                                                                      \
+        position += LEX_SIMD_WIDTH;                                            \
     }
-    int str_len = lexer->position - position;
-    strncpy(str, lexer->input + position, str_len);
-    str[str_len] = '\0';
+
+#else
+#define LEX_SCAN_VECTORS(input, position, input_len, mask)
+#endif
+
+// returns the position of the first char from position which isn't in the run
+#define LEX_DEFINE_SCAN(name, is_char, mask)                                  \
+    int name(const char *input, int position, int input_len) {                 \
+        LEX_SCAN_VECTORS(input, position, input_len, mask)                     \
+        while (position < input_len && is_char(input[position])) {             \
+            position++;                                                        \
+        }                                                                      \
+        return position;                                                       \
+    }
+
+LEX_DEFINE_SCAN(lex_scan_letters, lex_is_letter, lex_mask_letter)
+LEX_DEFINE_SCAN(lex_scan_alnums, lex_is_alnum, lex_mask_alnum)
+LEX_DEFINE_SCAN(lex_scan_spaces, lex_is_space, lex_mask_space)
+LEX_DEFINE_SCAN(lex_scan_string, lex_is_string_char, lex_mask_string_char)
+
+// the token's text in the input, token.len long and not NUL terminated
+const char *
+lex_token_text(const struct lex_Lexer *lexer, struct tok_Token token) {
+    return lexer->input + token.offset;
 }
 
-void lex_read_number(struct lex_Lexer *lexer, sstring str) {
+// returns the length read
+int lex_read_identifier(struct lex_Lexer *lexer) {
     int position = lexer->position;
-    while (lex_is_alnum(lexer->ch)) {
-        lex_read_char(lexer);
-    }
-    int str_len = lexer->position - position;
-    strncpy(str, lexer->input + position, str_len);
-    str[str_len] = '\0';
+    lex_seek(
+        lexer,
+        lex_scan_letters(lexer->input, position, lexer->input_len)
+    );
+    return lexer->position - position;
+}
+
+// returns the length read
+int lex_read_number(struct lex_Lexer *lexer) {
+    int position = lexer->position;
+    lex_seek(
+        lexer,
+        lex_scan_alnums(lexer->input, position, lexer->input_len)
+    );
+    return lexer->position - position;
 }
 
 void lex_skip_whitespace(struct lex_Lexer *lexer) {
-    while (lexer->ch == ' ' || lexer->ch == '\n' || lexer->ch == '\r' ||
-           lexer->ch == '\t') {
-        lex_read_char(lexer);
+    // most tokens are followed by at most a single space
+    if (!lex_is_space(lexer->ch)) {
+        return;
     }
+    lex_seek(
+        lexer,
+        lex_scan_spaces(lexer->input, lexer->position, lexer->input_len)
+    );
 }
 
 char lex_peek_char(struct lex_Lexer *lexer) {
-    if (lexer->read_position >= (int)strlen(lexer->input)) {
+    if (lexer->read_position >= lexer->input_len) {
         return 0;
     }
     return lexer->input[lexer->read_position];
 }
 
-struct tok_Token tok_create_string_token(struct lex_Lexer *lexer) {
-    struct tok_Token tok = { .type = tok_STRING };
-
-    int position = lexer->position + 1;
-    while (1) {
-        lex_read_char(lexer);
-        if (lexer->ch == '"' || lexer->ch == '\0') {
-            break;
-        }
-    }
+// the token is the text between the quotes
+struct tok_Token lex_read_string(struct lex_Lexer *lexer) {
+    struct tok_Token tok = {
+        .type = tok_STRING,
+        .offset = lexer->position + 1,
+    };
 
-    // copy string part from input position
-    memcpy(
-        tok.literal,
-        lexer->input + position,
-        (lexer->position - position) * sizeof(char)
+    lex_seek(
+        lexer,
+        lex_scan_string(lexer->input, tok.offset, lexer->input_len)
     );
-    tok.literal[lexer->position - position] = '\0';
 
+    tok.len = lexer->position - tok.offset;
     return tok;
 }
 
 struct tok_Token lex_next_token(struct lex_Lexer *lexer) {
-    struct tok_Token token;
-
     lex_skip_whitespace(lexer);
 
+    // most tokens are a single char
+    struct tok_Token token = { .offset = lexer->position, .len = 1 };
+
     switch (lexer->ch) {
         case '=':
             if (lex_peek_char(lexer) == '=') {
                 lex_read_char(lexer);
-                strcpy(token.literal, "==");
                 token.type = tok_EQ;
+                token.len = 2;
             } else {
-                token = tok_Token_create(tok_ASSIGN, lexer->ch);
+                token.type = tok_ASSIGN;
             }
             break;
         case '+':
-            token = tok_Token_create(tok_PLUS, lexer->ch);
+            token.type = tok_PLUS;
             break;
         case '-':
-            token = tok_Token_create(tok_MINUS, lexer->ch);
+            token.type = tok_MINUS;
             break;
         case '!':
             if (lex_peek_char(lexer) == '=') {
                 lex_read_char(lexer);
-                strcpy(token.literal, "!=");
                 token.type = tok_NOT_EQ;
+                token.len = 2;
             } else {
-                token = tok_Token_create(tok_BANG, lexer->ch);
+                token.type = tok_BANG;
             }
             break;
         case '/':
-            token = tok_Token_create(tok_SLASH, lexer->ch);
+            token.type = tok_SLASH;
             break;
         case '*':
-            token = tok_Token_create(tok_ASTERISK, lexer->ch);
+            token.type = tok_ASTERISK;
             break;
         case '<':
-            token = tok_Token_create(tok_LT, lexer->ch);
+            token.type = tok_LT;
             break;
         case '>':
-            token = tok_Token_create(tok_GT, lexer->ch);
+            token.type = tok_GT;
             break;
         case ';':
-            token = tok_Token_create(tok_SEMICOLON, lexer->ch);
+            token.type = tok_SEMICOLON;
             break;
         case ':':
-            token = tok_Token_create(tok_COLON, lexer->ch);
+            token.type = tok_COLON;
             break;
         case ',':
-            token = tok_Token_create(tok_COMMA, lexer->ch);
+            token.type = tok_COMMA;
             break;
         case '(':
-            token = tok_Token_create(tok_LPAREN, lexer->ch);
+            token.type = tok_LPAREN;
             break;
         case ')':
-            token = tok_Token_create(tok_RPAREN, lexer->ch);
+            token.type = tok_RPAREN;
             break;
         case '{':
-            token = tok_Token_create(tok_LBRACE, lexer->ch);
+            token.type = tok_LBRACE;
             break;
         case '}':
-            token = tok_Token_create(tok_RBRACE, lexer->ch);
+            token.type = tok_RBRACE;
             break;
         case '"':
-            token = tok_create_string_token(lexer);
+            token = lex_read_string(lexer);
             break;
         case '[':
-            token = tok_Token_create(tok_LBRACKET, lexer->ch);
+            token.type = tok_LBRACKET;
             break;
         case ']':
-            token = tok_Token_create(tok_RBRACKET, lexer->ch);
+            token.type = tok_RBRACKET;
             break;
         case 0:
             token.type = tok_EOF;
-            strcpy(token.literal, "");
+            token.len = 0;
             break;
         default:
             if (lex_is_letter(lexer->ch)) {
-                lex_read_identifier(lexer, token.literal);
-                token.type = tok_lookup_identifier(token.literal);
+                token.len = lex_read_identifier(lexer);
+                token.type = tok_lookup_identifier(
+                    lex_token_text(lexer, token),
+                    token.len
+                );
                 return token;
             } else if (lex_is_alnum(lexer->ch)) {
-                lex_read_number(lexer, token.literal);
+                token.len = lex_read_number(lexer);
                 token.type = tok_INT;
                 return token;
             } else {
-                token = tok_Token_create(tok_ILLEGAL, lexer->ch);
+                token.type = tok_ILLEGAL;
             }
     }
 
@@ -195,4 +346,19 @@ struct tok_Token lex_next_token(struct lex_Lexer *lexer) {
     return token;
 }
 
+// lexes the rest of the input up front, the last token is the EOF
+struct tok_Token *lex_tokenize(struct lex_Lexer *lexer) {
+    struct tok_Token *tokens_da = NULL;
+    // scripts average a token every few chars
+    stbds_arrsetcap(tokens_da, lexer->input_len / 4 + 1);
+
+    struct tok_Token token;
+    do {
+        token = lex_next_token(lexer);
+        stbds_arrput(tokens_da, token);
+    } while (token.type != tok_EOF);
+
+    return tokens_da;
+}
+
 #endif
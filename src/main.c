@@ -1,8 +1,100 @@
 #include "repl.c"
+#include "run.c"
 
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 
+static const char USAGE[] = "\
+usage: lilac [--lexer | --parser | --dump-optimized | --vm]\n\
+             [--gc-threshold=N] [--max-depth=N]\n\
+       lilac run [--vm] [--gc-threshold=N] [--max-depth=N]\n\
+                 file.monkey\n";
+
+static int main_usage() {
+    fprintf(stderr, "%s", USAGE);
+    return run_EXIT_USAGE;
+}
+
+// the N of an option, false unless it's a whole number from 1 to max
+static bool main_parse_count(
+    const char *str,
+    unsigned long long max,
+    unsigned long long *n
+) {
+    // strtoull skips spaces and takes a sign, so "-1" would wrap around
+    if (*str < '0' || *str > '9') {
+        return false;
+    }
+    char *end = NULL;
+    errno = 0;
+    *n = strtoull(str, &end, 10);
+    return errno == 0 && *end == '\0' && *n > 0 && *n <= max;
+}
+
+// applies --gc-threshold=N or --max-depth=N, false if arg is neither or its N
+// is no valid count
+static bool main_set_limit(const char *arg) {
+    unsigned long long n = 0;
+    if (strncmp(arg, "--gc-threshold=", 15) == 0) {
+        if (!main_parse_count(arg + 15, SIZE_MAX, &n)) {
+            return false;
+        }
+        gc_set_threshold(n);
+        return true;
+    } else if (strncmp(arg, "--max-depth=", 12) == 0) {
+        if (!main_parse_count(arg + 12, INT_MAX, &n)) {
+            return false;
+        }
+        eval_set_max_depth((int)n);
+        return true;
+    }
+    return false;
+}
+
+// `lilac run file.monkey` - no banner, no prompt
+static int main_run(int argc, char *argv[]) {
+    const char *path = NULL;
+    bool use_vm = false;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--vm") == 0) {
+            use_vm = true;
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else if (!main_set_limit(argv[i])) {
+            return main_usage();
+        }
+    }
+
+    if (path == NULL) {
+        return main_usage();
+    }
+    return run_file(path, use_vm);
+}
+
 int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "run") == 0) {
+        return main_run(argc, argv);
+    }
+
+    // repl mode
+    enum repl_modes mode = repl_mode_EVAL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lexer") == 0) {
+            mode = repl_mode_LEXER;
+        } else if (strcmp(argv[i], "--parser") == 0) {
+            mode = repl_mode_PARSER;
+        } else if (strcmp(argv[i], "--dump-optimized") == 0) {
+            mode = repl_mode_OPTIMIZED;
+        } else if (strcmp(argv[i], "--vm") == 0) {
+            mode = repl_mode_VM;
+        } else if (!main_set_limit(argv[i])) {
+            return main_usage();
+        }
+    }
 
     printf("                  __\n");
     printf("     w  c(..)o   (\n");
@@ -17,17 +109,6 @@ int main(int argc, char *argv[]) {
     );
     printf("Feel free to type in the commands.\n");
 
-    // repl mode
-    enum repl_modes mode = repl_mode_EVAL;
-
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "--lexer") == 0) {
-            mode = repl_mode_LEXER;
-        } else if (strcmp(argv[i], "--parser") == 0) {
-            mode = repl_mode_PARSER;
-        }
-    }
-
     repl_start(mode);
     return 0;
 }
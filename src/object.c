@@ -1,10 +1,13 @@
 #pragma once
 #include "ast.h"
+#include "gc.h"
 #include "object_env.h"
 #include "util.c"
 
+#include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #define ENUMERATE_OBJECTS \
@@ -17,7 +20,8 @@
     __ENUMERATE_OBJECT(obj_FUNCTION) \
     __ENUMERATE_OBJECT(obj_BUILTIN) \
     __ENUMERATE_OBJECT(obj_ARRAY) \
-    __ENUMERATE_OBJECT(obj_HASH)
+    __ENUMERATE_OBJECT(obj_HASH) \
+    __ENUMERATE_OBJECT(obj_COMPILED_FUNCTION)
 
 enum obj_Type {
 #define __ENUMERATE_OBJECT(obj) obj,
@@ -25,6 +29,12 @@ enum obj_Type {
 #undef __ENUMERATE_OBJECT
 };
 
+enum {
+#define __ENUMERATE_OBJECT(obj) +1
+    obj_TYPE_COUNT = 0 ENUMERATE_OBJECTS
+#undef __ENUMERATE_OBJECT
+};
+
 const char *obj_object_name(enum obj_Type type) {
     switch (type) {
 #define __ENUMERATE_OBJECT(obj) \
@@ -36,22 +46,105 @@ const char *obj_object_name(enum obj_Type type) {
     assert(0 && "unreachable");
 }
 
+// a function literal evaluated in an env, or a vm closure
+struct obj_Func {
+    struct ast_Expr *lit; // shared, params and body point into it
+    struct util_Arena *arena; // keeps lit alive
+    struct ast_Expr **params; // only identifiers
+    struct ast_Stmt *body; // only block stmts
+    int num_slots; // size of the frame for a call
+    obj_Env *env;
+
+    // set only for vm closures - env is NULL then
+    struct obj_Object *compiled; // obj_COMPILED_FUNCTION
+    struct obj_Object **free_da; // captured free variables
+};
+
+// a function body lowered to bytecode by the compiler
+struct obj_Compiled_fn {
+    uint8_t *instructions_da;
+    int num_locals;
+    int num_params;
+
+    // kept only for inspecting the function
+    struct ast_Expr *lit;
+    struct util_Arena *arena;
+    struct ast_Expr **params;
+    struct ast_Stmt *body;
+};
+
+struct obj_Hash {
+    // entries in insertion order, room for 3/4 of slots_cap
+    struct obj_Hash_elem {
+        uint32_t hash;
+        struct obj_Object *key;
+        struct obj_Object *val;
+    } *elems;
+    int len;
+
+    // open addressing table of idxs into elems, -1 when empty
+    int *slots;
+    int slots_cap; // power of 2
+};
+
+// chars of longer strings, shared by the strings appended to them
+struct obj_Str_buf {
+    int refs; // string objects reading it
+    size_t len; // chars written so far
+    size_t cap;
+    char chars[];
+};
+
+// elems of arrays, shared by the arrays pushed to them and by their rests
+struct obj_Arr_buf {
+    int refs; // array objects reading it
+    int len; // elems written so far
+    int cap;
+    struct obj_Object *elems[];
+};
+
+// strings shorter than this are kept in the object itself
+#define OBJ_STR_SMALL_CAP sizeof(char *)
+#define OBJ_STR_MAX_LEN INT_MAX
+
+/*
+ * # Objects
+ *
+ * Every value is the same few words - a header for the gc and a union of two
+ * words at most. Anything bigger lives behind a ptr, so the objects the
+ * evaluator makes the most of stay small.
+ *
+ * Values are never changed once they were made, so reading a variable,
+ * binding it or passing it shares the value instead of copying it. The
+ * string and array buffers behind them are refcounted and only written past
+ * what every value reading them sees - a change is never observable, so
+ * there's nothing to copy on write.
+ */
+
 typedef struct obj_Object {
     enum obj_Type type;
+    bool gc_marked;
+    bool interned; // a string reading util_intern's chars, see obj_str
+    struct obj_Object *gc_next; // every heap object is in the gc's list
 
     union {
         int m_int;
         bool m_bool;
         struct obj_Object *m_return_obj;
         gbString m_err_msg;
+        struct obj_Func *m_func;
+        struct obj_Compiled_fn *m_compiled_fn;
 
+        // read it with obj_str, only short strings are NUL terminated
         struct {
-            struct ast_Expr **params; // only identifiers
-            struct ast_Stmt *body; // only block stmts
-            obj_Env *env;
-        } m_func;
-
-        sstring m_str;
+            uint32_t m_str_len;
+            uint32_t m_str_hash; // cached by obj_hash_key, 0 until then
+            union {
+                struct obj_Str_buf *m_str_buf; // its first m_str_len chars
+                const char *m_str_interned;
+                char m_str_small[OBJ_STR_SMALL_CAP];
+            };
+        };
 
         enum {
             BUILTIN_LEN,
@@ -60,19 +153,49 @@ typedef struct obj_Object {
             BUILTIN_REST,
             BUILTIN_PUSH,
             BUILTIN_PUTS,
+            BUILTIN_GC_STATS,
         } m_builtin;
 
-        obj_Object **m_arr_da;
+        // read it with obj_arr_elems, m_arr_len elems from m_arr_offset on
+        struct {
+            struct obj_Arr_buf *m_arr_buf; // NULL when empty
+            uint32_t m_arr_offset;
+            uint32_t m_arr_len;
+        };
 
-        struct obj_Hash {
-            struct obj_Hash_elem {
-                obj_Object *key;
-                obj_Object *val;
-            } **hash_da;
-        } m_hash;
+        struct obj_Hash *m_hash;
     };
 } obj_Object;
 
+/*
+ * # Immediate integers
+ *
+ * Integers live in the object ptr itself - the value shifted left by one with
+ * the low bit set - so they never touch the heap. Real objects are always
+ * aligned, so their low bit is free.
+ * Values which don't fit into a ptr (only on 32 bit targets like wasm32) fall
+ * back to a boxed obj_INTEGER, which is also what obj_int_val reads.
+ *
+ * Booleans and null are immediates already - ptrs to the native objects below.
+ * So never deref an object ptr for its type, use obj_type.
+ */
+
+#define OBJ_INT_TAG ((uintptr_t)1)
+
+static inline bool obj_is_tagged_int(const obj_Object *obj) {
+    return ((uintptr_t)obj & OBJ_INT_TAG) != 0;
+}
+
+static inline enum obj_Type obj_type(const obj_Object *obj) {
+    return obj_is_tagged_int(obj) ? obj_INTEGER : obj->type;
+}
+
+static inline int obj_int_val(const obj_Object *obj) {
+    if (obj_is_tagged_int(obj))
+        return (int)((intptr_t)obj >> 1);
+    return obj->m_int;
+}
+
 // Native objects to be referenced by ptrs
 static obj_Object NULL_OBJECT = { .type = obj_NULL };
 static obj_Object TRUE_OBJECT = { .type = obj_BOOLEAN, .m_bool = true };
@@ -90,12 +213,22 @@ obj_Object *obj_native_bool_object(bool val) {
     }
 }
 
+// maps any null or boolean object to its native object
+obj_Object *obj_native_bool_or_null(obj_Object *obj) {
+    if (obj->type == obj_NULL) {
+        return obj_null();
+    }
+    assert(obj->type == obj_BOOLEAN);
+    return obj_native_bool_object(obj->m_bool);
+}
+
 #define MAX_ERR_STRING_LEN 1024
 
 obj_Object *obj_alloc_err_object(const char *format, ...) {
-    obj_Object *err_obj = malloc(sizeof(obj_Object));
+    obj_Object *err_obj = util_slab_alloc(sizeof(obj_Object));
     err_obj->type = obj_ERROR;
     err_obj->m_err_msg = gb_make_string_length("", MAX_ERR_STRING_LEN);
+    gc_track_object(err_obj);
 
     va_list args;
     va_start(args, format);
@@ -105,172 +238,362 @@ obj_Object *obj_alloc_err_object(const char *format, ...) {
     return err_obj;
 }
 
-// FIXME: use arena for correct cleanup and easy allocation
+// the gc owns the object, it is freed once unreachable
 obj_Object *obj_alloc_object(enum obj_Type type) {
-    obj_Object *obj = NULL;
+    obj_Object *obj = util_slab_alloc(sizeof(obj_Object));
+    obj->type = type;
     switch (type) {
         case obj_INTEGER:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_INTEGER;
             break;
         case obj_RETURN_VALUE:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_RETURN_VALUE;
             obj->m_return_obj = NULL;
             break;
         case obj_FUNCTION:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_FUNCTION;
-            obj->m_func.params = NULL;
-            obj->m_func.body = NULL;
-            obj->m_func.env = NULL;
+            obj->m_func = util_slab_alloc(sizeof(struct obj_Func));
+            *obj->m_func = (struct obj_Func){ 0 };
             break;
-        case obj_STRING:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_STRING;
+        case obj_COMPILED_FUNCTION:
+            obj->m_compiled_fn =
+                util_slab_alloc(sizeof(struct obj_Compiled_fn));
+            *obj->m_compiled_fn = (struct obj_Compiled_fn){ 0 };
             break;
         case obj_BUILTIN:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_BUILTIN;
             break;
         case obj_ARRAY:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_ARRAY;
-            obj->m_arr_da = NULL;
+            obj->m_arr_buf = NULL;
+            obj->m_arr_offset = 0;
+            obj->m_arr_len = 0;
             break;
         case obj_HASH:
-            obj = malloc(sizeof(obj_Object));
-            obj->type = obj_HASH;
-            obj->m_hash.hash_da = NULL;
+            obj->m_hash = util_slab_alloc(sizeof(struct obj_Hash));
+            *obj->m_hash = (struct obj_Hash){ 0 };
             break;
         case obj_BOOLEAN: // should use the native objects
         case obj_ERROR: // use its own func
+        case obj_STRING: // use obj_alloc_str
         default:
             assert(0 && "unreachable");
     }
+    gc_track_object(obj);
     return obj;
 }
 
-void obj_free_object(obj_Object *obj) {
-    if (obj == NULL)
-        return;
-    switch (obj->type) {
-        case obj_STRING:
-        case obj_INTEGER:
-        case obj_BUILTIN:
-            free(obj);
-            break;
-        case obj_BOOLEAN:
-        case obj_NULL:
-            // NOTHING since we use native obj
-            break;
-        case obj_RETURN_VALUE:
-            obj_free_object(obj->m_return_obj);
-            free(obj);
-            break;
-        case obj_ERROR:
-            gb_free_string(obj->m_err_msg);
-            free(obj);
-            break;
-        case obj_FUNCTION:
-            for (int i = 0; i < stbds_arrlen(obj->m_func.params); ++i) {
-                ast_free_expr(obj->m_func.params[i]);
-            }
-            stbds_arrfree(obj->m_func.params);
-            ast_free_stmt(obj->m_func.body);
-            obj_free_env(obj->m_func.env);
-            free(obj);
-            break;
-        case obj_ARRAY:
-            for (int i = 0; i < stbds_arrlen(obj->m_arr_da); ++i) {
-                obj_free_object(obj->m_arr_da[i]);
-            }
-            stbds_arrfree(obj->m_arr_da);
-            free(obj);
-            break;
-        case obj_HASH:
-            for (int i = 0; i < stbds_arrlen(obj->m_hash.hash_da); ++i) {
-                obj_free_object(obj->m_hash.hash_da[i]->key);
-                obj_free_object(obj->m_hash.hash_da[i]->val);
-            }
-            stbds_arrfree(obj->m_hash.hash_da);
-            free(obj);
-            break;
-        default:
-            assert(0 && "unreachable");
+/*
+ * # Strings
+ *
+ * Strings are never changed, but a string's heap chars can be followed by
+ * more. `acc + piece` writes piece right after acc's chars when nothing was
+ * appended to them yet and the buffer has room, and the result shares the
+ * buffer - so building a string piece by piece is linear, not quadratic.
+ * Buffers are grown by doubling, every string reading one holds a ref.
+ *
+ * Literals read the parser's interned chars instead, which are never
+ * appended to. Interned strings are equal only if their chars are the same
+ * ptr, so literal keys are compared without reading them. Strings made at
+ * run time are never interned - the intern table is never swept.
+ */
+
+// chars of a string object, only written while filling a new string
+static inline char *obj_str(obj_Object *obj) {
+    if (obj->m_str_len < OBJ_STR_SMALL_CAP)
+        return obj->m_str_small;
+    return obj->interned ? (char *)obj->m_str_interned : obj->m_str_buf->chars;
+}
+
+static inline size_t obj_str_len(const obj_Object *obj) {
+    return obj->m_str_len;
+}
+
+static struct obj_Str_buf *obj_alloc_str_buf(size_t cap) {
+    struct obj_Str_buf *buf =
+        util_slab_alloc(sizeof(struct obj_Str_buf) + cap);
+    buf->refs = 0;
+    buf->len = 0;
+    buf->cap = cap;
+    gc_track_buffer(sizeof(struct obj_Str_buf) + cap);
+    return buf;
+}
+
+static void obj_release_str_buf(struct obj_Str_buf *buf) {
+    if (--buf->refs == 0) {
+        gc_untrack_buffer(sizeof(struct obj_Str_buf) + buf->cap);
+        util_slab_free(buf, sizeof(struct obj_Str_buf) + buf->cap);
+    }
+}
+
+// a string of the first len chars of buf
+static obj_Object *obj_alloc_buf_str(struct obj_Str_buf *buf, size_t len) {
+    assert(len <= OBJ_STR_MAX_LEN && len <= buf->len);
+    obj_Object *obj = util_slab_alloc(sizeof(obj_Object));
+    obj->type = obj_STRING;
+    obj->interned = false;
+    obj->m_str_len = len;
+    obj->m_str_hash = 0;
+    obj->m_str_buf = buf;
+    buf->refs++;
+    gc_track_object(obj);
+    return obj;
+}
+
+// copies len bytes of str - a NULL str leaves them for the caller to fill
+obj_Object *obj_alloc_str(const char *str, size_t len) {
+    assert(len <= OBJ_STR_MAX_LEN);
+    if (len >= OBJ_STR_SMALL_CAP) {
+        struct obj_Str_buf *buf = obj_alloc_str_buf(len);
+        buf->len = len;
+        if (str != NULL) {
+            memcpy(buf->chars, str, len);
+        }
+        return obj_alloc_buf_str(buf, len);
+    }
+
+    obj_Object *obj = util_slab_alloc(sizeof(obj_Object));
+    obj->type = obj_STRING;
+    obj->interned = false;
+    obj->m_str_len = len;
+    obj->m_str_hash = 0;
+    if (str != NULL) {
+        memcpy(obj->m_str_small, str, len);
+    }
+    obj->m_str_small[len] = '\0';
+    gc_track_object(obj);
+    return obj;
+}
+
+obj_Object *obj_alloc_cstr(const char *str) {
+    return obj_alloc_str(str, strlen(str));
+}
+
+// str must be from util_intern, it isn't copied
+obj_Object *obj_alloc_interned_str(const char *str, size_t len) {
+    if (len < OBJ_STR_SMALL_CAP) {
+        return obj_alloc_str(str, len);
+    }
+
+    obj_Object *obj = util_slab_alloc(sizeof(obj_Object));
+    obj->type = obj_STRING;
+    obj->interned = true;
+    obj->m_str_len = len;
+    obj->m_str_hash = 0;
+    obj->m_str_interned = str;
+    gc_track_object(obj);
+    return obj;
+}
+
+// left + right, their lengths must fit a string
+obj_Object *obj_str_concat(obj_Object *left, obj_Object *right) {
+    size_t l_len = left->m_str_len;
+    size_t r_len = right->m_str_len;
+    size_t len = l_len + r_len;
+    assert(len <= OBJ_STR_MAX_LEN);
+
+    struct obj_Str_buf *buf = NULL;
+    if (len < OBJ_STR_SMALL_CAP) {
+        obj_Object *obj = obj_alloc_str(NULL, len);
+        memcpy(obj_str(obj), obj_str(left), l_len);
+        memcpy(obj_str(obj) + l_len, obj_str(right), r_len);
+        return obj;
+    } else if (l_len >= OBJ_STR_SMALL_CAP && !left->interned &&
+               left->m_str_buf->len == l_len) {
+        // left is the end of its buffer, it's likely appended to again
+        buf = left->m_str_buf;
+        if (buf->cap - l_len < r_len) {
+            buf = obj_alloc_str_buf(len * 2);
+            memcpy(buf->chars, obj_str(left), l_len);
+        }
+    } else {
+        buf = obj_alloc_str_buf(len);
+        memcpy(buf->chars, obj_str(left), l_len);
     }
+
+    // right may read the same buffer, but only chars before buf->len
+    memcpy(buf->chars + l_len, obj_str(right), r_len);
+    buf->len = len;
+    return obj_alloc_buf_str(buf, len);
+}
+
+/*
+ * # Arrays
+ *
+ * Arrays are views of a buffer of elems, like strings are of their chars.
+ * `rest` is the same buffer one elem further on, `push` writes the elem
+ * right after the array's last one when nothing was pushed there yet. Arrays
+ * are never changed, so they share buffers freely - building an array by
+ * pushing or walking it with `rest` copies nothing.
+ */
+
+static inline int obj_arr_len(const obj_Object *obj) {
+    return obj->m_arr_len;
 }
 
-obj_Object *obj_deepcpy(obj_Object *src) {
-    if (src == NULL)
+// only written while filling a new array
+static inline obj_Object **obj_arr_elems(obj_Object *obj) {
+    if (obj->m_arr_buf == NULL)
         return NULL;
+    return obj->m_arr_buf->elems + obj->m_arr_offset;
+}
 
-    obj_Object *dest = malloc(sizeof(obj_Object));
-    memcpy(dest, src, sizeof(obj_Object));
+#define OBJ_ARR_BUF_SIZE(cap) \
+    (sizeof(struct obj_Arr_buf) + (cap) * sizeof(obj_Object *))
 
-    switch (src->type) {
-        case obj_INTEGER:
-        case obj_BOOLEAN:
+static struct obj_Arr_buf *obj_alloc_arr_buf(int cap) {
+    struct obj_Arr_buf *buf = util_slab_alloc(OBJ_ARR_BUF_SIZE(cap));
+    buf->refs = 0;
+    buf->len = 0;
+    buf->cap = cap;
+    gc_track_buffer(OBJ_ARR_BUF_SIZE(cap));
+    return buf;
+}
+
+static void obj_release_arr_buf(struct obj_Arr_buf *buf) {
+    if (--buf->refs == 0) {
+        gc_untrack_buffer(OBJ_ARR_BUF_SIZE(buf->cap));
+        util_slab_free(buf, OBJ_ARR_BUF_SIZE(buf->cap));
+    }
+}
+
+// len elems of buf from offset on
+static obj_Object *
+obj_alloc_buf_arr(struct obj_Arr_buf *buf, int offset, int len) {
+    obj_Object *obj = util_slab_alloc(sizeof(obj_Object));
+    obj->type = obj_ARRAY;
+    obj->m_arr_buf = len == 0 ? NULL : buf;
+    obj->m_arr_offset = offset;
+    obj->m_arr_len = len;
+    if (obj->m_arr_buf != NULL) {
+        buf->refs++;
+    }
+    gc_track_object(obj);
+    return obj;
+}
+
+// copies len elems - NULL elems leaves them for the caller to fill
+obj_Object *obj_alloc_arr(obj_Object **elems, int len) {
+    if (len == 0) {
+        return obj_alloc_object(obj_ARRAY);
+    }
+
+    struct obj_Arr_buf *buf = obj_alloc_arr_buf(len);
+    buf->len = len;
+    if (elems != NULL) {
+        memcpy(buf->elems, elems, len * sizeof(obj_Object *));
+    }
+    return obj_alloc_buf_arr(buf, 0, len);
+}
+
+// arr with elem after its last one
+obj_Object *obj_arr_push(obj_Object *arr, obj_Object *elem) {
+    int len = arr->m_arr_len;
+    struct obj_Arr_buf *buf = arr->m_arr_buf;
+    int end = arr->m_arr_offset + len;
+
+    // in place only if arr ends its buffer and there's room after it
+    if (buf == NULL || buf->len != end || buf->cap == end) {
+        buf = obj_alloc_arr_buf(len < 4 ? 8 : len * 2);
+        if (len != 0) {
+            memcpy(buf->elems, obj_arr_elems(arr), len * sizeof(obj_Object *));
+        }
+        end = len;
+    }
+
+    buf->elems[end] = elem;
+    buf->len = end + 1;
+    return obj_alloc_buf_arr(buf, end - len, len + 1);
+}
+
+// arr without its first elem, arr mustn't be empty
+obj_Object *obj_arr_rest(obj_Object *arr) {
+    assert(arr->m_arr_len > 0);
+    return obj_alloc_buf_arr(
+        arr->m_arr_buf,
+        arr->m_arr_offset + 1,
+        arr->m_arr_len - 1
+    );
+}
+
+// never allocates on 64 bit targets
+obj_Object *obj_int(int val) {
+#if INTPTR_MAX <= INT32_MAX
+    if (val < INTPTR_MIN / 2 || val > INTPTR_MAX / 2) {
+        obj_Object *obj = obj_alloc_object(obj_INTEGER);
+        obj->m_int = val;
+        return obj;
+    }
+#endif
+    return (obj_Object *)(((uintptr_t)(intptr_t)val << 1) | OBJ_INT_TAG);
+}
+
+void obj_hash_free(struct obj_Hash *hash);
+
+// only the gc frees objects - referenced objects are swept on their own
+void obj_free_object(obj_Object *obj) {
+    switch (obj->type) {
         case obj_ERROR:
-        case obj_STRING:
-        case obj_BUILTIN:
-            // NOTHING - since no deep ptrs
-            break;
-        case obj_RETURN_VALUE:
-            dest->m_return_obj = obj_deepcpy(src->m_return_obj);
+            gb_free_string(obj->m_err_msg);
             break;
         case obj_FUNCTION:
-            dest->m_func.params = ast_deepcpy_fn_params(src->m_func.params);
-            dest->m_func.body = ast_deepcopy_stmt(src->m_func.body);
-            dest->m_func.env = (src->m_func.env);
+            util_arena_release(obj->m_func->arena);
+            stbds_arrfree(obj->m_func->free_da);
+            util_slab_free(obj->m_func, sizeof(struct obj_Func));
+            break;
+        case obj_COMPILED_FUNCTION:
+            stbds_arrfree(obj->m_compiled_fn->instructions_da);
+            util_arena_release(obj->m_compiled_fn->arena);
+            util_slab_free(obj->m_compiled_fn, sizeof(struct obj_Compiled_fn));
+            break;
+        case obj_STRING:
+            if (obj->m_str_len >= OBJ_STR_SMALL_CAP && !obj->interned) {
+                obj_release_str_buf(obj->m_str_buf);
+            }
             break;
         case obj_ARRAY:
-            dest->m_arr_da = NULL;
-            for (int i = 0; i < stbds_arrlen(src->m_arr_da); ++i) {
-                stbds_arrput(dest->m_arr_da, obj_deepcpy(src->m_arr_da[i]));
+            if (obj->m_arr_buf != NULL) {
+                obj_release_arr_buf(obj->m_arr_buf);
             }
             break;
         case obj_HASH:
-            dest->m_hash.hash_da = NULL;
-            for (int i = 0; i < stbds_arrlen(src->m_hash.hash_da); ++i) {
-                struct obj_Hash_elem *elem =
-                    malloc(sizeof(struct ast_Hash_elem));
-                elem->key = obj_deepcpy(src->m_hash.hash_da[i]->key);
-                elem->val = obj_deepcpy(src->m_hash.hash_da[i]->val);
-                stbds_arrput(dest->m_hash.hash_da, elem);
-            }
+            obj_hash_free(obj->m_hash);
             break;
         default:
-            assert(0 && "unreachable");
+            // NOTHING - no owned memory
+            break;
     }
-    return dest;
+    util_slab_free(obj, sizeof(obj_Object));
 }
 
 bool obj_is_err(obj_Object *obj) {
-    return (obj == NULL ? false : (obj->type == obj_ERROR));
+    return (obj == NULL ? false : (obj_type(obj) == obj_ERROR));
 }
 
-bool obj_is_same(obj_Object *a, obj_Object *b) {
+obj_Object *obj_hash_get(obj_Object *obj, obj_Object *key);
+
+// compares all but the elems of arrays, hashes and return values, the pairs
+// of those are pushed to pairs_da for the caller to compare
+static bool
+obj_is_same_shallow(obj_Object *a, obj_Object *b, obj_Object ***pairs_da) {
     if (a == b)
         return true; // Same pointer or both NULL
     if (!a || !b)
         return false; // One is NULL
-    if (a->type != b->type)
+    if (obj_type(a) != obj_type(b))
         return false; // Different types
 
-    switch (a->type) {
+    switch (obj_type(a)) {
         case obj_INTEGER:
-            return a->m_int == b->m_int;
+            return obj_int_val(a) == obj_int_val(b);
 
         case obj_BOOLEAN:
             return a->m_bool == b->m_bool;
 
         case obj_RETURN_VALUE:
-            return obj_is_same(a->m_return_obj, b->m_return_obj);
+            stbds_arrput(*pairs_da, a->m_return_obj);
+            stbds_arrput(*pairs_da, b->m_return_obj);
+            return true;
 
         case obj_ERROR:
             return strcmp(a->m_err_msg, b->m_err_msg) == 0;
 
+        case obj_COMPILED_FUNCTION:
         case obj_FUNCTION: {
             // Functions are only equal if they're the same instance
             // since they might have different closures/environments
@@ -278,49 +601,41 @@ bool obj_is_same(obj_Object *a, obj_Object *b) {
         }
 
         case obj_STRING:
-            return strcmp(a->m_str, b->m_str) == 0;
+            if (a->interned && b->interned)
+                return a->m_str_interned == b->m_str_interned;
+            return a->m_str_len == b->m_str_len &&
+                   memcmp(obj_str(a), obj_str(b), a->m_str_len) == 0;
 
         case obj_BUILTIN:
             return a->m_builtin == b->m_builtin;
 
         case obj_ARRAY: {
-            int len_a = stbds_arrlen(a->m_arr_da);
-            int len_b = stbds_arrlen(b->m_arr_da);
+            int len_a = obj_arr_len(a);
+            int len_b = obj_arr_len(b);
             if (len_a != len_b)
                 return false;
 
             for (int i = 0; i < len_a; i++) {
-                if (!obj_is_same(a->m_arr_da[i], b->m_arr_da[i])) {
-                    return false;
-                }
+                stbds_arrput(*pairs_da, obj_arr_elems(a)[i]);
+                stbds_arrput(*pairs_da, obj_arr_elems(b)[i]);
             }
             return true;
         }
 
         case obj_HASH: {
-            int len_a = stbds_arrlen(a->m_hash.hash_da);
-            int len_b = stbds_arrlen(b->m_hash.hash_da);
+            int len_a = a->m_hash->len;
+            int len_b = b->m_hash->len;
             if (len_a != len_b)
                 return false;
 
-            // For each key-value pair in a, find matching pair in b
+            // For each key-value pair in a, lookup the key in b
             for (int i = 0; i < len_a; i++) {
-                bool found = false;
-                for (int j = 0; j < len_b; j++) {
-                    if (obj_is_same(
-                            a->m_hash.hash_da[i]->key,
-                            b->m_hash.hash_da[j]->key
-                        ) &&
-                        obj_is_same(
-                            a->m_hash.hash_da[i]->val,
-                            b->m_hash.hash_da[j]->val
-                        )) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found)
+                struct obj_Hash_elem *elem = &a->m_hash->elems[i];
+                obj_Object *val = obj_hash_get(b, elem->key);
+                if (val == NULL)
                     return false;
+                stbds_arrput(*pairs_da, elem->val);
+                stbds_arrput(*pairs_da, val);
             }
             return true;
         }
@@ -330,6 +645,20 @@ bool obj_is_same(obj_Object *a, obj_Object *b) {
     }
 }
 
+// nested values are compared off an explicit stack of pairs, so any depth
+// of nesting compares in constant c stack
+bool obj_is_same(obj_Object *a, obj_Object *b) {
+    obj_Object **pairs_da = NULL;
+    bool same = obj_is_same_shallow(a, b, &pairs_da);
+    while (same && stbds_arrlen(pairs_da) > 0) {
+        obj_Object *y = stbds_arrpop(pairs_da);
+        obj_Object *x = stbds_arrpop(pairs_da);
+        same = obj_is_same_shallow(x, y, &pairs_da);
+    }
+    stbds_arrfree(pairs_da);
+    return same;
+}
+
 bool obj_is_truthy(obj_Object *obj) {
     if (obj_is_same(obj, &NULL_OBJECT)) {
         return false;
@@ -342,100 +671,248 @@ bool obj_is_truthy(obj_Object *obj) {
     }
 }
 
+// what is left to print, the values in arrays and hashes are pushed with the
+// punctuation between them, so any depth of nesting prints in constant c stack
+struct obj_Inspect_item {
+    obj_Object *obj; // NULL for a lit
+    const char *lit;
+};
+
+#define OBJ_INSPECT_PUSH_LIT(items_da, str) \
+    stbds_arrput(items_da, ((struct obj_Inspect_item){ .lit = (str) }))
+#define OBJ_INSPECT_PUSH_OBJ(items_da, val) \
+    stbds_arrput(items_da, ((struct obj_Inspect_item){ .obj = (val) }))
+
 gbString obj_object_inspect(obj_Object *obj) {
     if (obj == NULL)
         return NULL;
     gbString res = gb_make_string("");
-    switch (obj->type) {
-        case obj_INTEGER:
-            res = gb_append_cstring(res, util_int_to_str(obj->m_int));
-            break;
-        case obj_BOOLEAN:
-            res = gb_append_cstring(res, obj->m_bool ? "true" : "false");
-            break;
-        case obj_NULL:
-            res = gb_append_cstring(res, "null");
-            break;
-        case obj_RETURN_VALUE:
-            res = obj_object_inspect(obj->m_return_obj);
-            break;
-        case obj_ERROR:
-            res = gb_append_cstring(res, "ERROR: ");
-            res = gb_append_string(res, obj->m_err_msg);
-            break;
-        case obj_FUNCTION:
-            res = gb_append_cstring(res, "fn(");
-            for (int i = 0; i < stbds_arrlen(obj->m_func.params); ++i) {
-                struct ast_Expr *param = obj->m_func.params[i];
-                assert(param->tag == ast_IDENT_EXPR);
-                res = gb_append_cstring(res, param->data.ident.value);
-                if (i == stbds_arrlen(obj->m_func.params) - 1) {
-                    break;
+    struct obj_Inspect_item *items_da = NULL;
+    OBJ_INSPECT_PUSH_OBJ(items_da, obj);
+
+    while (stbds_arrlen(items_da) > 0) {
+        // gb strings grow by exactly what is appended, double them instead
+        if (gb_string_available_space(res) < 64) {
+            res = gb_make_space_for(res, gb_string_length(res) + 64);
+        }
+        struct obj_Inspect_item item = stbds_arrpop(items_da);
+        if (item.obj == NULL) {
+            res = gb_append_cstring(res, item.lit);
+            continue;
+        }
+
+        obj = item.obj;
+        switch (obj_type(obj)) {
+            case obj_INTEGER:
+                res =
+                    gb_append_cstring(res, util_int_to_str(obj_int_val(obj)));
+                break;
+            case obj_BOOLEAN:
+                res = gb_append_cstring(res, obj->m_bool ? "true" : "false");
+                break;
+            case obj_NULL:
+                res = gb_append_cstring(res, "null");
+                break;
+            case obj_RETURN_VALUE:
+                OBJ_INSPECT_PUSH_OBJ(items_da, obj->m_return_obj);
+                break;
+            case obj_ERROR:
+                res = gb_append_cstring(res, "ERROR: ");
+                res = gb_append_string(res, obj->m_err_msg);
+                break;
+            case obj_FUNCTION: {
+                res = gb_append_cstring(res, "fn(");
+                int n = stbds_arrlen(obj->m_func->params);
+                for (int i = 0; i < n; ++i) {
+                    struct ast_Expr *param = obj->m_func->params[i];
+                    assert(param->tag == ast_IDENT_EXPR);
+                    res = gb_append_cstring(res, param->data.ident.value);
+                    if (i == n - 1) {
+                        break;
+                    }
+                    res = gb_append_cstring(res, ", ");
                 }
-                res = gb_append_cstring(res, ", ");
+                res = gb_append_cstring(res, ") {\n");
+                res = gb_append_cstring(
+                    res,
+                    ast_make_stmt_str(obj->m_func->body)
+                );
+                res = gb_append_cstring(res, "\n}");
+                break;
             }
-            res = gb_append_cstring(res, ") {\n");
-            res = gb_append_cstring(res, ast_make_stmt_str(obj->m_func.body));
-            res = gb_append_cstring(res, "\n}");
-            break;
-        case obj_STRING:
-            res = gb_append_cstring(res, obj->m_str);
-            break;
-        case obj_BUILTIN:
-            res = gb_append_cstring(res, "builtin function");
-            break;
-        case obj_ARRAY:
-            res = gb_append_cstring(res, "[");
-            for (int i = 0; i < stbds_arrlen(obj->m_arr_da); ++i) {
-                obj_Object *elem = obj->m_arr_da[i];
-                res = gb_append_cstring(res, obj_object_inspect(elem));
-                if (i == stbds_arrlen(obj->m_arr_da) - 1) {
-                    break;
-                }
-                res = gb_append_cstring(res, ", ");
+            case obj_STRING:
+                res =
+                    gb_append_string_length(res, obj_str(obj), obj->m_str_len);
+                break;
+            case obj_BUILTIN:
+                res = gb_append_cstring(res, "builtin function");
+                break;
+            case obj_COMPILED_FUNCTION: {
+                char addr[64];
+                sprintf(addr, "compiled function[%p]", (void *)obj);
+                res = gb_append_cstring(res, addr);
+                break;
             }
-            res = gb_append_cstring(res, "]");
-            break;
-        case obj_HASH:
-            res = gb_append_cstring(res, "{");
-            for (int i = 0; i < stbds_arrlen(obj->m_hash.hash_da); ++i) {
-                gbString key = obj_object_inspect(obj->m_hash.hash_da[i]->key);
-                gbString val = obj_object_inspect(obj->m_hash.hash_da[i]->val);
-                res = gb_append_string(res, key);
-                res = gb_append_cstring(res, ": ");
-                res = gb_append_string(res, val);
-                if (i == stbds_arrlen(obj->m_hash.hash_da) - 1) {
-                    break;
+            case obj_ARRAY:
+                res = gb_append_cstring(res, "[");
+                OBJ_INSPECT_PUSH_LIT(items_da, "]");
+                for (int i = obj_arr_len(obj) - 1; i >= 0; --i) {
+                    OBJ_INSPECT_PUSH_OBJ(items_da, obj_arr_elems(obj)[i]);
+                    if (i > 0) {
+                        OBJ_INSPECT_PUSH_LIT(items_da, ", ");
+                    }
+                }
+                break;
+            case obj_HASH:
+                res = gb_append_cstring(res, "{");
+                OBJ_INSPECT_PUSH_LIT(items_da, "}");
+                for (int i = obj->m_hash->len - 1; i >= 0; --i) {
+                    OBJ_INSPECT_PUSH_OBJ(items_da, obj->m_hash->elems[i].val);
+                    OBJ_INSPECT_PUSH_LIT(items_da, ": ");
+                    OBJ_INSPECT_PUSH_OBJ(items_da, obj->m_hash->elems[i].key);
+                    if (i > 0) {
+                        OBJ_INSPECT_PUSH_LIT(items_da, ", ");
+                    }
                 }
-                res = gb_append_cstring(res, ", ");
+                break;
+            default:
+                assert(0 && "unreachable");
+        }
+    }
+    stbds_arrfree(items_da);
+    return res;
+}
+
+/*
+ * # Hash objects
+ *
+ * Only integers, booleans and strings can be hash keys. Key hashes are kept
+ * on the entries and string hashes are also cached on the string itself, so
+ * a key is hashed at most once. A literal key looked up in a hash built with
+ * literal keys compares ptrs, other string keys compare their chars once the
+ * hashes match.
+ */
+
+bool obj_is_hashable(obj_Object *obj) {
+    switch (obj_type(obj)) {
+        case obj_INTEGER:
+        case obj_BOOLEAN:
+        case obj_STRING:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t obj_hash_str(const char *str) {
+    return util_hash_bytes(str, strlen(str));
+}
+
+uint32_t obj_hash_key(obj_Object *key) {
+    switch (obj_type(key)) {
+        case obj_INTEGER: {
+            uint32_t hash = (uint32_t)obj_int_val(key) * 2654435769u;
+            return hash ^ (hash >> 16);
+        }
+        case obj_BOOLEAN:
+            return key->m_bool ? 1231 : 1237;
+        case obj_STRING:
+            if (key->m_str_hash == 0) {
+                uint32_t hash = util_hash_bytes(obj_str(key), key->m_str_len);
+                key->m_str_hash = hash == 0 ? 1 : hash;
             }
-            res = gb_append_cstring(res, "}");
-            break;
+            return key->m_str_hash;
         default:
             assert(0 && "unreachable");
     }
-    return res;
 }
 
-void obj_hash_put(obj_Object *obj, obj_Object *key, obj_Object *val) {
-    int found_times = 0;
-    int found_idx = -1;
-
-    int n = stbds_arrlen(obj->m_hash.hash_da);
-    for (int i = 0; i < n; ++i) {
-        if (obj_is_same(obj->m_hash.hash_da[i]->key, key)) {
-            found_times++;
-            found_idx = i;
+// slot holding the key, or the empty slot it should be put into
+static int
+obj_hash_find_slot(struct obj_Hash *hash, obj_Object *key, uint32_t key_hash) {
+    uint32_t mask = hash->slots_cap - 1;
+    for (uint32_t i = key_hash & mask;; i = (i + 1) & mask) {
+        int idx = hash->slots[i];
+        if (idx == -1) {
+            return i;
+        }
+        struct obj_Hash_elem *elem = &hash->elems[idx];
+        if (elem->hash == key_hash && obj_is_same(elem->key, key)) {
+            return i;
+        }
+    }
+}
+
+#define OBJ_HASH_ELEMS_SIZE(slots_cap) \
+    ((slots_cap) / 4 * 3 * sizeof(struct obj_Hash_elem))
+
+void obj_hash_free(struct obj_Hash *hash) {
+    util_slab_free(hash->elems, OBJ_HASH_ELEMS_SIZE(hash->slots_cap));
+    util_slab_free(hash->slots, hash->slots_cap * sizeof(int));
+    util_slab_free(hash, sizeof(struct obj_Hash));
+}
+
+static void obj_hash_grow(struct obj_Hash *hash) {
+    int old_cap = hash->slots_cap;
+    hash->slots_cap = old_cap == 0 ? 8 : old_cap * 2;
+
+    struct obj_Hash_elem *elems =
+        util_slab_alloc(OBJ_HASH_ELEMS_SIZE(hash->slots_cap));
+    if (hash->len != 0) {
+        memcpy(elems, hash->elems, hash->len * sizeof(struct obj_Hash_elem));
+    }
+    util_slab_free(hash->elems, OBJ_HASH_ELEMS_SIZE(old_cap));
+    hash->elems = elems;
+
+    util_slab_free(hash->slots, old_cap * sizeof(int));
+    hash->slots = util_slab_alloc(hash->slots_cap * sizeof(int));
+    memset(hash->slots, -1, hash->slots_cap * sizeof(int));
+    gc_track_growth(
+        OBJ_HASH_ELEMS_SIZE(hash->slots_cap) - OBJ_HASH_ELEMS_SIZE(old_cap) +
+        (hash->slots_cap - old_cap) * sizeof(int)
+    );
+
+    uint32_t mask = hash->slots_cap - 1;
+    for (int idx = 0; idx < hash->len; ++idx) {
+        uint32_t i = hash->elems[idx].hash & mask;
+        while (hash->slots[i] != -1) {
+            i = (i + 1) & mask;
         }
+        hash->slots[i] = idx;
+    }
+}
+
+// returns NULL when the key is missing
+obj_Object *obj_hash_get(obj_Object *obj, obj_Object *key) {
+    assert(obj_is_hashable(key));
+    struct obj_Hash *hash = obj->m_hash;
+    if (hash->slots_cap == 0) {
+        return NULL;
+    }
+
+    int idx = hash->slots[obj_hash_find_slot(hash, key, obj_hash_key(key))];
+    return idx == -1 ? NULL : hash->elems[idx].val;
+}
+
+void obj_hash_put(obj_Object *obj, obj_Object *key, obj_Object *val) {
+    assert(obj_is_hashable(key));
+    struct obj_Hash *hash = obj->m_hash;
+
+    // keep the load factor under 3/4
+    if ((hash->len + 1) * 4 > hash->slots_cap * 3) {
+        obj_hash_grow(hash);
     }
-    assert(found_times == 0 || found_times == 1);
 
-    if (found_times == 1) {
-        obj->m_hash.hash_da[found_idx]->val = val;
+    uint32_t key_hash = obj_hash_key(key);
+    int slot = obj_hash_find_slot(hash, key, key_hash);
+    if (hash->slots[slot] != -1) {
+        hash->elems[hash->slots[slot]].val = val;
     } else {
-        struct obj_Hash_elem *elem = malloc(sizeof(struct ast_Hash_elem));
-        elem->key = key;
-        elem->val = val;
-        stbds_arrput(obj->m_hash.hash_da, elem);
+        hash->elems[hash->len] = (struct obj_Hash_elem){
+            .hash = key_hash,
+            .key = key,
+            .val = val,
+        };
+        hash->slots[slot] = hash->len++;
     }
 }
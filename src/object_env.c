@@ -2,61 +2,45 @@
 #include "object_env.h"
 
 obj_Env *obj_alloc_env() {
-    obj_Env *env = malloc(sizeof(obj_Env));
-    env->store = NULL;
-    env->outer = NULL;
-    return env;
-}
-
-obj_Env *obj_alloc_enclosed_env(obj_Env *outer) {
-    obj_Env *env = obj_alloc_env();
-    env->outer = obj_env_deepcpy(outer);
-    return env;
-}
-
-void obj_free_env(obj_Env *obj) {
-    if (obj == NULL)
-        return;
-    stbds_arrfree(obj->store);
-    obj_free_env(obj->outer);
-    free(obj);
+    return obj_alloc_enclosed_env(NULL, 0);
 }
 
-obj_Env *obj_env_deepcpy(obj_Env *obj) {
-    if (obj == NULL)
+static obj_Object **obj_alloc_slots(int num_slots) {
+    if (num_slots == 0)
         return NULL;
-    obj_Env *res = obj_alloc_env();
-
-    for (int i = 0; i < stbds_arrlen(obj->store); ++i) {
-        obj_Env_elem elem = {
-            .key = util_str_deepcopy(obj->store[i].key),
-            .value = obj_deepcpy(obj->store[i].value),
-        };
-        stbds_arrput(res->store, elem);
+    obj_Object **slots = util_slab_alloc(num_slots * sizeof(obj_Object *));
+    for (int i = 0; i < num_slots; ++i) {
+        slots[i] = NULL;
     }
+    return slots;
+}
 
-    // copy outer
-    res->outer = obj_env_deepcpy(obj->outer);
-
-    return res;
+obj_Env *obj_alloc_enclosed_env(obj_Env *outer, int num_slots) {
+    obj_Env *env = util_slab_alloc(sizeof(obj_Env));
+    env->slots = obj_alloc_slots(num_slots);
+    env->num_slots = num_slots;
+    env->outer = outer;
+    gc_track_env(env);
+    return env;
 }
 
-// FIXME: convert to hashmap for better perf
-obj_Object *obj_env_get(obj_Env *env, char *name) {
-    if (env == NULL)
-        return NULL;
+// only the gc frees envs
+void obj_free_env(obj_Env *env) {
+    util_slab_free(env->slots, env->num_slots * sizeof(obj_Object *));
+    util_slab_free(env, sizeof(obj_Env));
+}
 
-    for (int i = 0; i < stbds_arrlen(env->store); ++i) {
-        if (strcmp(env->store[i].key, name) == 0) {
-            return env->store[i].value;
-        }
+// returns NULL if the slot is not set yet
+obj_Object *obj_env_get(obj_Env *env, int depth, int slot) {
+    for (; depth > 0; --depth) {
+        assert(env != NULL);
+        env = env->outer;
     }
+    assert(env != NULL);
 
-    // check outer if its not NULL
-    if (env->outer != NULL)
-        return obj_env_get(env->outer, name);
-
-    return NULL;
+    if (slot >= env->num_slots)
+        return NULL;
+    return env->slots[slot];
 }
 
 // Helper function
@@ -64,37 +48,34 @@ void obj_print_env(obj_Env *env) {
     if (env == NULL)
         return;
 
-    printf(env->store ? "\ninner env:" : "");
-    for (int i = 0; i < stbds_arrlen(env->store); ++i) {
+    printf(env->slots ? "\ninner env:" : "");
+    for (int i = 0; i < env->num_slots; ++i) {
+        obj_Object *val = env->slots[i];
         printf(
-            "\n %d elem: key - %s, val - %s",
+            "\n %d slot: val - %s",
             i,
-            env->store[i].key,
-            obj_object_inspect(env->store[i].value)
+            val != NULL ? obj_object_inspect(val) : "(unset)"
         );
     }
     obj_print_env(env->outer);
 }
 
-void obj_env_set(obj_Env *env, gbString name, obj_Object *val) {
-    // search if not found add it to end of array
-    int found_idx = -1;
-    for (int i = 0; i < stbds_arrlen(env->store); ++i) {
-        if (strcmp(env->store[i].key, name) == 0) {
-            assert(found_idx == -1);
-            found_idx = i;
+void obj_env_set(obj_Env *env, int slot, obj_Object *val) {
+    // globals grow as the repl defines more of them
+    if (slot >= env->num_slots) {
+        int num_slots = env->num_slots * 2;
+        if (num_slots <= slot) {
+            num_slots = slot + 1;
         }
+        obj_Object **slots = obj_alloc_slots(num_slots);
+        for (int i = 0; i < env->num_slots; ++i) {
+            slots[i] = env->slots[i];
+        }
+        util_slab_free(env->slots, env->num_slots * sizeof(obj_Object *));
+        gc_track_growth((num_slots - env->num_slots) * sizeof(obj_Object *));
+        env->slots = slots;
+        env->num_slots = num_slots;
     }
 
-    if (found_idx != -1) {
-        // FIXME: free previous or use arena
-        env->store[found_idx].value = obj_deepcpy(val);
-    } else {
-        obj_Env_elem elem = {
-            .key = util_str_deepcopy(name),
-            .value = obj_deepcpy(val),
-        };
-        stbds_arrput(env->store, elem);
-    }
-    return;
+    env->slots[slot] = val;
 }
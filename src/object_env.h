@@ -4,24 +4,23 @@
 // forward decl
 typedef struct obj_Object obj_Object;
 
-typedef struct {
-    char *key;
-    obj_Object *value;
-} obj_Env_elem;
-
+// a frame of bindings, indexed by the slots the resolver gives identifiers
+// frames are shared - by the frames of calls inside them and by the closures
+// created in them - and collected by the gc
 typedef struct obj_Env {
-    obj_Env_elem *store;
+    obj_Object **slots; // NULL when unset
+    int num_slots;
     struct obj_Env *outer;
+
+    bool gc_marked;
+    struct obj_Env *gc_next;
 } obj_Env;
 
 obj_Env *obj_alloc_env();
-obj_Env *obj_alloc_enclosed_env(obj_Env *outer);
-
-void obj_free_env(obj_Env *obj);
-
-obj_Env *obj_env_deepcpy(obj_Env *obj);
+obj_Env *obj_alloc_enclosed_env(obj_Env *outer, int num_slots);
+void obj_free_env(obj_Env *env);
 
-obj_Object *obj_env_get(obj_Env *env, gbString name);
-void obj_env_set(obj_Env *env, gbString name, obj_Object *val);
+obj_Object *obj_env_get(obj_Env *env, int depth, int slot);
+void obj_env_set(obj_Env *env, int slot, obj_Object *val);
 
 void obj_print_env(obj_Env *env);
@@ -0,0 +1,306 @@
+#pragma once
+#include "ast.h"
+#include "util.c"
+
+#include <limits.h>
+
+/*
+ * # Optimizer
+ *
+ * Runs after the resolver, so names in code it removes were still checked.
+ * Folds prefix and infix exprs over literals into a literal. An if with a
+ * literal condition becomes the branch it takes - its value when that's a
+ * single expr, null when there's no branch, else the branch's statements
+ * spliced into the block holding the if. Nodes are rewritten in place, new
+ * strings are interned like the parser's.
+ *
+ * Only what evaluates to the same value every time is folded - anything that
+ * errors, including int overflow and division by zero, is left for the
+ * evaluator, so the error it reports stays the same.
+ */
+
+struct opt_Optimizer {
+    int folded;
+    int pruned;
+};
+
+void opt_optimize_stmt(struct opt_Optimizer *opt, struct ast_Stmt *stmt);
+void opt_optimize_expr(struct opt_Optimizer *opt, struct ast_Expr *expr);
+
+static bool opt_is_literal(struct ast_Expr *expr) {
+    return expr->tag == ast_INT_LIT_EXPR || expr->tag == ast_BOOL_EXPR ||
+           expr->tag == ast_STR_LIT_EXPR;
+}
+
+// like obj_is_truthy, a literal is never null
+static bool opt_is_truthy(struct ast_Expr *literal) {
+    return literal->tag != ast_BOOL_EXPR || literal->data.boolean.value;
+}
+
+static void opt_set_int(struct ast_Expr *expr, int value) {
+    expr->tag = ast_INT_LIT_EXPR;
+    expr->data.int_lit.value = value;
+}
+
+static void opt_set_bool(struct ast_Expr *expr, bool value) {
+    expr->tag = ast_BOOL_EXPR;
+    expr->data.boolean.value = value;
+}
+
+// returns false if it isn't folded
+static bool opt_fold_prefix(struct ast_Expr *expr) {
+    struct ast_Expr *right = expr->data.pf.right;
+    switch (expr->data.pf.op) {
+        case ast_OP_BANG:
+            opt_set_bool(expr, !opt_is_truthy(right));
+            return true;
+        case ast_OP_MINUS:
+            if (right->tag != ast_INT_LIT_EXPR ||
+                right->data.int_lit.value == INT_MIN) {
+                return false;
+            }
+            opt_set_int(expr, -right->data.int_lit.value);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool opt_fold_int_infix(struct ast_Expr *expr, int l, int r) {
+    int res = 0;
+    switch (expr->data.inf.op) {
+        case ast_OP_PLUS:
+            if (__builtin_add_overflow(l, r, &res))
+                return false;
+            opt_set_int(expr, res);
+            return true;
+        case ast_OP_MINUS:
+            if (__builtin_sub_overflow(l, r, &res))
+                return false;
+            opt_set_int(expr, res);
+            return true;
+        case ast_OP_ASTERISK:
+            if (__builtin_mul_overflow(l, r, &res))
+                return false;
+            opt_set_int(expr, res);
+            return true;
+        case ast_OP_SLASH:
+            if (r == 0 || (l == INT_MIN && r == -1))
+                return false;
+            opt_set_int(expr, l / r);
+            return true;
+        case ast_OP_LT:
+            opt_set_bool(expr, l < r);
+            return true;
+        case ast_OP_GT:
+            opt_set_bool(expr, l > r);
+            return true;
+        case ast_OP_EQ:
+            opt_set_bool(expr, l == r);
+            return true;
+        case ast_OP_NOT_EQ:
+            opt_set_bool(expr, l != r);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// string + string
+static bool opt_fold_str_infix(struct ast_Expr *expr) {
+    struct ast_Str_lit l = expr->data.inf.left->data.str;
+    struct ast_Str_lit r = expr->data.inf.right->data.str;
+    if (expr->data.inf.op != ast_OP_PLUS) {
+        return false;
+    }
+
+    char *value = malloc(l.len + r.len);
+    memcpy(value, l.value, l.len);
+    memcpy(value + l.len, r.value, r.len);
+    expr->tag = ast_STR_LIT_EXPR;
+    expr->data.str.value = util_intern(value, l.len + r.len);
+    expr->data.str.len = l.len + r.len;
+    free(value);
+    return true;
+}
+
+static bool opt_fold_infix(struct ast_Expr *expr) {
+    struct ast_Expr *left = expr->data.inf.left;
+    struct ast_Expr *right = expr->data.inf.right;
+    enum ast_Operator op = expr->data.inf.op;
+
+    if (left->tag != right->tag) {
+        return false;
+    }
+    switch (left->tag) {
+        case ast_INT_LIT_EXPR:
+            return opt_fold_int_infix(
+                expr,
+                left->data.int_lit.value,
+                right->data.int_lit.value
+            );
+        case ast_BOOL_EXPR:
+            // the other operators are errors on booleans
+            if (op != ast_OP_EQ && op != ast_OP_NOT_EQ) {
+                return false;
+            }
+            bool same = left->data.boolean.value == right->data.boolean.value;
+            opt_set_bool(expr, op == ast_OP_EQ ? same : !same);
+            return true;
+        case ast_STR_LIT_EXPR:
+            return opt_fold_str_infix(expr);
+        default:
+            return false;
+    }
+}
+
+// the branch an if with a literal condition takes, NULL if none
+static struct ast_Stmt *opt_taken_branch(struct ast_Expr *expr) {
+    if (expr->tag != ast_IF_EXPR || !opt_is_literal(expr->data.ife.cond))
+        return NULL;
+    struct ast_If *ife = &expr->data.ife;
+    return opt_is_truthy(ife->cond) ? ife->conseq : ife->alt;
+}
+
+// the if becomes the value of the branch it takes, if that's a single expr
+static void opt_prune_if(struct opt_Optimizer *opt, struct ast_Expr *expr) {
+    struct ast_Stmt *taken = opt_taken_branch(expr);
+    if (taken == NULL) {
+        expr->tag = ast_NULL_EXPR;
+        opt->pruned++;
+        return;
+    }
+
+    struct ast_Stmt **stmts = taken->data.block.stmts_da;
+    if (stbds_arrlen(stmts) == 1 && stmts[0]->tag == ast_EXPR_STMT) {
+        *expr = *stmts[0]->data.expr.expr;
+        opt->pruned++;
+    }
+}
+
+// the if statements left are replaced by the statements of the branch they
+// take, unless the last one's value would change
+static void
+opt_splice_ifs(struct opt_Optimizer *opt, struct ast_Stmt ***stmts_da) {
+    for (int i = 0; i < stbds_arrlen(*stmts_da); ++i) {
+        struct ast_Stmt *stmt = (*stmts_da)[i];
+        if (stmt->tag != ast_EXPR_STMT || stmt->data.expr.expr == NULL)
+            continue;
+        struct ast_Stmt *taken = opt_taken_branch(stmt->data.expr.expr);
+        if (taken == NULL)
+            continue;
+
+        struct ast_Stmt **stmts = taken->data.block.stmts_da;
+        int n = stbds_arrlen(stmts);
+        bool last = i == stbds_arrlen(*stmts_da) - 1;
+        if (last && (n == 0 || stmts[n - 1]->tag == ast_LET_STMT))
+            continue;
+
+        stbds_arrdel(*stmts_da, i);
+        if (n > 0) {
+            stbds_arrinsn(*stmts_da, i, n);
+            memcpy(&(*stmts_da)[i], stmts, n * sizeof(struct ast_Stmt *));
+        }
+        i += n - 1;
+        opt->pruned++;
+    }
+}
+
+void opt_optimize_expr(struct opt_Optimizer *opt, struct ast_Expr *expr) {
+    if (expr == NULL)
+        return;
+
+    switch (expr->tag) {
+        case ast_IDENT_EXPR:
+        case ast_INT_LIT_EXPR:
+        case ast_BOOL_EXPR:
+        case ast_STR_LIT_EXPR:
+        case ast_NULL_EXPR:
+            // NOTHING
+            break;
+        case ast_PREFIX_EXPR:
+            opt_optimize_expr(opt, expr->data.pf.right);
+            if (opt_is_literal(expr->data.pf.right) && opt_fold_prefix(expr)) {
+                opt->folded++;
+            }
+            break;
+        case ast_INFIX_EXPR:
+            opt_optimize_expr(opt, expr->data.inf.left);
+            opt_optimize_expr(opt, expr->data.inf.right);
+            if (opt_is_literal(expr->data.inf.left) &&
+                opt_is_literal(expr->data.inf.right) &&
+                opt_fold_infix(expr)) {
+                opt->folded++;
+            }
+            break;
+        case ast_IF_EXPR:
+            opt_optimize_expr(opt, expr->data.ife.cond);
+            opt_optimize_stmt(opt, expr->data.ife.conseq);
+            opt_optimize_stmt(opt, expr->data.ife.alt);
+            if (opt_is_literal(expr->data.ife.cond)) {
+                opt_prune_if(opt, expr);
+            }
+            break;
+        case ast_FN_LIT_EXPR:
+            opt_optimize_stmt(opt, expr->data.fn_lit.body);
+            break;
+        case ast_CALL_EXPR:
+            opt_optimize_expr(opt, expr->data.call.func);
+            for (int i = 0; i < stbds_arrlen(expr->data.call.args_da); ++i) {
+                opt_optimize_expr(opt, expr->data.call.args_da[i]);
+            }
+            break;
+        case ast_ARR_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.arr.elems_da); ++i) {
+                opt_optimize_expr(opt, expr->data.arr.elems_da[i]);
+            }
+            break;
+        case ast_IDX_EXPR:
+            opt_optimize_expr(opt, expr->data.idx.left);
+            opt_optimize_expr(opt, expr->data.idx.index);
+            break;
+        case ast_HASH_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); ++i) {
+                opt_optimize_expr(opt, expr->data.hash.hash_da[i]->key);
+                opt_optimize_expr(opt, expr->data.hash.hash_da[i]->val);
+            }
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+void opt_optimize_stmt(struct opt_Optimizer *opt, struct ast_Stmt *stmt) {
+    if (stmt == NULL)
+        return;
+
+    switch (stmt->tag) {
+        case ast_LET_STMT:
+            opt_optimize_expr(opt, stmt->data.let.value);
+            break;
+        case ast_RET_STMT:
+            opt_optimize_expr(opt, stmt->data.ret.ret_val);
+            break;
+        case ast_EXPR_STMT:
+            opt_optimize_expr(opt, stmt->data.expr.expr);
+            break;
+        case ast_BLOCK_STMT:
+            for (int i = 0; i < stbds_arrlen(stmt->data.block.stmts_da); ++i) {
+                opt_optimize_stmt(opt, stmt->data.block.stmts_da[i]);
+            }
+            opt_splice_ifs(opt, &stmt->data.block.stmts_da);
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+// returns the number of exprs folded and ifs pruned
+int opt_optimize_program(struct ast_Program *program) {
+    struct opt_Optimizer opt = { 0 };
+    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
+        opt_optimize_stmt(&opt, program->statement_ptrs_da[i]);
+    }
+    opt_splice_ifs(&opt, &program->statement_ptrs_da);
+    return opt.folded + opt.pruned;
+}
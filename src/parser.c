@@ -45,6 +45,21 @@ enum par_precedence par_curr_precedence(struct par_Parser *parser) {
     return prec_LOWEST;
 }
 
+// operator of an operator token
+static const enum ast_Operator operators[] = {
+    [tok_PLUS] = ast_OP_PLUS,         [tok_MINUS] = ast_OP_MINUS,
+    [tok_ASTERISK] = ast_OP_ASTERISK, [tok_SLASH] = ast_OP_SLASH,
+    [tok_LT] = ast_OP_LT,             [tok_GT] = ast_OP_GT,
+    [tok_EQ] = ast_OP_EQ,             [tok_NOT_EQ] = ast_OP_NOT_EQ,
+    [tok_BANG] = ast_OP_BANG,
+};
+
+// identifier names are interned, the tree only points to them
+const char *par_curr_name(struct par_Parser *parser) {
+    struct tok_Token token = parser->curr_token;
+    return util_intern(lex_token_text(parser->lexer, token), token.len);
+}
+
 bool par_is_prefix_expr_parsable(enum tok_Type type) {
     static const bool valid_types[] = {
         [tok_IDENT] = true,    [tok_INT] = true,      [tok_STRING] = true,
@@ -70,6 +85,7 @@ bool par_is_infix_expr_parsable(enum tok_Type type) {
 }
 
 void par_hash_set(
+    struct par_Parser *parser,
     struct ast_Expr *hash_expr,
     struct ast_Expr *key,
     struct ast_Expr *val
@@ -89,7 +105,8 @@ void par_hash_set(
     if (found_times == 1) {
         hash_expr->data.hash.hash_da[found_idx]->val = val;
     } else {
-        struct ast_Hash_elem *elem = malloc(sizeof(struct ast_Hash_elem));
+        struct ast_Hash_elem *elem =
+            util_arena_alloc(parser->arena, sizeof(struct ast_Hash_elem));
         elem->key = key;
         elem->val = val;
         stbds_arrput(hash_expr->data.hash.hash_da, elem);
@@ -103,16 +120,15 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
 
     switch (type) {
         case tok_IDENT:
-            left_expr = ast_alloc_expr(ast_IDENT_EXPR);
-            left_expr->token = parser->curr_token;
-            strcpy(left_expr->data.ident.value, parser->curr_token.literal);
+            left_expr = ast_alloc_expr(parser->arena, ast_IDENT_EXPR);
+            left_expr->data.ident.value = par_curr_name(parser);
             break;
         case tok_INT:
-            left_expr = ast_alloc_expr(ast_INT_LIT_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_INT_LIT_EXPR);
 
             int err = util_str_to_int(
-                left_expr->token.literal,
+                lex_token_text(parser->lexer, parser->curr_token),
+                parser->curr_token.len,
                 &left_expr->data.int_lit.value
             );
             if (err != 0) {
@@ -124,9 +140,8 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
         // prefix expression
         case tok_BANG:
         case tok_MINUS:
-            left_expr = ast_alloc_expr(ast_PREFIX_EXPR);
-            left_expr->token = parser->curr_token;
-            strcpy(left_expr->data.pf.operator, parser->curr_token.literal);
+            left_expr = ast_alloc_expr(parser->arena, ast_PREFIX_EXPR);
+            left_expr->data.pf.op = operators[type];
 
             par_next_token(parser);
             left_expr->data.pf.right =
@@ -134,8 +149,7 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
             break;
         case tok_TRUE:
         case tok_FALSE:
-            left_expr = ast_alloc_expr(ast_BOOL_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_BOOL_EXPR);
             left_expr->data.boolean.value = par_curr_token_is(parser, tok_TRUE);
             break;
         // grouped expression
@@ -144,26 +158,22 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
             left_expr = par_parse_expression(parser, prec_LOWEST);
 
             if (!par_expect_peek(parser, tok_RPAREN)) {
-                ast_free_expr(left_expr);
                 left_expr = NULL;
             }
             break;
         case tok_IF:
             if (!par_expect_peek(parser, tok_LPAREN)) {
-                ast_free_expr(left_expr);
                 left_expr = NULL;
                 break;
             }
             par_next_token(parser);
 
-            left_expr = ast_alloc_expr(ast_IF_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_IF_EXPR);
             left_expr->data.ife.cond =
                 par_parse_expression(parser, prec_LOWEST);
 
             if (!par_expect_peek(parser, tok_RPAREN) ||
                 !par_expect_peek(parser, tok_LBRACE)) {
-                ast_free_expr(left_expr);
                 left_expr = NULL;
                 break;
             }
@@ -175,7 +185,6 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
                 par_next_token(parser);
 
                 if (!par_expect_peek(parser, tok_LBRACE)) {
-                    ast_free_expr(left_expr);
                     left_expr = NULL;
                     break;
                 }
@@ -191,11 +200,9 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
              * ### parameters structure:
              *     (<parameter one>, <parameter two>, <parameter three>, ...)
              */
-            left_expr = ast_alloc_expr(ast_FN_LIT_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_FN_LIT_EXPR);
 
             if (!par_expect_peek(parser, tok_LPAREN)) {
-                ast_free_expr(left_expr);
                 left_expr = NULL;
                 break;
             }
@@ -203,7 +210,6 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
             left_expr->data.fn_lit.params_da = par_parse_fn_params(parser);
 
             if (!par_expect_peek(parser, tok_LBRACE)) {
-                ast_free_expr(left_expr);
                 left_expr = NULL;
                 break;
             }
@@ -213,19 +219,21 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
             assert(left_expr->data.fn_lit.body->tag == ast_BLOCK_STMT);
             break;
         case tok_STRING:
-            left_expr = ast_alloc_expr(ast_STR_LIT_EXPR);
-            left_expr->token = parser->curr_token;
-            strcpy(left_expr->data.str.value, parser->curr_token.literal);
+            left_expr = ast_alloc_expr(parser->arena, ast_STR_LIT_EXPR);
+            // interned like names, equal literals share their chars
+            left_expr->data.str.value = util_intern(
+                lex_token_text(parser->lexer, parser->curr_token),
+                parser->curr_token.len
+            );
+            left_expr->data.str.len = parser->curr_token.len;
             break;
         case tok_LBRACKET:
-            left_expr = ast_alloc_expr(ast_ARR_LIT_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_ARR_LIT_EXPR);
             left_expr->data.arr.elems_da =
                 par_parse_expression_list(parser, tok_RBRACKET);
             break;
         case tok_LBRACE:
-            left_expr = ast_alloc_expr(ast_HASH_LIT_EXPR);
-            left_expr->token = parser->curr_token;
+            left_expr = ast_alloc_expr(parser->arena, ast_HASH_LIT_EXPR);
 
             while (!par_peek_token_is(parser, tok_RBRACE)) {
                 par_next_token(parser);
@@ -241,7 +249,7 @@ par_parse_prefix_expr(enum tok_Type type, struct par_Parser *parser) {
 
                 // key val is not getting added to left_expr
                 // left_expr remains NULL - why
-                par_hash_set(left_expr, key, val);
+                par_hash_set(parser, left_expr, key, val);
 
                 if (!par_peek_token_is(parser, tok_RBRACE) &&
                     !par_expect_peek(parser, tok_COMMA)) {
@@ -268,7 +276,7 @@ struct ast_Expr *par_parse_infix_expr(
     struct ast_Expr *left_expr
 ) {
     TRACE_PARSER_FUNC;
-    struct ast_Expr *res_left_expr = malloc(sizeof(struct ast_Expr));
+    struct ast_Expr *res_left_expr = NULL;
 
     switch (type) {
         // infix expression
@@ -280,12 +288,8 @@ struct ast_Expr *par_parse_infix_expr(
         case tok_NOT_EQ:
         case tok_LT:
         case tok_GT:
-            res_left_expr->tag = ast_INFIX_EXPR;
-            res_left_expr->token = parser->curr_token;
-            strcpy(
-                res_left_expr->data.inf.operator,
-                parser->curr_token.literal
-            );
+            res_left_expr = ast_alloc_expr(parser->arena, ast_INFIX_EXPR);
+            res_left_expr->data.inf.op = operators[type];
             res_left_expr->data.inf.left = left_expr;
 
             enum par_precedence precedence = par_curr_precedence(parser);
@@ -296,15 +300,14 @@ struct ast_Expr *par_parse_infix_expr(
             break;
         // call expression
         case tok_LPAREN:
-            res_left_expr->tag = ast_CALL_EXPR;
-            res_left_expr->token = parser->curr_token;
+            res_left_expr = ast_alloc_expr(parser->arena, ast_CALL_EXPR);
             res_left_expr->data.call.func = left_expr;
 
             res_left_expr->data.call.args_da =
                 par_parse_expression_list(parser, tok_RPAREN);
             break;
         case tok_LBRACKET:
-            res_left_expr->tag = ast_IDX_EXPR;
+            res_left_expr = ast_alloc_expr(parser->arena, ast_IDX_EXPR);
             res_left_expr->data.idx.left = left_expr;
             par_next_token(parser);
             res_left_expr->data.idx.index =
@@ -330,6 +333,9 @@ gbString *par_parser_errors(struct par_Parser *parser) {
 
 // to add an error - when peek_token doesn't match any expectation
 void par_peek_error(struct par_Parser *parser, enum tok_Type token_type) {
+    if (parser->too_deep) {
+        return;
+    }
     char msg[256];
     int n = sprintf(
         msg,
@@ -344,27 +350,61 @@ void par_peek_error(struct par_Parser *parser, enum tok_Type token_type) {
     stbds_arrput(parser->errors_da, err_str);
 }
 
+// the token n after curr_token, past the end it's the EOF
+// streaming parsers can only look at curr_token and peek_token
+struct tok_Token par_lookahead(struct par_Parser *parser, int n) {
+    if (parser->tokens_da == NULL) {
+        assert(n == 0 || n == 1);
+        return n == 0 ? parser->curr_token : parser->peek_token;
+    }
+    int last = stbds_arrlen(parser->tokens_da) - 1;
+    int idx = parser->token_idx + n;
+    return parser->tokens_da[idx < last ? idx : last];
+}
+
 void par_next_token(struct par_Parser *parser) {
     parser->curr_token = parser->peek_token;
-    parser->peek_token = lex_next_token(parser->lexer);
+    if (parser->tokens_da != NULL) {
+        parser->token_idx++;
+        parser->peek_token = par_lookahead(parser, 1);
+    } else {
+        parser->peek_token = lex_next_token(parser->lexer);
+    }
 }
 
-// constructor
-struct par_Parser *par_alloc_parser(struct lex_Lexer *lexer) {
+static struct par_Parser *
+par_init_parser(struct lex_Lexer *lexer, struct tok_Token *tokens_da) {
     struct par_Parser *parser = malloc(sizeof(struct par_Parser));
     parser->lexer = lexer;
+    parser->tokens_da = tokens_da;
+    parser->token_idx = -2; // before reading curr_token and peek_token
+    parser->peek_token = (struct tok_Token){ .type = tok_EOF };
     parser->errors_da = NULL;
+    parser->arena = NULL;
+    parser->depth = 0;
+    parser->too_deep = false;
     par_next_token(parser);
     par_next_token(parser);
     return parser;
 }
 
+// constructor - pulls tokens from the lexer as it parses
+struct par_Parser *par_alloc_parser(struct lex_Lexer *lexer) {
+    return par_init_parser(lexer, NULL);
+}
+
+// constructor - lexes the whole input first, the parser walks the array
+struct par_Parser *par_alloc_token_parser(struct lex_Lexer *lexer) {
+    return par_init_parser(lexer, lex_tokenize(lexer));
+}
+
 void par_free_parser(struct par_Parser *parser) {
     if (parser == NULL)
         return;
     for (int i = 0; i < stbds_arrlen(parser->errors_da); ++i) {
         gb_free_string(parser->errors_da[i]);
     }
+    stbds_arrfree(parser->tokens_da);
     free(parser);
 }
 
@@ -406,9 +446,6 @@ par_parse_expression_list(struct par_Parser *parser, enum tok_Type end) {
     }
 
     if (!par_expect_peek(parser, end)) {
-        for (int i = 0; i < stbds_arrlen(list); ++i) {
-            ast_free_expr(list[i]);
-        }
         stbds_arrfree(list);
         return NULL;
     }
@@ -418,22 +455,18 @@ par_parse_expression_list(struct par_Parser *parser, enum tok_Type end) {
 
 struct ast_Stmt *par_parse_let_statement(struct par_Parser *parser) {
     TRACE_PARSER_FUNC;
-    struct ast_Stmt *stmt = ast_alloc_stmt(ast_LET_STMT);
-    stmt->token = parser->curr_token;
+    struct ast_Stmt *stmt = ast_alloc_stmt(parser->arena, ast_LET_STMT);
 
     // First there should be a identifier
     if (!par_expect_peek(parser, tok_IDENT)) {
-        ast_free_stmt(stmt);
         return NULL;
     }
 
-    stmt->data.let.name = ast_alloc_expr(ast_IDENT_EXPR);
-    stmt->data.let.name->token = parser->curr_token;
-    strcpy(stmt->data.let.name->data.ident.value, parser->curr_token.literal);
+    stmt->data.let.name = ast_alloc_expr(parser->arena, ast_IDENT_EXPR);
+    stmt->data.let.name->data.ident.value = par_curr_name(parser);
 
     // Then there should be a assign
     if (!par_expect_peek(parser, tok_ASSIGN)) {
-        ast_free_stmt(stmt);
         return NULL;
     }
     par_next_token(parser);
@@ -449,8 +482,7 @@ struct ast_Stmt *par_parse_let_statement(struct par_Parser *parser) {
 
 struct ast_Stmt *par_parse_ret_statement(struct par_Parser *parser) {
     TRACE_PARSER_FUNC;
-    struct ast_Stmt *ret_stmt = ast_alloc_stmt(ast_RET_STMT);
-    ret_stmt->token = parser->curr_token;
+    struct ast_Stmt *ret_stmt = ast_alloc_stmt(parser->arena, ast_RET_STMT);
 
     par_next_token(parser);
 
@@ -475,9 +507,8 @@ struct ast_Expr **par_parse_fn_params(struct par_Parser *parser) {
     struct ast_Expr **param_identifiers = NULL;
 
     while (!par_curr_token_is(parser, tok_RPAREN)) {
-        struct ast_Expr *ident = ast_alloc_expr(ast_IDENT_EXPR);
-        ident->token = parser->curr_token;
-        strcpy(ident->data.ident.value, parser->curr_token.literal);
+        struct ast_Expr *ident = ast_alloc_expr(parser->arena, ast_IDENT_EXPR);
+        ident->data.ident.value = par_curr_name(parser);
 
         stbds_arrput(param_identifiers, ident);
         par_next_token(parser);
@@ -487,9 +518,6 @@ struct ast_Expr **par_parse_fn_params(struct par_Parser *parser) {
         } else if (par_curr_token_is(parser, tok_RPAREN)) {
             break;
         } else {
-            for (int i = 0; i < stbds_arrlen(param_identifiers); ++i) {
-                ast_free_expr(param_identifiers[i]);
-            }
             stbds_arrfree(param_identifiers);
             return NULL;
         }
@@ -500,8 +528,7 @@ struct ast_Expr **par_parse_fn_params(struct par_Parser *parser) {
 
 struct ast_Stmt *par_parse_block_stmt(struct par_Parser *parser) {
     TRACE_PARSER_FUNC;
-    struct ast_Stmt *block = ast_alloc_stmt(ast_BLOCK_STMT);
-    block->token = parser->curr_token;
+    struct ast_Stmt *block = ast_alloc_stmt(parser->arena, ast_BLOCK_STMT);
 
     par_next_token(parser);
 
@@ -517,42 +544,70 @@ struct ast_Stmt *par_parse_block_stmt(struct par_Parser *parser) {
 }
 
 void par_no_prefix_parsing_err(struct par_Parser *parser, enum tok_Type token) {
+    if (parser->too_deep) {
+        return;
+    }
     gbString msg = gb_make_string("No prefix parse function for ");
     msg = gb_append_cstring(msg, tok_Token_int_enum_to_str(token));
     msg = gb_append_cstring(msg, " found");
     stbds_arrput(parser->errors_da, msg);
 }
 
+// errors past it would only follow from it, so parsing stops at the EOF
+void par_too_deep_err(struct par_Parser *parser) {
+    char msg[64];
+    sprintf(msg, "Expression nested deeper than %d", PAR_MAX_DEPTH);
+    stbds_arrput(parser->errors_da, gb_make_string(msg));
+    parser->too_deep = true;
+    while (!par_curr_token_is(parser, tok_EOF)) {
+        par_next_token(parser);
+    }
+}
+
 struct ast_Expr *par_parse_expression(
     struct par_Parser *parser,
     enum par_precedence precedence
 ) {
     TRACE_PARSER_FUNC;
+    if (parser->too_deep) {
+        return NULL;
+    }
+    if (parser->depth >= PAR_MAX_DEPTH) {
+        par_too_deep_err(parser);
+        return NULL;
+    }
     if (!par_is_prefix_expr_parsable(parser->curr_token.type)) {
         par_no_prefix_parsing_err(parser, parser->curr_token.type);
         return NULL;
     }
+    int depth = parser->depth++;
     struct ast_Expr *left_expr =
         par_parse_prefix_expr(parser->curr_token.type, parser);
 
-    while (!par_peek_token_is(parser, tok_SEMICOLON) &&
+    // every infix wraps the left expr, so a long chain nests as deep
+    while (!parser->too_deep && !par_peek_token_is(parser, tok_SEMICOLON) &&
            (precedence < par_peek_precedence(parser))) {
         if (!par_is_infix_expr_parsable(parser->peek_token.type)) {
-            return left_expr;
+            break;
+        }
+        if (parser->depth >= PAR_MAX_DEPTH) {
+            par_too_deep_err(parser);
+            break;
         }
 
         par_next_token(parser);
+        parser->depth++;
         left_expr =
             par_parse_infix_expr(parser->curr_token.type, parser, left_expr);
     }
 
+    parser->depth = depth;
     return left_expr;
 }
 
 struct ast_Stmt *par_parse_expr_statement(struct par_Parser *parser) {
     TRACE_PARSER_FUNC;
-    struct ast_Stmt *expr_stmt = ast_alloc_stmt(ast_EXPR_STMT);
-    expr_stmt->token = parser->curr_token;
+    struct ast_Stmt *expr_stmt = ast_alloc_stmt(parser->arena, ast_EXPR_STMT);
 
     expr_stmt->data.expr.expr = par_parse_expression(parser, prec_LOWEST);
 
@@ -582,6 +637,7 @@ struct ast_Stmt *par_parse_statement(struct par_Parser *parser) {
 
 void par_parse_program(struct par_Parser *parser, struct ast_Program *program) {
     TRACE_PARSER_FUNC;
+    parser->arena = program->arena;
     while (parser->curr_token.type != tok_EOF) {
         struct ast_Stmt *statement = par_parse_statement(parser);
         if (statement != NULL) {
@@ -3,15 +3,31 @@
 #include "lexer.c"
 #include "token.c"
 
+// tokens either come from the lexer one at a time or from an array lexed up
+// front, which gives any lookahead - the repl streams
 struct par_Parser {
-    struct lex_Lexer *lexer;
+    struct lex_Lexer *lexer; // the input, and the tokens when streaming
+    struct tok_Token *tokens_da; // NULL when streaming
+    int token_idx; // of curr_token in tokens_da
     gbString *errors_da; // dynamic arr of err_strings
     struct tok_Token curr_token;
     struct tok_Token peek_token;
+    struct util_Arena *arena; // of the program being parsed
+    int depth; // of the expr being parsed, in the tree it makes
+    bool too_deep; // the rest of the input is skipped once it is
 };
 
+// the passes after the parser recurse on the tree, this bounds their c stack
+#ifdef __EMSCRIPTEN__
+#define PAR_MAX_DEPTH 500
+#else
+#define PAR_MAX_DEPTH 2000
+#endif
+
 void par_next_token(struct par_Parser *);
 
+struct tok_Token par_lookahead(struct par_Parser *parser, int n);
+
 enum par_precedence {
     prec_LOWEST = 1,
     prec_EQUALS, // ==
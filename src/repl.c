@@ -1,8 +1,11 @@
 #include "eval.c"
 #include "lexer.c"
 #include "object_env.c"
+#include "optimizer.c"
 #include "parser.c"
+#include "resolver.c"
 #include "util.c"
+#include "vm.c"
 
 #include <stdio.h>
 
@@ -13,7 +16,9 @@
 enum repl_modes {
     repl_mode_LEXER,
     repl_mode_PARSER,
+    repl_mode_OPTIMIZED,
     repl_mode_EVAL,
+    repl_mode_VM,
 };
 
 char *repl_lex_str(char *line) {
@@ -23,14 +28,18 @@ char *repl_lex_str(char *line) {
     for (struct tok_Token token = lex_next_token(&lexer); token.type != tok_EOF;
          token = lex_next_token(&lexer)) {
 
-        sstring line;
-        sprintf(
-            line,
-            "token! type: %s lit: %s\n",
-            tok_Token_int_enum_to_str(token.type),
-            token.literal
+        out_str = gb_append_cstring(out_str, "token! type: ");
+        out_str = gb_append_cstring(
+            out_str,
+            tok_Token_int_enum_to_str(token.type)
         );
-        out_str = gb_append_cstring(out_str, line);
+        out_str = gb_append_cstring(out_str, " lit: ");
+        out_str = gb_append_string_length(
+            out_str,
+            lex_token_text(&lexer, token),
+            token.len
+        );
+        out_str = gb_append_cstring(out_str, "\n");
     }
     return out_str;
 }
@@ -73,7 +82,8 @@ char *repl_print_parser_errors(gbString *errs) {
     return err_str;
 }
 
-char *repl_parse_str(char *line) {
+// the program as parsed, or as the evaluator gets it after optimizing
+char *repl_parse_str(char *line, bool optimize) {
     gbString out_str = gb_make_string("");
 
     struct lex_Lexer lexer = lex_Lexer_create(line);
@@ -86,9 +96,14 @@ char *repl_parse_str(char *line) {
             out_str,
             repl_print_parser_errors(parser->errors_da)
         );
+        par_free_parser(parser);
+        ast_free_program(program);
         return out_str;
     }
 
+    if (optimize) {
+        opt_optimize_program(program);
+    }
     gbString prg_str = ast_make_program_str(program);
     out_str = gb_append_cstring(out_str, prg_str != NULL ? prg_str : "");
 
@@ -98,7 +113,9 @@ char *repl_parse_str(char *line) {
     return out_str;
 }
 
-obj_Env EVAL_ENV = { .store = NULL, .outer = NULL };
+// evaluator state kept across repl lines
+obj_Env *EVAL_ENV = NULL;
+struct res_Scope *EVAL_GLOBALS = NULL;
 
 #ifdef __EMSCRIPTEN__
 EMSCRIPTEN_KEEPALIVE
@@ -116,18 +133,88 @@ char *repl_eval_str(char *line) {
             out_str,
             repl_print_parser_errors(parser->errors_da)
         );
+        par_free_parser(parser);
+        ast_free_program(program);
+        return out_str;
+    }
+
+    if (EVAL_GLOBALS == NULL) {
+        EVAL_GLOBALS = res_alloc_scope(NULL);
+        EVAL_ENV = obj_alloc_env();
+    }
+
+    struct res_Resolver *resolver = res_alloc_resolver(EVAL_GLOBALS);
+    res_resolve_program(resolver, program);
+
+    obj_Object *evaluated = NULL;
+    if (stbds_arrlen(resolver->errors_da) != 0) {
+        evaluated = obj_alloc_err_object("%s", resolver->errors_da[0]);
+    } else {
+        opt_optimize_program(program);
+        evaluated =
+            eval_eval((ast_Node){ ast_NODE_PRG, .prg = program }, EVAL_ENV);
+    }
+
+    out_str = gb_append_cstring(
+        out_str,
+        evaluated != NULL ? obj_object_inspect(evaluated) : ""
+    );
+
+    // the line's ast goes at once, unless fn objects made in it hold its arena
+    res_free_resolver(resolver);
+    par_free_parser(parser);
+    ast_free_program(program);
+    return out_str;
+}
+
+// vm state kept across repl lines
+struct cmp_Symbol_table *VM_SYMBOLS = NULL;
+obj_Object **VM_CONSTANTS_DA = NULL;
+obj_Object **VM_GLOBALS = NULL;
+
+char *repl_vm_str(char *line) {
+    gbString out_str = gb_make_string("");
+
+    struct lex_Lexer lexer = lex_Lexer_create(line);
+    struct par_Parser *parser = par_alloc_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+
+    if (stbds_arrlen(parser->errors_da) != 0) {
+        out_str = gb_append_cstring(
+            out_str,
+            repl_print_parser_errors(parser->errors_da)
+        );
+        par_free_parser(parser);
+        ast_free_program(program);
         return out_str;
     }
 
-    obj_Object *evaluated =
-        eval_eval((ast_Node){ ast_NODE_PRG, .prg = program }, &EVAL_ENV);
+    if (VM_SYMBOLS == NULL) {
+        VM_SYMBOLS = cmp_alloc_global_symbol_table();
+        VM_GLOBALS = vm_alloc_globals();
+    }
+
+    struct cmp_Compiler *compiler =
+        cmp_alloc_compiler(VM_SYMBOLS, VM_CONSTANTS_DA);
+    cmp_compile_program(compiler, program);
+    VM_CONSTANTS_DA = compiler->constants_da;
+
+    obj_Object *evaluated = NULL;
+    if (stbds_arrlen(compiler->errors_da) != 0) {
+        evaluated = obj_alloc_err_object("%s", compiler->errors_da[0]);
+    } else {
+        struct vm_VM *vm = vm_alloc_vm(cmp_bytecode(compiler), VM_GLOBALS);
+        evaluated = vm_run(vm);
+        vm_free_vm(vm);
+    }
 
     out_str = gb_append_cstring(
         out_str,
         evaluated != NULL ? obj_object_inspect(evaluated) : ""
     );
 
-    obj_free_object(evaluated);
+    cmp_free_compiler(compiler);
     par_free_parser(parser);
     ast_free_program(program);
     return out_str;
@@ -141,6 +228,10 @@ const char *repl_make_prompt(const enum repl_modes mode) {
             return "LILAC-LEXER> ";
         case repl_mode_PARSER:
             return "LILAC-PARSER> ";
+        case repl_mode_OPTIMIZED:
+            return "LILAC-OPTIMIZED> ";
+        case repl_mode_VM:
+            return "LILAC-VM> ";
     }
 }
 
@@ -150,15 +241,25 @@ void repl_start(const enum repl_modes mode) {
     for (;;) {
         printf("%s", PROMPT);
         sstring line = "";
-        fgets(line, sizeof(line), stdin);
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            // EOF - ctrl-d or the end of piped input
+            printf("\n");
+            return;
+        }
 
         char *output_str = NULL;
         switch (mode) {
             case repl_mode_EVAL:
                 output_str = repl_eval_str(line);
                 break;
+            case repl_mode_VM:
+                output_str = repl_vm_str(line);
+                break;
             case repl_mode_PARSER:
-                output_str = repl_parse_str(line);
+                output_str = repl_parse_str(line, false);
+                break;
+            case repl_mode_OPTIMIZED:
+                output_str = repl_parse_str(line, true);
                 break;
             case repl_mode_LEXER:
                 output_str = repl_lex_str(line);
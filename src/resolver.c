@@ -0,0 +1,363 @@
+#pragma once
+#include "ast.h"
+#include "builtin.c"
+#include "object.c"
+
+#include <stdarg.h>
+
+/*
+ * # Resolver
+ *
+ * Runs after par_parse_program and gives every identifier its lexical address
+ * - the slot in the env frame depth fns out - so the evaluator indexes frames
+ * directly instead of comparing names. Like the evaluator's envs, there is a
+ * scope per fn literal and none per block.
+ * Unresolved identifiers are reported as errors before evaluation starts.
+ *
+ * It also marks the calls in tail position of every fn body - returned, or
+ * the value of the body's last statement - which the evaluator turns into
+ * jumps instead of nesting.
+ */
+
+// ---------------------- Scope
+
+// name -> slot, the slot of a name is its idx in names_da
+struct res_Scope {
+    struct res_Scope *outer;
+    char **names_da;
+    uint32_t *hashes_da;
+
+    // open addressing table of idxs into names_da, -1 when empty
+    int *table;
+    int table_cap; // power of 2
+};
+
+struct res_Scope *res_alloc_scope(struct res_Scope *outer) {
+    struct res_Scope *scope = malloc(sizeof(struct res_Scope));
+    scope->outer = outer;
+    scope->names_da = NULL;
+    scope->hashes_da = NULL;
+    scope->table = NULL;
+    scope->table_cap = 0;
+    return scope;
+}
+
+// doesn't free the outer scopes
+void res_free_scope(struct res_Scope *scope) {
+    if (scope == NULL)
+        return;
+    for (int i = 0; i < stbds_arrlen(scope->names_da); ++i) {
+        free(scope->names_da[i]);
+    }
+    stbds_arrfree(scope->names_da);
+    stbds_arrfree(scope->hashes_da);
+    free(scope->table);
+    free(scope);
+}
+
+int res_scope_num_slots(struct res_Scope *scope) {
+    return stbds_arrlen(scope->names_da);
+}
+
+// table idx holding the name, or the empty one it should be put into
+static int
+res_scope_find_idx(struct res_Scope *scope, const char *name, uint32_t hash) {
+    uint32_t mask = scope->table_cap - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        int slot = scope->table[i];
+        if (slot == -1) {
+            return i;
+        }
+        if (scope->hashes_da[slot] == hash &&
+            strcmp(scope->names_da[slot], name) == 0) {
+            return i;
+        }
+    }
+}
+
+static void res_scope_grow(struct res_Scope *scope) {
+    scope->table_cap = scope->table_cap == 0 ? 8 : scope->table_cap * 2;
+    free(scope->table);
+    scope->table = malloc(scope->table_cap * sizeof(int));
+    memset(scope->table, -1, scope->table_cap * sizeof(int));
+
+    uint32_t mask = scope->table_cap - 1;
+    for (int slot = 0; slot < stbds_arrlen(scope->names_da); ++slot) {
+        uint32_t i = scope->hashes_da[slot] & mask;
+        while (scope->table[i] != -1) {
+            i = (i + 1) & mask;
+        }
+        scope->table[i] = slot;
+    }
+}
+
+// returns -1 if the name is not defined in this scope
+int res_scope_lookup(struct res_Scope *scope, const char *name) {
+    if (scope->table_cap == 0)
+        return -1;
+    return scope->table[res_scope_find_idx(scope, name, obj_hash_str(name))];
+}
+
+// a redefined name keeps its slot
+int res_scope_define(struct res_Scope *scope, const char *name) {
+    // keep the load factor under 3/4
+    int len = stbds_arrlen(scope->names_da);
+    if ((len + 1) * 4 > scope->table_cap * 3) {
+        res_scope_grow(scope);
+    }
+
+    uint32_t hash = obj_hash_str(name);
+    int idx = res_scope_find_idx(scope, name, hash);
+    if (scope->table[idx] == -1) {
+        stbds_arrput(scope->names_da, util_str_deepcopy(name));
+        stbds_arrput(scope->hashes_da, hash);
+        scope->table[idx] = len;
+    }
+    return scope->table[idx];
+}
+
+// ---------------------- Tail calls
+
+void res_mark_tail_stmt(struct ast_Stmt *stmt, bool last);
+
+// the expr's value is what its fn returns
+void res_mark_tail_expr(struct ast_Expr *expr) {
+    if (expr == NULL)
+        return;
+
+    if (expr->tag == ast_CALL_EXPR) {
+        expr->data.call.tail = true;
+    } else if (expr->tag == ast_IF_EXPR) {
+        res_mark_tail_stmt(expr->data.ife.conseq, true);
+        res_mark_tail_stmt(expr->data.ife.alt, true);
+    }
+}
+
+// returns are tail calls anywhere, other statements only when they are the
+// last one of the body - ifs used as values elsewhere aren't looked into
+void res_mark_tail_stmt(struct ast_Stmt *stmt, bool last) {
+    if (stmt == NULL)
+        return;
+
+    switch (stmt->tag) {
+        case ast_RET_STMT:
+            res_mark_tail_expr(stmt->data.ret.ret_val);
+            break;
+        case ast_EXPR_STMT:
+            if (last) {
+                res_mark_tail_expr(stmt->data.expr.expr);
+            } else if (stmt->data.expr.expr != NULL &&
+                       stmt->data.expr.expr->tag == ast_IF_EXPR) {
+                struct ast_If *ife = &stmt->data.expr.expr->data.ife;
+                res_mark_tail_stmt(ife->conseq, false);
+                res_mark_tail_stmt(ife->alt, false);
+            }
+            break;
+        case ast_BLOCK_STMT: {
+            int n = stbds_arrlen(stmt->data.block.stmts_da);
+            for (int i = 0; i < n; ++i) {
+                res_mark_tail_stmt(
+                    stmt->data.block.stmts_da[i],
+                    last && i == n - 1
+                );
+            }
+            break;
+        }
+        case ast_LET_STMT:
+            // NOTHING
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+// ---------------------- Resolver
+
+struct res_Resolver {
+    struct res_Scope *scope; // innermost
+    gbString *errors_da;
+};
+
+// globals are not owned by the resolver - the repl keeps them across lines
+struct res_Resolver *res_alloc_resolver(struct res_Scope *globals) {
+    struct res_Resolver *resolver = malloc(sizeof(struct res_Resolver));
+    resolver->scope = globals;
+    resolver->errors_da = NULL;
+    return resolver;
+}
+
+void res_free_resolver(struct res_Resolver *resolver) {
+    if (resolver == NULL)
+        return;
+    for (int i = 0; i < stbds_arrlen(resolver->errors_da); ++i) {
+        gb_free_string(resolver->errors_da[i]);
+    }
+    stbds_arrfree(resolver->errors_da);
+    free(resolver);
+}
+
+void res_error(struct res_Resolver *resolver, const char *format, ...) {
+    char msg[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg, sizeof(msg), format, args);
+    va_end(args);
+
+    stbds_arrput(resolver->errors_da, gb_make_string(msg));
+}
+
+void res_resolve_stmt(struct res_Resolver *resolver, struct ast_Stmt *stmt);
+void res_resolve_expr(struct res_Resolver *resolver, struct ast_Expr *expr);
+
+void res_resolve_ident(struct res_Resolver *resolver, struct ast_Expr *expr) {
+    struct ast_Ident *ident = &expr->data.ident;
+
+    int depth = 0;
+    for (struct res_Scope *scope = resolver->scope; scope != NULL;
+         scope = scope->outer, ++depth) {
+        int slot = res_scope_lookup(scope, ident->value);
+        if (slot != -1) {
+            ident->depth = depth;
+            ident->slot = slot;
+            return;
+        }
+    }
+
+    obj_Object *builtin =
+        builtin_from_keyword(ident->value, strlen(ident->value));
+    if (builtin != NULL) {
+        ident->depth = AST_IDENT_BUILTIN;
+        ident->slot = builtin->m_builtin;
+        return;
+    }
+
+    res_error(resolver, "identifier not found: %s", ident->value);
+}
+
+void res_define_ident(struct res_Resolver *resolver, struct ast_Expr *expr) {
+    assert(expr->tag == ast_IDENT_EXPR);
+    struct ast_Ident *ident = &expr->data.ident;
+    ident->depth = 0;
+    ident->slot = res_scope_define(resolver->scope, ident->value);
+}
+
+void res_resolve_fn_lit(struct res_Resolver *resolver, struct ast_Expr *expr) {
+    resolver->scope = res_alloc_scope(resolver->scope);
+
+    // params take the first slots
+    for (int i = 0; i < stbds_arrlen(expr->data.fn_lit.params_da); ++i) {
+        res_define_ident(resolver, expr->data.fn_lit.params_da[i]);
+    }
+    res_resolve_stmt(resolver, expr->data.fn_lit.body);
+    expr->data.fn_lit.num_slots = res_scope_num_slots(resolver->scope);
+    res_mark_tail_stmt(expr->data.fn_lit.body, true);
+
+    struct res_Scope *outer = resolver->scope->outer;
+    res_free_scope(resolver->scope);
+    resolver->scope = outer;
+}
+
+void res_resolve_expr(struct res_Resolver *resolver, struct ast_Expr *expr) {
+    if (expr == NULL)
+        return;
+
+    switch (expr->tag) {
+        case ast_IDENT_EXPR:
+            res_resolve_ident(resolver, expr);
+            break;
+        case ast_INT_LIT_EXPR:
+        case ast_BOOL_EXPR:
+        case ast_STR_LIT_EXPR:
+        case ast_NULL_EXPR:
+            // NOTHING
+            break;
+        case ast_PREFIX_EXPR:
+            res_resolve_expr(resolver, expr->data.pf.right);
+            break;
+        case ast_INFIX_EXPR:
+            res_resolve_expr(resolver, expr->data.inf.left);
+            res_resolve_expr(resolver, expr->data.inf.right);
+            break;
+        case ast_IF_EXPR:
+            res_resolve_expr(resolver, expr->data.ife.cond);
+            res_resolve_stmt(resolver, expr->data.ife.conseq);
+            res_resolve_stmt(resolver, expr->data.ife.alt);
+            break;
+        case ast_FN_LIT_EXPR:
+            res_resolve_fn_lit(resolver, expr);
+            break;
+        case ast_CALL_EXPR:
+            res_resolve_expr(resolver, expr->data.call.func);
+            for (int i = 0; i < stbds_arrlen(expr->data.call.args_da); ++i) {
+                res_resolve_expr(resolver, expr->data.call.args_da[i]);
+            }
+            break;
+        case ast_ARR_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.arr.elems_da); ++i) {
+                res_resolve_expr(resolver, expr->data.arr.elems_da[i]);
+            }
+            break;
+        case ast_IDX_EXPR:
+            res_resolve_expr(resolver, expr->data.idx.left);
+            res_resolve_expr(resolver, expr->data.idx.index);
+            break;
+        case ast_HASH_LIT_EXPR:
+            for (int i = 0; i < stbds_arrlen(expr->data.hash.hash_da); ++i) {
+                res_resolve_expr(resolver, expr->data.hash.hash_da[i]->key);
+                res_resolve_expr(resolver, expr->data.hash.hash_da[i]->val);
+            }
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+void res_resolve_stmt(struct res_Resolver *resolver, struct ast_Stmt *stmt) {
+    if (stmt == NULL)
+        return;
+
+    switch (stmt->tag) {
+        case ast_LET_STMT:
+            // a fn literal sees its own name, so it can recurse
+            if (stmt->data.let.value != NULL &&
+                stmt->data.let.value->tag == ast_FN_LIT_EXPR) {
+                res_define_ident(resolver, stmt->data.let.name);
+                res_resolve_expr(resolver, stmt->data.let.value);
+            } else {
+                res_resolve_expr(resolver, stmt->data.let.value);
+                res_define_ident(resolver, stmt->data.let.name);
+            }
+            break;
+        case ast_RET_STMT:
+            res_resolve_expr(resolver, stmt->data.ret.ret_val);
+            break;
+        case ast_EXPR_STMT:
+            res_resolve_expr(resolver, stmt->data.expr.expr);
+            break;
+        case ast_BLOCK_STMT:
+            for (int i = 0; i < stbds_arrlen(stmt->data.block.stmts_da); ++i) {
+                res_resolve_stmt(resolver, stmt->data.block.stmts_da[i]);
+            }
+            break;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+// top level lets are defined up front, so fns can call globals defined after
+// them - mutually recursive ones too - a global read before it's set is an
+// error at run time
+void res_resolve_program(
+    struct res_Resolver *resolver,
+    struct ast_Program *program
+) {
+    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
+        struct ast_Stmt *stmt = program->statement_ptrs_da[i];
+        if (stmt->tag == ast_LET_STMT) {
+            res_define_ident(resolver, stmt->data.let.name);
+        }
+    }
+    for (int i = 0; i < stbds_arrlen(program->statement_ptrs_da); ++i) {
+        res_resolve_stmt(resolver, program->statement_ptrs_da[i]);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "eval.c"
+#include "lexer.c"
+#include "object_env.c"
+#include "optimizer.c"
+#include "parser.c"
+#include "resolver.c"
+#include "util.c"
+#include "vm.c"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * # Running script files
+ *
+ * `lilac run file.monkey` maps the file and lexes the mapping in place, the
+ * whole script is parsed once and then evaluated. Nothing but the script's
+ * own output goes to stdout, errors go to stderr and to the exit code.
+ */
+
+// exit codes, from sysexits.h
+enum run_Exit_code {
+    run_EXIT_OK = 0,
+    run_EXIT_USAGE = 64,
+    run_EXIT_SYNTAX = 65, // parser or resolver errors
+    run_EXIT_NO_INPUT = 66,
+    run_EXIT_RUNTIME = 70,
+};
+
+struct run_Source {
+    const char *text; // not NUL terminated
+    size_t len;
+};
+
+// returns false if the file can't be mapped, errno is set
+bool run_map_source(const char *path, struct run_Source *source) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return false;
+    }
+
+    // the lexer takes an int length
+    if (st.st_size > INT_MAX) {
+        close(fd);
+        errno = EFBIG;
+        return false;
+    }
+    source->len = st.st_size;
+    source->text = "";
+    // an empty file can't be mapped
+    if (source->len != 0) {
+        void *text = mmap(NULL, source->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        source->text = text;
+    }
+
+    // the mapping stays valid after the close
+    close(fd);
+    return true;
+}
+
+void run_unmap_source(struct run_Source source) {
+    if (source.len != 0) {
+        munmap((void *)source.text, source.len);
+    }
+}
+
+static enum run_Exit_code run_result(obj_Object *evaluated) {
+    if (obj_is_err(evaluated)) {
+        fprintf(stderr, "%s\n", obj_object_inspect(evaluated));
+        return run_EXIT_RUNTIME;
+    }
+    return run_EXIT_OK;
+}
+
+static enum run_Exit_code run_eval(struct ast_Program *program) {
+    struct res_Resolver *resolver = res_alloc_resolver(res_alloc_scope(NULL));
+    res_resolve_program(resolver, program);
+
+    enum run_Exit_code code = run_EXIT_SYNTAX;
+    if (stbds_arrlen(resolver->errors_da) != 0) {
+        fprintf(stderr, "%s\n", resolver->errors_da[0]);
+    } else {
+        opt_optimize_program(program);
+        code = run_result(eval_eval(
+            (ast_Node){ ast_NODE_PRG, .prg = program },
+            obj_alloc_env()
+        ));
+    }
+
+    res_free_resolver(resolver);
+    return code;
+}
+
+static enum run_Exit_code run_vm(struct ast_Program *program) {
+    struct cmp_Compiler *compiler =
+        cmp_alloc_compiler(cmp_alloc_global_symbol_table(), NULL);
+    cmp_compile_program(compiler, program);
+
+    enum run_Exit_code code = run_EXIT_SYNTAX;
+    if (stbds_arrlen(compiler->errors_da) != 0) {
+        fprintf(stderr, "%s\n", compiler->errors_da[0]);
+    } else {
+        struct vm_VM *vm =
+            vm_alloc_vm(cmp_bytecode(compiler), vm_alloc_globals());
+        code = run_result(vm_run(vm));
+        vm_free_vm(vm);
+    }
+
+    cmp_free_compiler(compiler);
+    return code;
+}
+
+// returns the process exit code
+enum run_Exit_code run_file(const char *path, bool use_vm) {
+    struct run_Source source;
+    if (!run_map_source(path, &source)) {
+        fprintf(stderr, "lilac: can't read %s: %s\n", path, strerror(errno));
+        return run_EXIT_NO_INPUT;
+    }
+
+    // a script is parsed once, so it's lexed up front
+    struct lex_Lexer lexer = lex_Lexer_create_len(source.text, source.len);
+    struct par_Parser *parser = par_alloc_token_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+
+    enum run_Exit_code code = run_EXIT_OK;
+    if (stbds_arrlen(parser->errors_da) != 0) {
+        for (int i = 0; i < stbds_arrlen(parser->errors_da); ++i) {
+            fprintf(stderr, "%s: %s\n", path, parser->errors_da[i]);
+        }
+        code = run_EXIT_SYNTAX;
+    } else {
+        code = use_vm ? run_vm(program) : run_eval(program);
+    }
+
+    par_free_parser(parser);
+    ast_free_program(program);
+    run_unmap_source(source);
+    return code;
+}
@@ -45,18 +45,13 @@ enum tok_Type {
 #undef __ENUMERATE_TOKEN_TYPE
 };
 
+// a slice of the lexed input, its text is only copied out where needed
 struct tok_Token {
     enum tok_Type type;
-    sstring literal;
+    int offset;
+    int len;
 };
 
-// constructor
-struct tok_Token tok_Token_create(enum tok_Type type, char ch) {
-    struct tok_Token tok = { .type = type };
-    snprintf(tok.literal, SHORT_STRING_MAXLEN, "%c", ch);
-    return tok;
-}
-
 // gets an enum int and returns .to_string of the enum
 const char *tok_Token_int_enum_to_str(int token) {
     switch ((enum tok_Type)token) {
@@ -69,28 +64,62 @@ const char *tok_Token_int_enum_to_str(int token) {
     assert(0 && "should not be reached");
 }
 
-enum tok_Type tok_lookup_identifier(sstring literal) {
-    enum tok_Type tok_type;
+/*
+ * # Reserved words
+ *
+ * Keywords and builtin names are found with a perfect hash - the length, the
+ * first and the last char give every reserved word its own slot - so telling
+ * a word from a plain identifier costs one hash and one compare.
+ *
+ * Tables are filled at compile time by TOK_WORD, which takes the length from
+ * the literal but needs the first and last char spelled out, since a string
+ * literal's chars aren't constants. Two words in one slot show up as an
+ * initializer override warning, a char spelled wrong as a word the lexer
+ * test can't look up.
+ */
+
+#define TOK_WORD_SLOTS 32
+#define TOK_WORD_HASH(len, first, last) \
+    (((len) + (first) * 14 + (last)) & (TOK_WORD_SLOTS - 1))
+
+#define TOK_WORD(text, first, last, val) \
+    [TOK_WORD_HASH(sizeof(text) - 1, first, last)] = { \
+        text, sizeof(text) - 1, val \
+    }
+
+struct tok_Word {
+    const char *text; // NULL for an empty slot
+    int len;
+    int val;
+};
 
-    if (0 == strcmp(literal, "let")) {
-        tok_type = tok_LET;
-    } else if (0 == strcmp(literal, "fn")) {
-        tok_type = tok_FUNCTION;
-    } else if (0 == strcmp(literal, "true")) {
-        tok_type = tok_TRUE;
-    } else if (0 == strcmp(literal, "false")) {
-        tok_type = tok_FALSE;
-    } else if (0 == strcmp(literal, "if")) {
-        tok_type = tok_IF;
-    } else if (0 == strcmp(literal, "else")) {
-        tok_type = tok_ELSE;
-    } else if (0 == strcmp(literal, "return")) {
-        tok_type = tok_RETURN;
-    } else {
-        tok_type = tok_IDENT;
+// returns missing if text isn't one of the words, text is len > 0 long
+int tok_lookup_word(
+    const struct tok_Word words[TOK_WORD_SLOTS],
+    const char *text,
+    int len,
+    int missing
+) {
+    const struct tok_Word *word =
+        &words[TOK_WORD_HASH(len, text[0], text[len - 1])];
+    if (word->len == len && memcmp(word->text, text, len) == 0) {
+        return word->val;
     }
+    return missing;
+}
+
+static const struct tok_Word tok_keywords[TOK_WORD_SLOTS] = {
+    TOK_WORD("let", 'l', 't', tok_LET),
+    TOK_WORD("fn", 'f', 'n', tok_FUNCTION),
+    TOK_WORD("true", 't', 'e', tok_TRUE),
+    TOK_WORD("false", 'f', 'e', tok_FALSE),
+    TOK_WORD("if", 'i', 'f', tok_IF),
+    TOK_WORD("else", 'e', 'e', tok_ELSE),
+    TOK_WORD("return", 'r', 'n', tok_RETURN),
+};
 
-    return tok_type;
+enum tok_Type tok_lookup_identifier(const char *text, int len) {
+    return tok_lookup_word(tok_keywords, text, len, tok_IDENT);
 }
 
 #endif
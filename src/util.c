@@ -21,21 +21,21 @@
 
 typedef char sstring[SHORT_STRING_MAXLEN];
 
-int util_str_to_int(const char *str, int *result) {
-    char *endptr;
-    errno = 0;
-    intmax_t value = strtoimax(str, &endptr, 10);
-
-    if (errno == ERANGE) {
-        return -1; // Overflow or underflow
-    }
-
-    if (endptr == str || *endptr != '\0') {
+// str is len decimal digits, it doesn't need to be NUL terminated
+int util_str_to_int(const char *str, int len, int *result) {
+    if (len == 0) {
         return -2; // Invalid input
     }
 
-    if (value < INT_MIN || value > INT_MAX) {
-        return -1; // Out of range for int
+    int64_t value = 0;
+    for (int i = 0; i < len; ++i) {
+        if (str[i] < '0' || str[i] > '9') {
+            return -2; // Invalid input
+        }
+        value = value * 10 + (str[i] - '0');
+        if (value > INT_MAX) {
+            return -1; // Out of range for int
+        }
     }
 
     *result = (int)value;
@@ -60,3 +60,299 @@ char *util_int_to_str(int x) {
     sprintf(str, "%d", x);
     return str;
 }
+
+// FNV-1a
+uint32_t util_hash_bytes(const char *str, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * # Interned strings
+ *
+ * Equal strings are stored once and live until exit, so an interned string is
+ * compared by its ptr. Only for what the parser reads - names and string
+ * literals - so the table grows with the source parsed, never with what a
+ * program does at run time.
+ */
+
+static struct util_Interned {
+    const char *str;
+    uint32_t hash;
+    uint32_t len;
+} *UTIL_INTERNED = NULL; // open addressing table, str is NULL when empty
+
+static int UTIL_INTERNED_CAP = 0; // power of 2
+static int UTIL_INTERNED_LEN = 0;
+
+static void util_intern_grow() {
+    int old_cap = UTIL_INTERNED_CAP;
+    struct util_Interned *old = UTIL_INTERNED;
+
+    UTIL_INTERNED_CAP = old_cap == 0 ? 64 : old_cap * 2;
+    UTIL_INTERNED = calloc(UTIL_INTERNED_CAP, sizeof(struct util_Interned));
+
+    uint32_t mask = UTIL_INTERNED_CAP - 1;
+    for (int i = 0; i < old_cap; ++i) {
+        if (old[i].str == NULL)
+            continue;
+        uint32_t j = old[i].hash & mask;
+        while (UTIL_INTERNED[j].str != NULL) {
+            j = (j + 1) & mask;
+        }
+        UTIL_INTERNED[j] = old[i];
+    }
+    free(old);
+}
+
+// str doesn't need to be NUL terminated, the interned one is
+const char *util_intern(const char *str, size_t len) {
+    // keep the load factor under 3/4
+    if ((UTIL_INTERNED_LEN + 1) * 4 > UTIL_INTERNED_CAP * 3) {
+        util_intern_grow();
+    }
+
+    uint32_t hash = util_hash_bytes(str, len);
+    uint32_t mask = UTIL_INTERNED_CAP - 1;
+    uint32_t i = hash & mask;
+    for (; UTIL_INTERNED[i].str != NULL; i = (i + 1) & mask) {
+        struct util_Interned *entry = &UTIL_INTERNED[i];
+        if (entry->hash == hash && entry->len == len &&
+            memcmp(entry->str, str, len) == 0) {
+            return entry->str;
+        }
+    }
+
+    char *copy = malloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    UTIL_INTERNED[i] = (struct util_Interned){
+        .str = copy,
+        .hash = hash,
+        .len = len,
+    };
+    UTIL_INTERNED_LEN++;
+    return copy;
+}
+
+/*
+ * # Size classes
+ *
+ * Objects, envs and the small buffers behind them come and go all the time.
+ * Blocks up to UTIL_SLAB_MAX bytes are cut out of big chunks and put on the
+ * free list of their size class when freed, so once a program's heap stops
+ * growing it stops calling malloc. Chunks are never given back. Bigger
+ * blocks go straight to malloc.
+ *
+ * Blocks have no header, the size is passed back when freeing one.
+ */
+
+#define UTIL_SLAB_MIN 16 // the smallest class, they double up to the max
+#define UTIL_SLAB_MAX 512
+#define UTIL_SLAB_CLASSES 6
+#define UTIL_SLAB_CHUNK_SIZE (64 * 1024)
+
+// only what goes through the slab - arenas, dyn arrs and gb strings call
+// malloc on their own
+struct util_Slab_stats {
+    size_t mallocs; // chunks, and blocks bigger than the max
+    size_t allocs;
+    size_t frees;
+};
+
+struct util_Slab_block {
+    struct util_Slab_block *next; // while on a free list
+};
+
+static struct util_Slab {
+    struct util_Slab_block *free[UTIL_SLAB_CLASSES];
+    char *chunk; // bumped
+    size_t chunk_left;
+    struct util_Slab_stats stats;
+} UTIL_SLAB = { 0 };
+
+static inline int util_slab_class(size_t size) {
+    if (size <= UTIL_SLAB_MIN)
+        return 0;
+    // bits of size - 1, past the smallest class's
+    return (int)(sizeof(unsigned long) * CHAR_BIT) -
+           __builtin_clzl(size - 1) - 4;
+}
+
+void *util_slab_alloc(size_t size) {
+    UTIL_SLAB.stats.allocs++;
+    if (size > UTIL_SLAB_MAX) {
+        UTIL_SLAB.stats.mallocs++;
+        return malloc(size);
+    }
+
+    int class = util_slab_class(size);
+    struct util_Slab_block *block = UTIL_SLAB.free[class];
+    if (block != NULL) {
+        UTIL_SLAB.free[class] = block->next;
+        return block;
+    }
+
+    // a class size is a multiple of the smallest, so blocks stay aligned
+    size_t class_size = (size_t)UTIL_SLAB_MIN << class;
+    if (UTIL_SLAB.chunk_left < class_size) {
+        UTIL_SLAB.stats.mallocs++;
+        UTIL_SLAB.chunk = malloc(UTIL_SLAB_CHUNK_SIZE);
+        UTIL_SLAB.chunk_left = UTIL_SLAB_CHUNK_SIZE;
+    }
+    void *ptr = UTIL_SLAB.chunk;
+    UTIL_SLAB.chunk += class_size;
+    UTIL_SLAB.chunk_left -= class_size;
+    return ptr;
+}
+
+// size must be what the block was allocated with
+void util_slab_free(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return;
+    UTIL_SLAB.stats.frees++;
+    if (size > UTIL_SLAB_MAX) {
+        free(ptr);
+        return;
+    }
+
+    struct util_Slab_block *block = ptr;
+    int class = util_slab_class(size);
+    block->next = UTIL_SLAB.free[class];
+    UTIL_SLAB.free[class] = block;
+}
+
+struct util_Slab_stats util_slab_stats() {
+    return UTIL_SLAB.stats;
+}
+
+/*
+ * # Arenas
+ *
+ * Bump allocation for data that dies all at once - the ast of a program, the
+ * args of a call. Nothing is freed one by one, an arena is released whole or
+ * rewound to a mark.
+ *
+ * Dyn arrs can't live in an arena since they realloc, instead the fields
+ * holding them are handed over with util_arena_own_da and freed on release.
+ */
+
+#define UTIL_ARENA_CHUNK_SIZE (16 * 1024)
+#define UTIL_ARENA_ALIGN sizeof(void *) // nothing in an arena needs more
+
+struct util_Arena_chunk {
+    struct util_Arena_chunk *prev;
+    size_t size;
+    size_t used;
+    _Alignas(UTIL_ARENA_ALIGN) char data[];
+};
+
+struct util_Arena {
+    struct util_Arena_chunk *chunk; // bumped, linked to the older ones
+    struct util_Arena_chunk *spare; // rewound chunks kept for reuse
+    void ***owned_da; // fields holding dyn arrs
+
+    // shared by whatever must keep it alive, ex: a program and its fn objects
+    int refcount;
+};
+
+struct util_Arena_mark {
+    struct util_Arena_chunk *chunk;
+    size_t used;
+};
+
+struct util_Arena *util_alloc_arena() {
+    struct util_Arena *arena = malloc(sizeof(struct util_Arena));
+    *arena = (struct util_Arena){ .refcount = 1 };
+    return arena;
+}
+
+static void util_free_chunks(struct util_Arena_chunk *chunk) {
+    while (chunk != NULL) {
+        struct util_Arena_chunk *prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+}
+
+struct util_Arena *util_arena_retain(struct util_Arena *arena) {
+    if (arena != NULL) {
+        arena->refcount++;
+    }
+    return arena;
+}
+
+// frees everything in the arena once the last ref is dropped
+void util_arena_release(struct util_Arena *arena) {
+    if (arena == NULL || --arena->refcount > 0)
+        return;
+
+    for (int i = 0; i < stbds_arrlen(arena->owned_da); ++i) {
+        stbds_arrfree(*arena->owned_da[i]);
+    }
+    stbds_arrfree(arena->owned_da);
+    util_free_chunks(arena->chunk);
+    util_free_chunks(arena->spare);
+    free(arena);
+}
+
+void *util_arena_alloc(struct util_Arena *arena, size_t size) {
+    size = (size + UTIL_ARENA_ALIGN - 1) & ~(UTIL_ARENA_ALIGN - 1);
+
+    struct util_Arena_chunk *chunk = arena->chunk;
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        if (arena->spare != NULL && arena->spare->size >= size) {
+            chunk = arena->spare;
+            arena->spare = chunk->prev;
+        } else {
+            size_t chunk_size =
+                size > UTIL_ARENA_CHUNK_SIZE ? size : UTIL_ARENA_CHUNK_SIZE;
+            chunk = malloc(sizeof(struct util_Arena_chunk) + chunk_size);
+            chunk->size = chunk_size;
+        }
+        chunk->used = 0;
+        chunk->prev = arena->chunk;
+        arena->chunk = chunk;
+    }
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+char *
+util_arena_strndup(struct util_Arena *arena, const char *str, size_t len) {
+    char *copy = util_arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// the dyn arr in *field is freed with the arena, field must live as long
+void util_arena_own_da(struct util_Arena *arena, void *field) {
+    stbds_arrput(arena->owned_da, (void **)field);
+}
+
+struct util_Arena_mark util_arena_mark(struct util_Arena *arena) {
+    return (struct util_Arena_mark){
+        .chunk = arena->chunk,
+        .used = arena->chunk != NULL ? arena->chunk->used : 0,
+    };
+}
+
+// drops everything allocated since the mark
+void util_arena_rewind(struct util_Arena *arena, struct util_Arena_mark mark) {
+    while (arena->chunk != mark.chunk) {
+        struct util_Arena_chunk *chunk = arena->chunk;
+        arena->chunk = chunk->prev;
+        chunk->prev = arena->spare;
+        arena->spare = chunk;
+    }
+    if (arena->chunk != NULL) {
+        arena->chunk->used = mark.used;
+    }
+}
@@ -0,0 +1,483 @@
+#pragma once
+#include "builtin.c"
+#include "code.c"
+#include "compiler.c"
+#include "eval.c"
+#include "object.c"
+
+/*
+ * # Virtual Machine
+ *
+ * Stack machine executing the compiler's bytecode. Every function call pushes
+ * a frame pointing at its closure, the frame's locals live on the value stack
+ * right above the call arguments. Tail calls take over the caller's frame
+ * instead, so loops written as recursion run in constant space.
+ */
+
+#define VM_STACK_SIZE (1 << 20)
+#define VM_MAX_FRAMES (1 << 16)
+#define VM_GLOBALS_SIZE (1 << 16)
+
+// the length of a single slot rooted as a range
+static const int VM_ONE_SLOT = 1;
+
+struct vm_Frame {
+    obj_Object *closure; // obj_FUNCTION with compiled fn
+    const uint8_t *ip; // next instruction to execute
+    int base_ptr; // stack index of the first local
+};
+
+static inline const uint8_t *vm_frame_instructions(struct vm_Frame *frame) {
+    return frame->closure->m_func->compiled->m_compiled_fn->instructions_da;
+}
+
+struct vm_VM {
+    obj_Object **constants_da;
+    int num_constants;
+    obj_Object **globals; // kept by the caller across runs
+    struct cmp_Symbol_table *global_symbols;
+
+    obj_Object **stack;
+    int sp; // always points to the next free slot, top of stack is sp - 1
+
+    struct vm_Frame *frames;
+    int frame_idx; // current frame
+
+    obj_Object *last_popped;
+
+    obj_Object main_fn;
+    obj_Object main_closure;
+    struct obj_Compiled_fn main_compiled_fn;
+    struct obj_Func main_func;
+};
+
+// must free after using
+obj_Object **vm_alloc_globals() {
+    return calloc(VM_GLOBALS_SIZE, sizeof(obj_Object *));
+}
+
+// constructor
+struct vm_VM *vm_alloc_vm(struct cmp_Bytecode bytecode, obj_Object **globals) {
+    struct vm_VM *vm = malloc(sizeof(struct vm_VM));
+    vm->constants_da = bytecode.constants_da;
+    vm->num_constants = stbds_arrlen(bytecode.constants_da);
+    vm->globals = globals;
+    vm->global_symbols = bytecode.globals;
+    vm->stack = malloc(VM_STACK_SIZE * sizeof(obj_Object *));
+    vm->sp = 0;
+    vm->frames = malloc(VM_MAX_FRAMES * sizeof(struct vm_Frame));
+    vm->frame_idx = 0;
+    vm->last_popped = NULL;
+
+    vm->main_compiled_fn = (struct obj_Compiled_fn){
+        .instructions_da = bytecode.instructions_da,
+    };
+    vm->main_fn = (obj_Object){
+        .type = obj_COMPILED_FUNCTION,
+        .m_compiled_fn = &vm->main_compiled_fn,
+    };
+    vm->main_func = (struct obj_Func){ .compiled = &vm->main_fn };
+    vm->main_closure = (obj_Object){
+        .type = obj_FUNCTION,
+        .m_func = &vm->main_func,
+    };
+
+    vm->frames[0] = (struct vm_Frame){
+        .closure = &vm->main_closure,
+        .ip = bytecode.instructions_da,
+        .base_ptr = 0,
+    };
+    return vm;
+}
+
+void vm_free_vm(struct vm_VM *vm) {
+    if (vm == NULL)
+        return;
+    free(vm->stack);
+    free(vm->frames);
+    free(vm);
+}
+
+enum ast_Operator vm_operator(enum code_Opcode op) {
+    switch (op) {
+        case op_ADD:
+            return ast_OP_PLUS;
+        case op_SUB:
+            return ast_OP_MINUS;
+        case op_MUL:
+            return ast_OP_ASTERISK;
+        case op_DIV:
+            return ast_OP_SLASH;
+        case op_LESS_THAN:
+            return ast_OP_LT;
+        case op_GREATER_THAN:
+            return ast_OP_GT;
+        case op_EQUAL:
+            return ast_OP_EQ;
+        case op_NOT_EQUAL:
+            return ast_OP_NOT_EQ;
+        default:
+            assert(0 && "unreachable");
+    }
+}
+
+obj_Object *
+vm_exec_binary_op(enum code_Opcode op, obj_Object *left, obj_Object *right) {
+    if (obj_type(left) == obj_INTEGER && obj_type(right) == obj_INTEGER) {
+        int l = obj_int_val(left);
+        int r = obj_int_val(right);
+        int res = 0;
+        // what fails is left for the evaluator to report
+        switch (op) {
+            case op_ADD:
+                if (__builtin_add_overflow(l, r, &res))
+                    break;
+                return obj_int(res);
+            case op_SUB:
+                if (__builtin_sub_overflow(l, r, &res))
+                    break;
+                return obj_int(res);
+            case op_MUL:
+                if (__builtin_mul_overflow(l, r, &res))
+                    break;
+                return obj_int(res);
+            case op_DIV:
+                break;
+            case op_LESS_THAN:
+                return obj_native_bool_object(l < r);
+            case op_GREATER_THAN:
+                return obj_native_bool_object(l > r);
+            case op_EQUAL:
+                return obj_native_bool_object(l == r);
+            case op_NOT_EQUAL:
+                return obj_native_bool_object(l != r);
+            default:
+                assert(0 && "unreachable");
+        }
+    }
+
+    // everything else goes through the evaluator, so its semantics and error
+    // messages are shared
+    return eval_infix_expr(vm_operator(op), left, right);
+}
+
+// a tail call returns what the callee does, builtins are called like any
+// other call
+obj_Object *vm_exec_call(struct vm_VM *vm, int num_args, bool tail) {
+    obj_Object *callee = vm->stack[vm->sp - 1 - num_args];
+
+    if (obj_type(callee) == obj_FUNCTION && callee->m_func->compiled != NULL) {
+        obj_Object *fn = callee->m_func->compiled;
+        obj_Object *err =
+            eval_check_num_args(fn->m_compiled_fn->num_params, num_args);
+        if (err != NULL) {
+            return err;
+        }
+
+        bool reuse = tail && vm->frame_idx > 0;
+        if ((!reuse && (vm->frame_idx + 1 >= VM_MAX_FRAMES ||
+                        vm->frame_idx >= eval_max_depth())) ||
+            vm->sp + fn->m_compiled_fn->num_locals >= VM_STACK_SIZE) {
+            return obj_alloc_err_object("stack overflow");
+        }
+
+        struct vm_Frame *frame = NULL;
+        if (reuse) {
+            // the callee and args go where the caller's closure and locals were
+            frame = &vm->frames[vm->frame_idx];
+            obj_Object **dst = &vm->stack[frame->base_ptr - 1];
+            memmove(
+                dst,
+                &vm->stack[vm->sp - 1 - num_args],
+                (num_args + 1) * sizeof(obj_Object *)
+            );
+            vm->sp = frame->base_ptr + num_args;
+        } else {
+            frame = &vm->frames[++vm->frame_idx];
+        }
+        frame->closure = callee;
+        frame->ip = fn->m_compiled_fn->instructions_da;
+        frame->base_ptr = vm->sp - num_args;
+
+        // locals which are not params start out as null
+        int num_locals = fn->m_compiled_fn->num_locals;
+        for (int i = num_args; i < num_locals; ++i) {
+            vm->stack[frame->base_ptr + i] = obj_null();
+        }
+        vm->sp = frame->base_ptr + num_locals;
+        return NULL;
+    }
+
+    if (obj_type(callee) == obj_BUILTIN) {
+        obj_Object **args = &vm->stack[vm->sp - num_args];
+        obj_Object *res = eval_builtins(callee, args, num_args);
+        if (obj_is_err(res)) {
+            return res;
+        }
+
+        vm->sp -= num_args + 1;
+        vm->stack[vm->sp++] = res != NULL ? res : obj_null();
+        return NULL;
+    }
+
+    return obj_alloc_err_object("not a function: %d", obj_type(callee));
+}
+
+/*
+ * Runs until the main frame finishes, returns the last popped value (NULL if
+ * the last statement was a let) or the first error.
+ *
+ * The gc may collect at every call. Everything live is on the value stack -
+ * the closures of the frames too, below their args - in the globals or in
+ * the constants, which are all rooted while running.
+ */
+obj_Object *vm_run(struct vm_VM *vm) {
+    int roots = gc_save_roots();
+    gc_push_range_root(vm->stack, &vm->sp);
+    gc_push_range_root(vm->globals, &vm->global_symbols->num_definitions);
+    gc_push_range_root(vm->constants_da, &vm->num_constants);
+    gc_push_range_root(&vm->last_popped, &VM_ONE_SLOT);
+
+    struct vm_Frame *frame = &vm->frames[vm->frame_idx];
+    const uint8_t *ip = frame->ip;
+    obj_Object **stack = vm->stack;
+    obj_Object *err = NULL;
+
+    // main frame code ends without an explicit return
+    const uint8_t *main_ins = vm->main_fn.m_compiled_fn->instructions_da;
+    const uint8_t *main_end = main_ins + stbds_arrlen(main_ins);
+
+#define VM_PUSH(obj) (stack[vm->sp++] = (obj))
+#define VM_POP() (stack[--vm->sp])
+#define VM_READ_U8() (ip += 1, ip[-1])
+#define VM_READ_U16() (ip += 2, code_read_u16(ip - 2))
+#define VM_READ_U32() (ip += 4, code_read_u32(ip - 4))
+
+    while (vm->frame_idx > 0 || ip < main_end) {
+        if (vm->sp >= VM_STACK_SIZE - 1) {
+            err = obj_alloc_err_object("stack overflow");
+            break;
+        }
+
+        enum code_Opcode op = *ip++;
+        switch (op) {
+            case op_CONSTANT:
+                VM_PUSH(vm->constants_da[VM_READ_U32()]);
+                break;
+            case op_POP:
+                vm->last_popped = VM_POP();
+                break;
+            case op_ADD:
+            case op_SUB:
+            case op_MUL:
+            case op_DIV:
+            case op_EQUAL:
+            case op_NOT_EQUAL:
+            case op_LESS_THAN:
+            case op_GREATER_THAN: {
+                obj_Object *right = VM_POP();
+                obj_Object *left = VM_POP();
+                obj_Object *res = vm_exec_binary_op(op, left, right);
+                if (obj_is_err(res)) {
+                    err = res;
+                    break;
+                }
+                VM_PUSH(res);
+                break;
+            }
+            case op_TRUE:
+                VM_PUSH(obj_native_bool_object(true));
+                break;
+            case op_FALSE:
+                VM_PUSH(obj_native_bool_object(false));
+                break;
+            case op_NULL:
+                VM_PUSH(obj_null());
+                break;
+            case op_MINUS: {
+                obj_Object *res = eval_minus_operator_prefix_expr(VM_POP());
+                if (obj_is_err(res)) {
+                    err = res;
+                    break;
+                }
+                VM_PUSH(res);
+                break;
+            }
+            case op_BANG: {
+                obj_Object *right = VM_POP();
+                VM_PUSH(eval_bang_operator_expr(right));
+                break;
+            }
+            case op_JUMP_NOT_TRUTHY: {
+                uint32_t target = VM_READ_U32();
+                if (!obj_is_truthy(VM_POP())) {
+                    ip = vm_frame_instructions(frame) + target;
+                }
+                break;
+            }
+            case op_JUMP:
+                ip = vm_frame_instructions(frame) + code_read_u32(ip);
+                break;
+            case op_GET_GLOBAL: {
+                // unset until its let runs, or if that line of the repl failed
+                int idx = VM_READ_U16();
+                if (vm->globals[idx] == NULL) {
+                    err = obj_alloc_err_object(
+                        "identifier not found: %s",
+                        cmp_global_name(vm->global_symbols, idx)
+                    );
+                    break;
+                }
+                VM_PUSH(vm->globals[idx]);
+                break;
+            }
+            case op_SET_GLOBAL:
+                vm->globals[VM_READ_U16()] = VM_POP();
+                vm->last_popped = NULL;
+                break;
+            case op_GET_LOCAL:
+                VM_PUSH(stack[frame->base_ptr + VM_READ_U16()]);
+                break;
+            case op_SET_LOCAL:
+                stack[frame->base_ptr + VM_READ_U16()] = VM_POP();
+                break;
+            case op_GET_BUILTIN:
+                VM_PUSH(&BUILTIN_OBJECTS[VM_READ_U8()]);
+                break;
+            case op_GET_FREE:
+                VM_PUSH(frame->closure->m_func->free_da[VM_READ_U8()]);
+                break;
+            case op_CURRENT_CLOSURE:
+                VM_PUSH(frame->closure);
+                break;
+            case op_ARRAY: {
+                int n = VM_READ_U32();
+                obj_Object *arr = obj_alloc_arr(stack + vm->sp - n, n);
+                vm->sp -= n;
+                VM_PUSH(arr);
+                break;
+            }
+            case op_HASH: {
+                int n = VM_READ_U32();
+                obj_Object *hash = obj_alloc_object(obj_HASH);
+                for (int i = vm->sp - n; i < vm->sp && !obj_is_err(hash);
+                     i += 2) {
+                    hash = eval_hash_put(hash, stack[i], stack[i + 1]);
+                }
+                vm->sp -= n;
+                if (obj_is_err(hash)) {
+                    err = hash;
+                    break;
+                }
+                VM_PUSH(hash);
+                break;
+            }
+            case op_INDEX: {
+                obj_Object *index = VM_POP();
+                obj_Object *left = VM_POP();
+                obj_Object *res = eval_idx_expr(left, index);
+                if (obj_is_err(res)) {
+                    err = res;
+                    break;
+                }
+                VM_PUSH(res);
+                break;
+            }
+            case op_CALL:
+            case op_TAIL_CALL: {
+                int num_args = VM_READ_U8();
+                gc_maybe_collect();
+                frame->ip = ip;
+                err = vm_exec_call(vm, num_args, op == op_TAIL_CALL);
+                frame = &vm->frames[vm->frame_idx];
+                ip = frame->ip;
+                break;
+            }
+            case op_RETURN_VALUE:
+            case op_RETURN: {
+                obj_Object *ret = op == op_RETURN ? obj_null() : VM_POP();
+                if (vm->frame_idx == 0) {
+                    // top level return ends the program
+                    vm->last_popped = ret;
+                    ip = main_end;
+                    break;
+                }
+                vm->sp = frame->base_ptr - 1;
+                frame = &vm->frames[--vm->frame_idx];
+                ip = frame->ip;
+                VM_PUSH(ret);
+                break;
+            }
+            case op_CLOSURE: {
+                obj_Object *fn = vm->constants_da[VM_READ_U32()];
+                int num_free = VM_READ_U8();
+
+                obj_Object *closure = obj_alloc_object(obj_FUNCTION);
+                closure->m_func->lit = fn->m_compiled_fn->lit;
+                closure->m_func->arena =
+                    util_arena_retain(fn->m_compiled_fn->arena);
+                closure->m_func->params = fn->m_compiled_fn->params;
+                closure->m_func->body = fn->m_compiled_fn->body;
+                closure->m_func->compiled = fn;
+                if (num_free > 0) {
+                    obj_Object **free_da =
+                        stbds_arraddnptr(closure->m_func->free_da, num_free);
+                    memcpy(
+                        free_da,
+                        stack + vm->sp - num_free,
+                        num_free * sizeof(obj_Object *)
+                    );
+                    vm->sp -= num_free;
+                }
+                VM_PUSH(closure);
+                break;
+            }
+            default:
+                assert(0 && "unreachable");
+        }
+
+        if (err != NULL) {
+            break;
+        }
+    }
+
+#undef VM_PUSH
+#undef VM_POP
+#undef VM_READ_U8
+#undef VM_READ_U16
+#undef VM_READ_U32
+
+    frame->ip = ip;
+    gc_restore_roots(roots);
+    if (err != NULL) {
+        return err;
+    }
+
+    return vm->last_popped;
+}
+
+/*
+ * Compiles and runs a whole program with fresh globals, compile errors are
+ * returned as an error object.
+ */
+obj_Object *vm_eval_program(struct ast_Program *program) {
+    struct cmp_Symbol_table *symbols = cmp_alloc_global_symbol_table();
+    struct cmp_Compiler *compiler = cmp_alloc_compiler(symbols, NULL);
+    cmp_compile_program(compiler, program);
+
+    obj_Object *res = NULL;
+    if (stbds_arrlen(compiler->errors_da) != 0) {
+        res = obj_alloc_err_object("%s", compiler->errors_da[0]);
+    } else {
+        obj_Object **globals = vm_alloc_globals();
+        struct vm_VM *vm = vm_alloc_vm(cmp_bytecode(compiler), globals);
+        res = vm_run(vm);
+        vm_free_vm(vm);
+        free(globals);
+    }
+
+    stbds_arrfree(compiler->constants_da);
+    cmp_free_compiler(compiler);
+    cmp_free_symbol_table(symbols);
+    return res;
+}
@@ -5,34 +5,106 @@
 SUITE(ast_suite);
 
 TEST ast_test_program_string(void) {
+    struct ast_Program *prg = ast_alloc_program();
+    struct util_Arena *arena = prg->arena;
 
-    struct ast_Stmt *let_stmt = ast_alloc_stmt(ast_LET_STMT);
-    let_stmt->token.type = tok_LET;
-    strcpy(let_stmt->token.literal, "let");
+    struct ast_Stmt *let_stmt = ast_alloc_stmt(arena, ast_LET_STMT);
 
-    let_stmt->data.let.name = ast_alloc_expr(ast_IDENT_EXPR);
-    let_stmt->data.let.name->token.type = tok_IDENT;
-    strcpy(let_stmt->data.let.name->token.literal, "myVar");
-    strcpy(let_stmt->data.let.name->data.ident.value, "myVar");
+    let_stmt->data.let.name = ast_alloc_expr(arena, ast_IDENT_EXPR);
+    let_stmt->data.let.name->data.ident.value = util_intern("myVar", 5);
 
     // FIXME: maybe needed to be included in the constructor  itself
-    let_stmt->data.let.value = ast_alloc_expr(ast_IDENT_EXPR);
-    strcpy(let_stmt->data.let.value->token.literal, "anotherVar");
-    strcpy(let_stmt->data.let.value->data.ident.value, "anotherVar");
+    let_stmt->data.let.value = ast_alloc_expr(arena, ast_IDENT_EXPR);
+    let_stmt->data.let.value->data.ident.value =
+        util_intern("anotherVar", 10);
 
-    struct ast_Stmt **stmts = NULL;
-    stbds_arrput(stmts, let_stmt);
+    stbds_arrput(prg->statement_ptrs_da, let_stmt);
 
-    struct ast_Program prg = { .statement_ptrs_da = stmts };
-
-    gbString prg_str = ast_make_program_str(&prg);
+    gbString prg_str = ast_make_program_str(prg);
     ASSERT_STR_EQ("let myVar = anotherVar;", prg_str);
 
-    ast_free_stmt(let_stmt);
+    ast_free_program(prg);
     gb_free_string(prg_str);
     PASS();
 }
 
+TEST ast_test_shared_fn_lit(void) {
+    struct ast_Program *prg = ast_alloc_program();
+    struct util_Arena *arena = prg->arena;
+
+    struct ast_Expr *fn_lit = ast_alloc_expr(arena, ast_FN_LIT_EXPR);
+    fn_lit->data.fn_lit.body = ast_alloc_stmt(arena, ast_BLOCK_STMT);
+
+    struct ast_Expr *param = ast_alloc_expr(arena, ast_IDENT_EXPR);
+    param->data.ident.value = util_intern("x", 1);
+    stbds_arrput(fn_lit->data.fn_lit.params_da, param);
+
+    // a fn object holding on to the literal keeps it alive past its program
+    ASSERT_EQ(arena, util_arena_retain(arena));
+    ast_free_program(prg);
+    ASSERT_EQ(1, arena->refcount);
+
+    gbString str = ast_make_expr_str(fn_lit);
+    ASSERT_STR_EQ("fn(x) ", str);
+    gb_free_string(str);
+
+    util_arena_release(arena);
+    PASS();
+}
+
+TEST ast_test_arena(void) {
+    struct util_Arena *arena = util_alloc_arena();
+
+    // allocations are ptr aligned and never overlap
+    char *a = util_arena_alloc(arena, 3);
+    char *b = util_arena_alloc(arena, 8);
+    ASSERT_EQ(0, (uintptr_t)b % sizeof(void *));
+    ASSERT(b >= a + 3);
+
+    // larger than a chunk
+    char *big = util_arena_alloc(arena, 2 * UTIL_ARENA_CHUNK_SIZE);
+    memset(big, 'x', 2 * UTIL_ARENA_CHUNK_SIZE);
+
+    // rewinding hands the same memory out again
+    struct util_Arena_mark mark = util_arena_mark(arena);
+    char *c = util_arena_alloc(arena, UTIL_ARENA_CHUNK_SIZE);
+    util_arena_rewind(arena, mark);
+    ASSERT_EQ(c, util_arena_alloc(arena, UTIL_ARENA_CHUNK_SIZE));
+
+    ASSERT_STR_EQ("lilac", util_arena_strndup(arena, "lilac monkey", 5));
+
+    util_arena_release(arena);
+    PASS();
+}
+
+TEST ast_test_compact_nodes(void) {
+    // nodes hold no literals, only ptrs and small values
+    ASSERT(sizeof(struct ast_Expr) <= 32);
+    ASSERT(sizeof(struct ast_Stmt) <= 24);
+
+    // equal names are interned to the same string
+    char name[] = "counter";
+    ASSERT_EQ(util_intern(name, 7), util_intern("counter", 7));
+    ASSERT(util_intern("count", 5) != util_intern(name, 7));
+    ASSERT_STR_EQ("count", util_intern(name, 5));
+
+    struct util_Arena *arena = util_alloc_arena();
+    struct ast_Expr *pf = ast_alloc_expr(arena, ast_PREFIX_EXPR);
+    pf->data.pf.op = ast_OP_BANG;
+    pf->data.pf.right = ast_alloc_expr(arena, ast_BOOL_EXPR);
+    pf->data.pf.right->data.boolean.value = true;
+
+    gbString str = ast_make_expr_str(pf);
+    ASSERT_STR_EQ("(!true)", str);
+    gb_free_string(str);
+
+    util_arena_release(arena);
+    PASS();
+}
+
 SUITE(ast_suite) {
     RUN_TEST(ast_test_program_string);
+    RUN_TEST(ast_test_shared_fn_lit);
+    RUN_TEST(ast_test_arena);
+    RUN_TEST(ast_test_compact_nodes);
 }
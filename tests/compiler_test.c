@@ -0,0 +1,283 @@
+#include "greatest.h"
+
+#include "../src/compiler.c"
+#include "../src/parser.c"
+
+SUITE(compiler_suite);
+
+TEST compiler_test_make_instructions(void) {
+    uint8_t *ins_da = NULL;
+    code_emit(&ins_da, op_CONSTANT, 65534);
+    code_emit(&ins_da, op_GET_LOCAL, 255);
+    code_emit(&ins_da, op_CLOSURE, 65535, 3);
+    code_emit(&ins_da, op_ADD);
+
+    uint8_t expected[] = {
+        op_CONSTANT, 0, 0, 255, 254, //
+        op_GET_LOCAL, 0, 255, //
+        op_CLOSURE, 0, 0, 255, 255, 3, //
+        op_ADD,
+    };
+    int n = sizeof(expected) / sizeof(expected[0]);
+    ASSERT_EQ(n, stbds_arrlen(ins_da));
+    for (int i = 0; i < n; ++i) {
+        ASSERT_EQ(expected[i], ins_da[i]);
+    }
+
+    gbString str = code_instructions_str(ins_da);
+    ASSERT_STR_EQ(
+        "0000 op_CONSTANT 65534\n"
+        "0005 op_GET_LOCAL 255\n"
+        "0008 op_CLOSURE 65535 3\n"
+        "0014 op_ADD\n",
+        str
+    );
+
+    gb_free_string(str);
+    stbds_arrfree(ins_da);
+    PASS();
+}
+
+// compiles input and returns the disassembled main instructions
+gbString test_compile(char *input, obj_Object ***constants_da) {
+    struct lex_Lexer lexer = lex_Lexer_create(input);
+    struct par_Parser *parser = par_alloc_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+
+    struct cmp_Symbol_table *symbols = cmp_alloc_global_symbol_table();
+    struct cmp_Compiler *compiler = cmp_alloc_compiler(symbols, NULL);
+    cmp_compile_program(compiler, program);
+    assert(stbds_arrlen(compiler->errors_da) == 0);
+
+    struct cmp_Bytecode bytecode = cmp_bytecode(compiler);
+    gbString str = code_instructions_str(bytecode.instructions_da);
+    *constants_da = compiler->constants_da;
+
+    cmp_free_compiler(compiler);
+    cmp_free_symbol_table(symbols);
+    par_free_parser(parser);
+    ast_free_program(program);
+    return str;
+}
+
+TEST compiler_test_instructions(void) {
+    struct {
+        char *input;
+        char *expected;
+    } tests[] = {
+        {
+            "1 + 2",
+            "0000 op_CONSTANT 0\n"
+            "0005 op_CONSTANT 1\n"
+            "0010 op_ADD\n"
+            "0011 op_POP\n",
+        },
+        {
+            "-1 < 2",
+            "0000 op_CONSTANT 0\n"
+            "0005 op_MINUS\n"
+            "0006 op_CONSTANT 1\n"
+            "0011 op_LESS_THAN\n"
+            "0012 op_POP\n",
+        },
+        {
+            "if (true) { 10 }; 3333;",
+            "0000 op_TRUE\n"
+            "0001 op_JUMP_NOT_TRUTHY 16\n"
+            "0006 op_CONSTANT 0\n"
+            "0011 op_JUMP 17\n"
+            "0016 op_NULL\n"
+            "0017 op_POP\n"
+            "0018 op_CONSTANT 1\n"
+            "0023 op_POP\n",
+        },
+        {
+            "let one = 1; let two = one; two;",
+            "0000 op_CONSTANT 0\n"
+            "0005 op_SET_GLOBAL 0\n"
+            "0008 op_GET_GLOBAL 0\n"
+            "0011 op_SET_GLOBAL 1\n"
+            "0014 op_GET_GLOBAL 1\n"
+            "0017 op_POP\n",
+        },
+        {
+            "len([1, 2])[\"a\"]",
+            "0000 op_GET_BUILTIN 0\n"
+            "0002 op_CONSTANT 0\n"
+            "0007 op_CONSTANT 1\n"
+            "0012 op_ARRAY 2\n"
+            "0017 op_CALL 1\n"
+            "0019 op_CONSTANT 2\n"
+            "0024 op_INDEX\n"
+            "0025 op_POP\n",
+        },
+    };
+
+    int n = sizeof(tests) / sizeof(tests[0]);
+    for (int i = 0; i < n; ++i) {
+        obj_Object **constants_da = NULL;
+        gbString str = test_compile(tests[i].input, &constants_da);
+        ASSERT_STR_EQ(tests[i].expected, str);
+        gb_free_string(str);
+        stbds_arrfree(constants_da);
+    }
+    PASS();
+}
+
+TEST compiler_test_closures(void) {
+    char *input = "fn(a) { fn(b) { a + b } }";
+
+    obj_Object **constants_da = NULL;
+    gbString str = test_compile(input, &constants_da);
+    ASSERT_STR_EQ(
+        "0000 op_CLOSURE 1 0\n"
+        "0006 op_POP\n",
+        str
+    );
+    ASSERT_EQ(2, stbds_arrlen(constants_da));
+
+    // inner fn gets `a` as free variable
+    obj_Object *inner = constants_da[0];
+    gbString inner_str =
+        code_instructions_str(inner->m_compiled_fn->instructions_da);
+    ASSERT_STR_EQ(
+        "0000 op_GET_FREE 0\n"
+        "0002 op_GET_LOCAL 0\n"
+        "0005 op_ADD\n"
+        "0006 op_RETURN_VALUE\n",
+        inner_str
+    );
+
+    obj_Object *outer = constants_da[1];
+    gbString outer_str =
+        code_instructions_str(outer->m_compiled_fn->instructions_da);
+    ASSERT_STR_EQ(
+        "0000 op_GET_LOCAL 0\n"
+        "0003 op_CLOSURE 0 1\n"
+        "0009 op_RETURN_VALUE\n",
+        outer_str
+    );
+    ASSERT_EQ(1, outer->m_compiled_fn->num_locals);
+
+    gb_free_string(inner_str);
+    gb_free_string(outer_str);
+    gb_free_string(str);
+    stbds_arrfree(constants_da);
+    PASS();
+}
+
+TEST compiler_test_recursive_fn(void) {
+    char *input = "let f = fn(x) { f(x - 1) };";
+
+    obj_Object **constants_da = NULL;
+    gbString str = test_compile(input, &constants_da);
+
+    obj_Object *fn = constants_da[1];
+    gbString fn_str = code_instructions_str(fn->m_compiled_fn->instructions_da);
+    ASSERT_STR_EQ(
+        "0000 op_CURRENT_CLOSURE\n"
+        "0001 op_GET_LOCAL 0\n"
+        "0004 op_CONSTANT 0\n"
+        "0009 op_SUB\n"
+        "0010 op_TAIL_CALL 1\n"
+        "0012 op_RETURN_VALUE\n",
+        fn_str
+    );
+
+    gb_free_string(fn_str);
+    gb_free_string(str);
+    stbds_arrfree(constants_da);
+    PASS();
+}
+
+// compiles input against the globals and returns the first compile error
+gbString test_compile_err(char *input, struct cmp_Symbol_table *symbols) {
+    struct lex_Lexer lexer = lex_Lexer_create(input);
+    struct par_Parser *parser = par_alloc_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+    assert(stbds_arrlen(par_parser_errors(parser)) == 0);
+
+    struct cmp_Compiler *compiler = cmp_alloc_compiler(symbols, NULL);
+    cmp_compile_program(compiler, program);
+    gbString err = stbds_arrlen(compiler->errors_da) == 0
+                       ? NULL
+                       : gb_duplicate_string(compiler->errors_da[0]);
+
+    stbds_arrfree(compiler->constants_da);
+    cmp_free_compiler(compiler);
+    par_free_parser(parser);
+    ast_free_program(program);
+    return err;
+}
+
+// identifiers are letters only - spells i in base 26
+char *test_name(char *buf, int i) {
+    int n = 0;
+    do {
+        buf[n++] = 'a' + i % 26;
+        i /= 26;
+    } while (i > 0);
+    buf[n] = '\0';
+    return buf;
+}
+
+TEST compiler_test_operand_overflow(void) {
+    struct cmp_Symbol_table *symbols = cmp_alloc_global_symbol_table();
+    char name[64];
+    char buf[32];
+
+    // the arg count of op_CALL is 1 byte wide, 255 args still fit
+    gbString call = gb_make_string("len(0");
+    for (int i = 1; i < 255; ++i) {
+        call = gb_append_cstring(call, ", 0");
+    }
+    gbString fits = gb_append_cstring(gb_duplicate_string(call), ")");
+    ASSERT_EQ(NULL, test_compile_err(fits, symbols));
+    call = gb_append_cstring(call, ", 0)");
+    gbString err = test_compile_err(call, symbols);
+    ASSERT(err != NULL);
+    ASSERT_STR_EQ("op_CALL operand 256 out of range (max 255)", err);
+    gb_free_string(err);
+
+    // so are free var indices and the free count of op_CLOSURE
+    gbString outer = gb_make_string("fn(");
+    gbString inner = gb_make_string("fn() { 0");
+    for (int i = 0; i < 257; ++i) {
+        test_name(buf, i);
+        snprintf(name, sizeof(name), "%sx%s", i == 0 ? "" : ", ", buf);
+        outer = gb_append_cstring(outer, name);
+        snprintf(name, sizeof(name), " + x%s", buf);
+        inner = gb_append_cstring(inner, name);
+    }
+    outer = gb_append_cstring(outer, ") { ");
+    outer = gb_append_string(outer, inner);
+    outer = gb_append_cstring(outer, " } }");
+    err = test_compile_err(outer, symbols);
+    ASSERT(err != NULL);
+    ASSERT_STR_EQ("op_GET_FREE operand 256 out of range (max 255)", err);
+    gb_free_string(err);
+
+    // global indices are 2 bytes wide, the size of the vm's globals
+    symbols->num_definitions = 65536;
+    err = test_compile_err("let g = 0;", symbols);
+    ASSERT(err != NULL);
+    ASSERT_STR_EQ("op_SET_GLOBAL operand 65536 out of range (max 65535)", err);
+    gb_free_string(err);
+
+    gb_free_string(call);
+    gb_free_string(fits);
+    gb_free_string(outer);
+    gb_free_string(inner);
+    cmp_free_symbol_table(symbols);
+    PASS();
+}
+
+SUITE(compiler_suite) {
+    RUN_TEST(compiler_test_make_instructions);
+    RUN_TEST(compiler_test_instructions);
+    RUN_TEST(compiler_test_closures);
+    RUN_TEST(compiler_test_recursive_fn);
+    RUN_TEST(compiler_test_operand_overflow);
+}
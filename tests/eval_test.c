@@ -1,62 +1,90 @@
+#pragma once
 #include "greatest.h"
 #include "test_util.c"
 
 #include "../src/eval.c"
 #include "../src/object_env.c"
+#include "../src/optimizer.c"
 #include "../src/parser.c"
+#include "../src/resolver.c"
+#include "../src/vm.c"
 
 SUITE(eval_suite);
 
+// engine which test_eval runs programs on - the suite is run against both
+enum test_Engine {
+    test_ENGINE_EVAL,
+    test_ENGINE_OPTIMIZED, // the evaluator, after the optimizer
+    test_ENGINE_VM,
+} TEST_ENGINE = test_ENGINE_EVAL;
+
 obj_Object *test_eval(char *input) {
     struct lex_Lexer lexer = lex_Lexer_create(input);
     struct par_Parser *parser = par_alloc_parser(&lexer);
     struct ast_Program *program = ast_alloc_program();
     par_parse_program(parser, program);
-    obj_Env *env = obj_alloc_env();
 
-    obj_Object *res =
-        eval_eval((ast_Node){ ast_NODE_PRG, .prg = program }, env);
+    obj_Object *res = NULL;
+    if (TEST_ENGINE == test_ENGINE_VM) {
+        res = vm_eval_program(program);
+    } else {
+        struct res_Scope *globals = res_alloc_scope(NULL);
+        struct res_Resolver *resolver = res_alloc_resolver(globals);
+        res_resolve_program(resolver, program);
+
+        if (stbds_arrlen(resolver->errors_da) != 0) {
+            res = obj_alloc_err_object("%s", resolver->errors_da[0]);
+        } else {
+            if (TEST_ENGINE == test_ENGINE_OPTIMIZED) {
+                opt_optimize_program(program);
+            }
+            obj_Env *env = obj_alloc_env();
+            res = eval_eval((ast_Node){ ast_NODE_PRG, .prg = program }, env);
+        }
+        res_free_resolver(resolver);
+        res_free_scope(globals);
+    }
     par_free_parser(parser);
     ast_free_program(program);
-    obj_free_env(env);
     return res;
 }
 
 bool test_int_obj(obj_Object *obj, int expected) {
     assert(obj != NULL);
-    assert(obj->type == obj_INTEGER);
-    assert(obj->m_int == expected);
+    assert(obj_type(obj) == obj_INTEGER);
+    assert(obj_int_val(obj) == expected);
     return true;
 }
 
 bool test_bool_obj(obj_Object *obj, bool expected) {
-    assert(obj->type == obj_BOOLEAN);
+    assert(obj_type(obj) == obj_BOOLEAN);
     assert(obj->m_bool == expected);
     return true;
 }
 
 bool test_str_obj(obj_Object *obj, const char *expected) {
-    assert(obj->type == obj_STRING);
-    assert(0 == strcmp(obj->m_str, expected));
+    assert(obj_type(obj) == obj_STRING);
+    assert(obj_str_len(obj) == strlen(expected));
+    assert(0 == memcmp(obj_str(obj), expected, obj_str_len(obj)));
     return true;
 }
 
 bool test_arr_obj(obj_Object *obj, int n, int *expected) {
-    assert(obj->type == obj_ARRAY);
-    assert(stbds_arrlen(obj->m_arr_da) == n);
+    assert(obj_type(obj) == obj_ARRAY);
+    assert(obj_arr_len(obj) == n);
     for (int i = 0; i < n; ++i) {
-        assert(obj->m_arr_da[i]->m_int == expected[i]);
+        assert(obj_int_val(obj_arr_elems(obj)[i]) == expected[i]);
     }
     return true;
 }
 
 bool test_null_obj(obj_Object *obj) {
-    assert(obj->type == obj_NULL);
+    assert(obj_type(obj) == obj_NULL);
     return obj_is_same(obj, obj_null());
 }
 
 bool test_err_obj(obj_Object *obj, char *err_str) {
-    assert(obj->type == obj_ERROR);
+    assert(obj_type(obj) == obj_ERROR);
     return strcmp(obj->m_err_msg, err_str) == 0;
 }
 
@@ -75,8 +103,6 @@ TEST eval_test_int_expr(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_int_obj(evaluated, tests[i].expected));
-
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -111,8 +137,6 @@ TEST eval_test_bool_expr(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_bool_obj(evaluated, tests[i].expected));
-
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -130,7 +154,6 @@ TEST eval_test_bang_operator(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_bool_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -161,7 +184,6 @@ TEST eval_test_infix_expr(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_int_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -190,7 +212,6 @@ TEST eval_test_if_else_expr(void) {
         } else {
             ASSERT(test_null_obj(evaluated));
         }
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -220,7 +241,6 @@ if (10 > 1) {   \
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_int_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -272,13 +292,60 @@ if (10 > 1) {            \
             "\"Hello\" - \"World\"",
             "unknown operator: obj_STRING - obj_STRING",
         },
+        {
+            "{\"name\": \"Monkey\"}[fn(x) { x }];",
+            "unusable as hash key: obj_FUNCTION",
+        },
+        {
+            "{[1]: 2}",
+            "unusable as hash key: obj_ARRAY",
+        },
+        {
+            "1 / 0",
+            "division by zero",
+        },
+        {
+            "let zero = fn() { 0 }; 5 / zero()",
+            "division by zero",
+        },
+        {
+            "(-2147483647 - 1) / -1",
+            "integer overflow: -2147483648 / -1",
+        },
+        {
+            "2147483647 + 1",
+            "integer overflow: 2147483647 + 1",
+        },
+        {
+            "-2147483647 - 2",
+            "integer overflow: -2147483647 - 2",
+        },
+        {
+            "let sq = fn(x) { x * x }; sq(65536)",
+            "integer overflow: 65536 * 65536",
+        },
+        {
+            "-(-2147483647 - 1)",
+            "integer overflow: -(-2147483648)",
+        },
+        {
+            "fn(a) { a }()",
+            "wrong number of arguments: want=1, got=0",
+        },
+        {
+            "fn() { 1 }(1, 2)",
+            "wrong number of arguments: want=0, got=2",
+        },
+        {
+            "let f = fn(a, b) { if (a) { f(false) } else { b } }; f(true, 1)",
+            "wrong number of arguments: want=2, got=1",
+        },
     };
 
     int n = sizeof(tests) / sizeof(tests[0]);
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_err_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -298,7 +365,6 @@ TEST eval_test_let_stmt(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_int_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -307,11 +373,10 @@ TEST eval_test_func_obj(void) {
     char *input = "fn(x, y) { x + 2; };";
 
     obj_Object *evaluated = test_eval(input);
-    ASSERT_EQ(2, stbds_arrlen(evaluated->m_func.params));
-    ASSERT_STR_EQ("x", ast_make_expr_str(evaluated->m_func.params[0]));
-    ASSERT_STR_EQ("(x + 2)", ast_make_stmt_str(evaluated->m_func.body));
+    ASSERT_EQ(2, stbds_arrlen(evaluated->m_func->params));
+    ASSERT_STR_EQ("x", ast_make_expr_str(evaluated->m_func->params[0]));
+    ASSERT_STR_EQ("(x + 2)", ast_make_stmt_str(evaluated->m_func->body));
 
-    obj_free_object(evaluated);
     PASS();
 }
 
@@ -332,7 +397,6 @@ TEST eval_test_fn_appln(void) {
     for (int i = 0; i < n; ++i) {
         obj_Object *evaluated = test_eval(tests[i].input);
         ASSERT(test_int_obj(evaluated, tests[i].expected));
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -349,7 +413,25 @@ addTwo(22);                \
     obj_Object *evaluated = test_eval(input);
     ASSERT(test_int_obj(evaluated, 88));
 
-    obj_free_object(evaluated);
+    PASS();
+}
+
+TEST eval_test_shared_env(void) {
+    struct {
+        char *input;
+        int expected;
+    } tests[] = {
+        // closures see later updates to globals
+        { "let a = 1; let f = fn() { a }; let a = 2; f();", 2 },
+        // each call gets its own frame
+        { "let id = fn(x) { fn() { x } }; id(1)() + id(2)()", 3 },
+    };
+
+    int n = sizeof(tests) / sizeof(tests[0]);
+    for (int i = 0; i < n; ++i) {
+        obj_Object *evaluated = test_eval(tests[i].input);
+        ASSERT(test_int_obj(evaluated, tests[i].expected));
+    }
     PASS();
 }
 
@@ -368,7 +450,181 @@ counter(0);                \
 
     obj_Object *evaluated = test_eval(input);
     ASSERT(test_int_obj(evaluated, 999));
-    obj_free_object(evaluated);
+    PASS();
+}
+
+TEST eval_test_mutual_recursion(void) {
+    // globals can be called before the let defining them ran
+    char *input = "                                                    \
+let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } };          \
+let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } };         \
+[even(10), odd(7), even(7)]                                            \
+";
+
+    obj_Object *evaluated = test_eval(input);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[0], true));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[1], true));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[2], false));
+
+    // but not read before it
+    ASSERT(test_err_obj(
+        test_eval("let f = fn() { x }; let y = f(); let x = 1;"),
+        "identifier not found: x"
+    ));
+    PASS();
+}
+
+TEST eval_test_tail_calls(void) {
+    // far deeper than the frame stack would allow if every call nested
+    char input[] = "                                                    \
+let loop = fn(i, acc) { if (i == 0) { return acc; } loop(i - 1, acc + 2) }; \
+let ping = fn(n) { if (n == 0) { 1 } else { pong(n - 1) } };                \
+let pong = fn(n) { if (n == 0) { 2 } else { return ping(n - 1) } };         \
+[loop(1000000, 0), ping(1000001), loop(3, 0) + 1]                           \
+";
+
+    obj_Object *evaluated = test_eval(input);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[0], 2000000));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[1], 2));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[2], 7));
+    PASS();
+}
+
+TEST eval_test_stack_overflow(void) {
+    char depth[] = "                                                 \
+let depth = fn(n) { if (n == 0) { 0 } else { 1 + depth(n - 1) } };    \
+[depth(50), depth(200), depth(20000)]                                  \
+";
+    char runaway[] = "                                               \
+let depth = fn(n) { if (n == 0) { 0 } else { 1 + depth(n - 1) } };    \
+depth(10000000)                                                        \
+";
+
+    eval_set_max_depth(100);
+    obj_Object *evaluated = test_eval(depth);
+    eval_set_max_depth(INT_MAX);
+    ASSERT(test_err_obj(evaluated, "stack overflow"));
+
+    evaluated = test_eval(depth);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[0], 50));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[1], 200));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[2], 20000));
+
+    // an error instead of running out of memory
+    evaluated = test_eval(runaway);
+    ASSERT(test_err_obj(evaluated, "stack overflow"));
+    PASS();
+}
+
+TEST eval_test_deep_nesting(void) {
+    // nested exprs without calls, as deep as the parser lets them
+    int depth = PAR_MAX_DEPTH / 2;
+    gbString arrs = gb_make_string("");
+    gbString sums = gb_make_string("");
+    gbString body = gb_make_string("f(n - 1)");
+    for (int i = 0; i < depth; ++i) {
+        arrs = gb_append_cstring(arrs, "[");
+        sums = gb_append_cstring(sums, "1 + ");
+    }
+    // the fn, if and blocks around it take a few levels
+    for (int i = 0; i < PAR_MAX_DEPTH - 8; ++i) {
+        body = gb_append_cstring(body, " + 1");
+    }
+    arrs = gb_append_cstring(arrs, "1");
+    sums = gb_append_cstring(sums, "1");
+    for (int i = 0; i < depth; ++i) {
+        arrs = gb_append_cstring(arrs, "]");
+    }
+
+    obj_Object *evaluated = test_eval(arrs);
+    for (int i = 0; i < depth; ++i) {
+        ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+        evaluated = obj_arr_elems(evaluated)[0];
+    }
+    ASSERT(test_int_obj(evaluated, 1));
+    ASSERT(test_int_obj(test_eval(sums), depth + 1));
+
+    // calls which each nest deep exprs still stop at the frame limit
+    gbString calls =
+        gb_make_string("let f = fn(n) { if (n == 0) { 0 } else { ");
+    calls = gb_append_string(calls, body);
+    calls = gb_append_cstring(calls, " } }; ");
+    gbString deep = gb_append_cstring(gb_duplicate_string(calls), "f(1000000)");
+    ASSERT(test_err_obj(test_eval(deep), "stack overflow"));
+    calls = gb_append_cstring(calls, "f(3)");
+    ASSERT(test_int_obj(test_eval(calls), 3 * (PAR_MAX_DEPTH - 8)));
+
+    // values nested deeper than that compare without recursing
+    char values[] = "                                                   \
+let wrap = fn(x, n) { if (n == 0) { x } else { wrap([x], n - 1) } };       \
+let a = wrap(1, 50000);                                                    \
+[a == wrap(1, 50000), a == wrap(2, 50000), a != wrap(1, 49999)]            \
+";
+    evaluated = test_eval(values);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[0], true));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[1], false));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[2], true));
+
+    gb_free_string(arrs);
+    gb_free_string(sums);
+    gb_free_string(body);
+    gb_free_string(calls);
+    gb_free_string(deep);
+    PASS();
+}
+
+TEST eval_test_values_are_shared(void) {
+    char input[] = "                                                      \
+let big = push(push([1, 2], 3), 4);                                       \
+let same = fn(x) { let y = x; y };                                        \
+[big, same(big), first([big]), rest(big), push(big, 5), push(big, 6), big]\
+";
+
+    obj_Object *evaluated = test_eval(input);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    obj_Object **elems = obj_arr_elems(evaluated);
+
+    // Reads and bindings don't copy
+    ASSERT_EQ(elems[0], elems[1]);
+    ASSERT_EQ(elems[0], elems[2]);
+    ASSERT_EQ(elems[0], elems[6]);
+    ASSERT_EQ(elems[0]->m_arr_buf, elems[3]->m_arr_buf);
+
+    // Neither do pushes, but what another array sees never changes
+    ASSERT_EQ(elems[0]->m_arr_buf, elems[4]->m_arr_buf);
+    ASSERT_STR_EQ("[1, 2, 3, 4]", obj_object_inspect(elems[0]));
+    ASSERT_STR_EQ("[2, 3, 4]", obj_object_inspect(elems[3]));
+    ASSERT_STR_EQ("[1, 2, 3, 4, 5]", obj_object_inspect(elems[4]));
+    ASSERT_STR_EQ("[1, 2, 3, 4, 6]", obj_object_inspect(elems[5]));
+    PASS();
+}
+
+TEST eval_test_steady_state_slab_mallocs(void) {
+    // the first run fills the size classes, later ones only reuse blocks
+    char input[] = "                                                      \
+let loop = fn(i, acc) {                                                   \
+    if (i == 0) { return acc; }                                           \
+    let pair = {\"i\": i, \"s\": \"a string longer than a word\"};            \
+    loop(i - 1, acc + len(push([pair[\"i\"]], pair[\"s\"] + \"!\")))          \
+};                                                                        \
+loop(20000, 0);                                                           \
+let before = gc_stats();                                                  \
+loop(20000, 0);                                                           \
+let after = gc_stats();                                                   \
+let grew = fn(key) { after[key] - before[key] };                          \
+[grew(\"slab_mallocs\"), grew(\"slab_allocs\") > 0]                         \
+";
+
+    gc_set_threshold(256 * 1024);
+    obj_Object *evaluated = test_eval(input);
+    gc_set_threshold(GC_DEFAULT_THRESHOLD);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[0], 0));
+    ASSERT(test_bool_obj(obj_arr_elems(evaluated)[1], true));
     PASS();
 }
 
@@ -377,7 +633,6 @@ TEST eval_test_str_lit(void) {
 
     obj_Object *evaluated = test_eval(input);
     ASSERT(test_str_obj(evaluated, "Hello World!"));
-    obj_free_object(evaluated);
     PASS();
 }
 
@@ -386,7 +641,25 @@ TEST eval_test_str_concat(void) {
 
     obj_Object *evaluated = test_eval(input);
     ASSERT(test_str_obj(evaluated, "Hello World!"));
-    obj_free_object(evaluated);
+    PASS();
+}
+
+TEST eval_test_long_str_concat(void) {
+    // doubles a string past a megabyte
+    char input[] = "                                                   \
+let grow = fn(s, n) { if (n == 0) { s } else { grow(s + s, n - 1) } }; \
+let big = grow(\"0123456789abcdef\", 16);                              \
+[len(big), len(big + \"!\"), len(grow(\"\", 20)), big + \"\" + \"!\"]  \
+";
+
+    obj_Object *evaluated = test_eval(input);
+    ASSERT_EQ(obj_ARRAY, obj_type(evaluated));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[0], 16 << 16));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[1], (16 << 16) + 1));
+    ASSERT(test_int_obj(obj_arr_elems(evaluated)[2], 0));
+    obj_Object *bang = obj_arr_elems(evaluated)[3];
+    ASSERT_EQ(obj_str(bang)[16 << 16], '!');
+    ASSERT_EQ(0, memcmp(obj_str(bang), "0123456789abcdef", 16));
     PASS();
 }
 
@@ -433,6 +706,8 @@ TEST eval_test_builtin_fn(void) {
         { "push(1, 1)",
           { TEST_STRING,
             .str = "argument to `push` must be obj_ARRAY, got obj_INTEGER" } },
+        { "gc_stats(1)",
+          { TEST_STRING, .str = "wrong number of arguments. got=1, want=0" } },
 
     };
 
@@ -456,7 +731,6 @@ TEST eval_test_builtin_fn(void) {
         } else {
             FAIL();
         }
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -466,7 +740,6 @@ TEST eval_test_arr_lit(void) {
 
     obj_Object *evaluated = test_eval(input);
     ASSERT(test_arr_obj(evaluated, 3, (int[]){ 1, 4, 6 }));
-    obj_free_object(evaluated);
     PASS();
 }
 
@@ -495,7 +768,6 @@ TEST eval_test_arr_idx_expr(void) {
         } else {
             ASSERT(test_null_obj(evaluated));
         }
-        obj_free_object(evaluated);
     }
     PASS();
 }
@@ -505,7 +777,7 @@ TEST eval_test_hash_literals(void) {
         char *input;
 
         struct {
-            obj_Object key;
+            obj_Object *key;
             int64_t expected_val;
         } expected_pairs[6];
 
@@ -523,32 +795,32 @@ TEST eval_test_hash_literals(void) {
         .expected_pairs = {
             // String key "one" -> 1
             {
-                .key = {.type = obj_STRING, .m_str = "one"},
+                .key = obj_alloc_cstr("one"),
                 .expected_val = 1
             },
             // String key "two" -> 2
             {
-                .key = {.type = obj_STRING, .m_str = "two"},
+                .key = obj_alloc_cstr("two"),
                 .expected_val = 2
             },
             // String key "three" -> 3
             {
-                .key = {.type = obj_STRING, .m_str = "three"},
+                .key = obj_alloc_cstr("three"),
                 .expected_val = 3
             },
             // Integer key 4 -> 4
             {
-                .key = {.type = obj_INTEGER, .m_int = 4},
+                .key = obj_int(4),
                 .expected_val = 4
             },
             // Boolean key true -> 5
             {
-                .key = {.type = obj_BOOLEAN, .m_bool = true},
+                .key = obj_native_bool_object(true),
                 .expected_val = 5
             },
             // Boolean key false -> 6
             {
-                .key = {.type = obj_BOOLEAN, .m_bool = false},
+                .key = obj_native_bool_object(false),
                 .expected_val = 6
             }
         },
@@ -558,29 +830,31 @@ TEST eval_test_hash_literals(void) {
     obj_Object *evaluated = test_eval(test.input);
 
     ASSERT(evaluated != NULL);
-    ASSERT(evaluated->type == obj_HASH);
+    ASSERT(obj_type(evaluated) == obj_HASH);
 
-    int actual_count = stbds_arrlen(evaluated->m_hash.hash_da);
+    int actual_count = evaluated->m_hash->len;
     ASSERT_EQ(actual_count, test.num_pairs);
 
     for (int i = 0; i < test.num_pairs; i++) {
         bool found = false;
         for (int j = 0; j < actual_count; j++) {
-            obj_Object *key = evaluated->m_hash.hash_da[j]->key;
-            obj_Object *val = evaluated->m_hash.hash_da[j]->val;
+            obj_Object *key = evaluated->m_hash->elems[j].key;
+            obj_Object *val = evaluated->m_hash->elems[j].val;
 
-            if (obj_is_same(key, &test.expected_pairs[i].key)) {
+            if (obj_is_same(key, test.expected_pairs[i].key)) {
                 found = true;
 
-                ASSERT(val->type == obj_INTEGER);
-                ASSERT_EQ(val->m_int, test.expected_pairs[i].expected_val);
+                ASSERT(obj_type(val) == obj_INTEGER);
+                ASSERT_EQ(
+                    obj_int_val(val),
+                    test.expected_pairs[i].expected_val
+                );
                 break;
             }
         }
         ASSERT(found);
     }
 
-    obj_free_object(evaluated);
     PASS();
 }
 
@@ -606,11 +880,35 @@ TEST eval_test_hash_idx_expr(void) {
         } else {
             ASSERT(test_null_obj(evaluated));
         }
-        obj_free_object(evaluated);
     }
     PASS();
 }
 
+TEST eval_test_gc(void) {
+    // collect at every safe point, values still in use must survive
+    gc_set_threshold(1);
+    char input[] = "                                                    \
+let build = fn(n, acc) {                                                    \
+    if (n == 0) { return acc; }                                             \
+    let pair = {\"n\": n, \"str\": \"n\" + \"!\"};                  \
+    build(n - 1, push(acc, [pair, fn() { pair }]));                         \
+};                                                                          \
+let xs = build(300, []);                                                    \
+let stats = gc_stats();                                                     \
+[first(xs)[0][\"n\"], last(xs)[1]()[\"n\"], len(xs),                    \
+ stats[\"threshold\"]]";
+
+    struct gc_Stats before = gc_stats();
+    obj_Object *evaluated = test_eval(input);
+    gc_set_threshold(GC_DEFAULT_THRESHOLD);
+    ASSERT(test_arr_obj(evaluated, 4, (int[]){ 300, 1, 300, 1 }));
+
+    struct gc_Stats after = gc_stats();
+    ASSERT(after.collections > before.collections);
+    ASSERT(after.freed_objects > before.freed_objects);
+    PASS();
+}
+
 SUITE(eval_suite) {
     RUN_TEST(eval_test_int_expr);
     RUN_TEST(eval_test_bool_expr);
@@ -623,12 +921,21 @@ SUITE(eval_suite) {
     RUN_TEST(eval_test_func_obj);
     RUN_TEST(eval_test_fn_appln);
     RUN_TEST(eval_test_closures);
+    RUN_TEST(eval_test_shared_env);
     RUN_TEST(eval_test_recursive_fn);
+    RUN_TEST(eval_test_mutual_recursion);
+    RUN_TEST(eval_test_tail_calls);
+    RUN_TEST(eval_test_stack_overflow);
+    RUN_TEST(eval_test_deep_nesting);
+    RUN_TEST(eval_test_values_are_shared);
+    RUN_TEST(eval_test_steady_state_slab_mallocs);
     RUN_TEST(eval_test_str_lit);
     RUN_TEST(eval_test_str_concat);
+    RUN_TEST(eval_test_long_str_concat);
     RUN_TEST(eval_test_builtin_fn);
     RUN_TEST(eval_test_arr_lit);
     RUN_TEST(eval_test_arr_idx_expr);
     RUN_TEST(eval_test_hash_literals);
     RUN_TEST(eval_test_hash_idx_expr);
+    RUN_TEST(eval_test_gc);
 }
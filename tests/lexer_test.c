@@ -1,5 +1,6 @@
 #include "greatest.h"
 
+#include "../src/builtin.c"
 #include "../src/lexer.c"
 
 SUITE(lexer_suite);
@@ -31,7 +32,10 @@ if (5 < 10) {                 \
 {\"foo\": \"bar\"}            \
 ";
 
-    struct tok_Token expected_tokens[] = {
+    struct {
+        enum tok_Type type;
+        const char *literal;
+    } expected_tokens[] = {
         { tok_LET, "let" },
         { tok_IDENT, "five" },
         { tok_ASSIGN, "=" },
@@ -132,20 +136,181 @@ if (5 < 10) {                 \
     struct lex_Lexer lexer = lex_Lexer_create(input);
 
     for (int i = 0; i < expected_tokens_len; i++) {
-        struct tok_Token expected_token = expected_tokens[i];
         struct tok_Token received_token = lex_next_token(&lexer);
 
         ASSERT_ENUM_EQ(
-            expected_token.type,
+            expected_tokens[i].type,
             received_token.type,
             tok_Token_int_enum_to_str
         );
-        ASSERT_STR_EQ(expected_token.literal, received_token.literal);
+        ASSERT_EQ((int)strlen(expected_tokens[i].literal), received_token.len);
+        ASSERT_STRN_EQ(
+            expected_tokens[i].literal,
+            lex_token_text(&lexer, received_token),
+            received_token.len
+        );
+    }
+
+    PASS();
+}
+
+TEST lexer_test_input_len(void) {
+    // only the first len chars are lexed, no NUL needed after them
+    char input[] = { 'l', 'e', 't', ' ', 'x', 'y', 'z' };
+
+    struct lex_Lexer lexer = lex_Lexer_create_len(input, 5);
+
+    struct tok_Token token = lex_next_token(&lexer);
+    ASSERT_EQ(tok_LET, token.type);
+    token = lex_next_token(&lexer);
+    ASSERT_EQ(tok_IDENT, token.type);
+    ASSERT_EQ(4, token.offset);
+    ASSERT_EQ(1, token.len);
+    ASSERT_EQ(tok_EOF, lex_next_token(&lexer).type);
+
+    // an empty buffer is just EOF
+    lexer = lex_Lexer_create_len(NULL, 0);
+    ASSERT_EQ(tok_EOF, lex_next_token(&lexer).type);
+
+    PASS();
+}
+
+TEST lexer_test_long_tokens(void) {
+    // tokens are slices of the input, their length isn't capped
+    enum { LEN = 4000 };
+    char input[2 * LEN + 8];
+    memset(input, 'a', LEN);
+    input[LEN] = ' ';
+    input[LEN + 1] = '"';
+    memset(input + LEN + 2, 'b', LEN);
+    input[2 * LEN + 2] = '"';
+
+    struct lex_Lexer lexer = lex_Lexer_create_len(input, 2 * LEN + 3);
+
+    struct tok_Token token = lex_next_token(&lexer);
+    ASSERT_EQ(tok_IDENT, token.type);
+    ASSERT_EQ(0, token.offset);
+    ASSERT_EQ(LEN, token.len);
+
+    token = lex_next_token(&lexer);
+    ASSERT_EQ(tok_STRING, token.type);
+    ASSERT_EQ(LEN + 2, token.offset);
+    ASSERT_EQ(LEN, token.len);
+    ASSERT_EQ('b', lex_token_text(&lexer, token)[LEN - 1]);
+
+    ASSERT_EQ(tok_EOF, lex_next_token(&lexer).type);
+    PASS();
+}
+
+TEST lexer_test_run_lengths(void) {
+    // runs ending at every offset in and across the scanned vectors
+    const char ident_chars[] = "aZ_q";
+    const char number_chars[] = "09x7";
+    const char space_chars[] = " \n\t\r";
+    enum { MAX_RUN = 70 };
+    char input[4 * MAX_RUN + 8];
+
+    for (int n = 1; n <= MAX_RUN; ++n) {
+        int len = 0;
+        for (int i = 0; i < n; ++i) {
+            input[len++] = space_chars[i % 4];
+        }
+        for (int i = 0; i < n; ++i) {
+            input[len++] = ident_chars[i % 4];
+        }
+        input[len++] = '+';
+        for (int i = 0; i < n; ++i) {
+            input[len++] = number_chars[i % 4];
+        }
+        input[len++] = '"';
+        for (int i = 0; i < n; ++i) {
+            input[len++] = i % 2 ? ' ' : 'A';
+        }
+        input[len++] = '"';
+
+        struct lex_Lexer lexer = lex_Lexer_create_len(input, len);
+
+        struct tok_Token token = lex_next_token(&lexer);
+        ASSERT_EQ(tok_IDENT, token.type);
+        ASSERT_EQ(n, token.offset);
+        ASSERT_EQ(n, token.len);
+        ASSERT_EQ(tok_PLUS, lex_next_token(&lexer).type);
+
+        token = lex_next_token(&lexer);
+        ASSERT_EQ(tok_INT, token.type);
+        ASSERT_EQ(n, token.len);
+
+        token = lex_next_token(&lexer);
+        ASSERT_EQ(tok_STRING, token.type);
+        ASSERT_EQ(n, token.len);
+        ASSERT_EQ(tok_EOF, lex_next_token(&lexer).type);
+
+        // an unterminated string runs to the end of the input
+        lexer = lex_Lexer_create_len(input + 3 * n + 1, n + 1);
+        token = lex_next_token(&lexer);
+        ASSERT_EQ(tok_STRING, token.type);
+        ASSERT_EQ(n, token.len);
+        ASSERT_EQ(tok_EOF, lex_next_token(&lexer).type);
+    }
+
+    // non ascii bytes end an identifier
+    char utf8[] = "abc\xc3\xa9";
+    struct lex_Lexer lexer = lex_Lexer_create(utf8);
+    ASSERT_EQ(3, lex_next_token(&lexer).len);
+    ASSERT_EQ(tok_ILLEGAL, lex_next_token(&lexer).type);
+
+    PASS();
+}
+
+TEST lexer_test_keywords(void) {
+    struct {
+        const char *text;
+        enum tok_Type type;
+    } words[] = {
+        { "let", tok_LET },       { "fn", tok_FUNCTION },
+        { "true", tok_TRUE },     { "false", tok_FALSE },
+        { "if", tok_IF },         { "else", tok_ELSE },
+        { "return", tok_RETURN }, { "lets", tok_IDENT },
+        { "f", tok_IDENT },       { "iff", tok_IDENT },
+        { "Let", tok_IDENT },     { "elsa", tok_IDENT },
+        { "returns", tok_IDENT }, { "len", tok_IDENT },
+    };
+
+    for (int i = 0; i < (int)(sizeof(words) / sizeof(words[0])); ++i) {
+        ASSERT_ENUM_EQ(
+            words[i].type,
+            tok_lookup_identifier(words[i].text, strlen(words[i].text)),
+            tok_Token_int_enum_to_str
+        );
     }
+    PASS();
+}
 
+TEST lexer_test_word_tables(void) {
+    // a first or last char spelled wrong puts a word where it's never found
+    const struct tok_Word *tables[] = { tok_keywords, builtin_words };
+    for (int t = 0; t < 2; ++t) {
+        for (int i = 0; i < TOK_WORD_SLOTS; ++i) {
+            const struct tok_Word *word = &tables[t][i];
+            if (word->text == NULL) {
+                continue;
+            }
+            ASSERT_EQ((int)strlen(word->text), word->len);
+            ASSERT_EQ_FMT(
+                word->val,
+                tok_lookup_word(tables[t], word->text, word->len, -1),
+                "%d"
+            );
+        }
+    }
     PASS();
 }
 
 SUITE(lexer_suite) {
     RUN_TEST(lexer_test_next_token);
+    RUN_TEST(lexer_test_input_len);
+    RUN_TEST(lexer_test_long_tokens);
+    RUN_TEST(lexer_test_run_lengths);
+    RUN_TEST(lexer_test_keywords);
+    RUN_TEST(lexer_test_word_tables);
 }
@@ -1,23 +1,75 @@
 #include "greatest.h"
 
+#include "../src/gc.c"
 #include "../src/object.c"
 
+#include <limits.h>
+
 SUITE(obj_suite);
 
 TEST test_string_is_same(void) {
     // Create test strings
-    obj_Object hello1 = { .type = obj_STRING, .m_str = "Hello World" };
-    obj_Object hello2 = { .type = obj_STRING, .m_str = "Hello World" };
-    obj_Object diff1 = { .type = obj_STRING, .m_str = "My name is johnny" };
-    obj_Object diff2 = { .type = obj_STRING, .m_str = "My name is johnny" };
+    obj_Object *hello1 = obj_alloc_cstr("Hello World");
+    obj_Object *hello2 = obj_alloc_cstr("Hello World");
+    obj_Object *diff1 = obj_alloc_cstr("My name is johnny");
+    obj_Object *diff2 = obj_alloc_cstr("My name is johnny");
+    obj_Object *small1 = obj_alloc_cstr("Hi");
+    obj_Object *small2 = obj_alloc_str("Hi there", 2);
 
     // Same content strings should be equal
-    ASSERT(obj_is_same(&hello1, &hello2));
-    ASSERT(obj_is_same(&diff1, &diff2));
+    ASSERT(obj_is_same(hello1, hello2));
+    ASSERT(obj_is_same(diff1, diff2));
+    ASSERT(obj_is_same(small1, small2));
 
     // Different content strings should not be equal
-    ASSERT_FALSE(obj_is_same(&hello1, &diff1));
+    ASSERT_FALSE(obj_is_same(hello1, diff1));
+    ASSERT_FALSE(obj_is_same(small1, hello1));
+
+    // Strings aren't cut at a NUL
+    obj_Object *nul1 = obj_alloc_str("a\0b", 3);
+    obj_Object *nul2 = obj_alloc_str("a\0c", 3);
+    ASSERT_FALSE(obj_is_same(nul1, nul2));
+
+    PASS();
+}
+
+TEST test_object_size(void) {
+    // A header and two words
+    ASSERT(sizeof(obj_Object) <= 4 * sizeof(void *));
 
+    // Short strings don't allocate their chars
+    obj_Object *small = obj_alloc_cstr("short");
+    ASSERT_EQ(obj_str(small), small->m_str_small);
+    ASSERT_EQ(obj_str_len(small), 5);
+
+    obj_Object *big = obj_alloc_str(NULL, 1 << 20);
+    memset(obj_str(big), 'x', obj_str_len(big));
+    ASSERT_EQ(obj_str(big), big->m_str_buf->chars);
+    PASS();
+}
+
+TEST test_str_concat(void) {
+    obj_Object *piece = obj_alloc_cstr("0123456789");
+    obj_Object *acc = obj_alloc_cstr("");
+    for (int i = 0; i < 1000; ++i) {
+        acc = obj_str_concat(acc, piece);
+    }
+    ASSERT_EQ(obj_str_len(acc), 10000);
+    ASSERT_EQ(0, memcmp("0123456789", obj_str(acc) + 9990, 10));
+
+    // Appending in place leaves earlier strings as they were
+    obj_Object *a = obj_str_concat(acc, obj_alloc_cstr("a"));
+    obj_Object *b = obj_str_concat(acc, obj_alloc_cstr("b"));
+    ASSERT_EQ(a->m_str_buf, acc->m_str_buf);
+    ASSERT(b->m_str_buf != acc->m_str_buf);
+    ASSERT_EQ(obj_str_len(acc), 10000);
+    ASSERT_EQ(obj_str(a)[10000], 'a');
+    ASSERT_EQ(obj_str(b)[10000], 'b');
+
+    // Also when a string is appended to itself
+    obj_Object *twice = obj_str_concat(a, a);
+    ASSERT_EQ(obj_str_len(twice), 20002);
+    ASSERT_EQ(0, memcmp(obj_str(a), obj_str(twice) + 10001, 10001));
     PASS();
 }
 
@@ -55,11 +107,29 @@ TEST test_integer_is_same(void) {
     PASS();
 }
 
+TEST test_immediate_integer(void) {
+    int vals[] = { 0, 1, -1, 42, -1000000, INT_MAX, INT_MIN };
+    for (size_t i = 0; i < sizeof(vals) / sizeof(vals[0]); ++i) {
+        obj_Object *obj = obj_int(vals[i]);
+        ASSERT_EQ(obj_type(obj), obj_INTEGER);
+        ASSERT_EQ(obj_int_val(obj), vals[i]);
+    }
+
+    // Immediates compare by value, also against boxed integers
+    obj_Object boxed = { .type = obj_INTEGER, .m_int = 7 };
+    ASSERT(obj_is_same(obj_int(7), obj_int(7)));
+    ASSERT(obj_is_same(obj_int(7), &boxed));
+    ASSERT_FALSE(obj_is_same(obj_int(7), obj_int(8)));
+    ASSERT_FALSE(obj_is_same(obj_int(1), obj_native_bool_object(true)));
+
+    PASS();
+}
+
 TEST test_array_is_same(void) {
-    // Initialize arrays as NULL
-    obj_Object **arr1_elements = NULL;
-    obj_Object **arr2_elements = NULL;
-    obj_Object **arr3_elements = NULL;
+    // Start from empty arrays
+    obj_Object *arr1 = obj_alloc_object(obj_ARRAY);
+    obj_Object *arr2 = obj_alloc_object(obj_ARRAY);
+    obj_Object *arr3 = obj_alloc_object(obj_ARRAY);
 
     // Create test values
     obj_Object *val1 = &(obj_Object){ .type = obj_INTEGER, .m_int = 1 };
@@ -68,32 +138,151 @@ TEST test_array_is_same(void) {
     obj_Object *val4 = &(obj_Object){ .type = obj_INTEGER, .m_int = 4 };
 
     // Build first two identical arrays
-    stbds_arrput(arr1_elements, val1);
-    stbds_arrput(arr1_elements, val2);
-
-    stbds_arrput(arr2_elements, val1);
-    stbds_arrput(arr2_elements, val2);
+    arr1 = obj_arr_push(obj_arr_push(arr1, val1), val2);
+    arr2 = obj_arr_push(obj_arr_push(arr2, val1), val2);
 
     // Build third array with different values
-    stbds_arrput(arr3_elements, val3);
-    stbds_arrput(arr3_elements, val4);
-
-    // Create array objects
-    obj_Object arr1 = { .type = obj_ARRAY, .m_arr_da = arr1_elements };
-    obj_Object arr2 = { .type = obj_ARRAY, .m_arr_da = arr2_elements };
-    obj_Object arr3 = { .type = obj_ARRAY, .m_arr_da = arr3_elements };
+    arr3 = obj_arr_push(obj_arr_push(arr3, val3), val4);
 
     // Same content arrays should be equal
-    ASSERT(obj_is_same(&arr1, &arr2));
+    ASSERT(obj_is_same(arr1, arr2));
+    ASSERT(obj_is_same(arr1, obj_alloc_arr(obj_arr_elems(arr2), 2)));
 
     // Different content arrays should not be equal
-    ASSERT_FALSE(obj_is_same(&arr1, &arr3));
+    ASSERT_FALSE(obj_is_same(arr1, arr3));
+    ASSERT_FALSE(obj_is_same(arr1, obj_arr_rest(arr1)));
+
+    PASS();
+}
+
+TEST test_deep_nesting(void) {
+    // Nested far deeper than the c stack could recurse
+    int depth = 1000000;
+    obj_Object *a = obj_int(1);
+    obj_Object *b = obj_int(1);
+    obj_Object *c = obj_int(2);
+    for (int i = 0; i < depth; ++i) {
+        a = obj_alloc_arr(&a, 1);
+        b = obj_alloc_arr(&b, 1);
+        c = obj_alloc_arr(&c, 1);
+    }
+
+    ASSERT(obj_is_same(a, b));
+    ASSERT_FALSE(obj_is_same(a, c));
+
+    gbString str = obj_object_inspect(a);
+    ASSERT_EQ(2 * depth + 1, (int)gb_string_length(str));
+    ASSERT_EQ(0, strncmp(str, "[[[", 3));
+    ASSERT_EQ(0, strncmp(str + depth - 1, "[1]]", 4));
+    gb_free_string(str);
+    PASS();
+}
+
+TEST test_array_push_rest(void) {
+    obj_Object *arr = obj_alloc_object(obj_ARRAY);
+    for (int i = 0; i < 1000; ++i) {
+        arr = obj_arr_push(arr, obj_int(i));
+    }
+    ASSERT_EQ(obj_arr_len(arr), 1000);
+
+    // Pushing in place leaves earlier arrays as they were
+    obj_Object *a = obj_arr_push(arr, obj_int(-1));
+    obj_Object *b = obj_arr_push(arr, obj_int(-2));
+    ASSERT_EQ(a->m_arr_buf, arr->m_arr_buf);
+    ASSERT(b->m_arr_buf != arr->m_arr_buf);
+    ASSERT_EQ(obj_arr_len(arr), 1000);
+    ASSERT_EQ(obj_int_val(obj_arr_elems(a)[1000]), -1);
+    ASSERT_EQ(obj_int_val(obj_arr_elems(b)[1000]), -2);
 
-    // Free the arrays
-    stbds_arrfree(arr1_elements);
-    stbds_arrfree(arr2_elements);
-    stbds_arrfree(arr3_elements);
+    // Rests share the elems, pushing to them doesn't touch the rest
+    obj_Object *rest = arr;
+    for (int i = 0; i < 999; ++i) {
+        rest = obj_arr_rest(rest);
+    }
+    ASSERT_EQ(rest->m_arr_buf, arr->m_arr_buf);
+    ASSERT_EQ(obj_arr_len(rest), 1);
+    ASSERT_EQ(obj_int_val(obj_arr_elems(rest)[0]), 999);
+    obj_Object *pushed = obj_arr_push(obj_arr_rest(rest), obj_int(7));
+    ASSERT_EQ(obj_arr_len(pushed), 1);
+    ASSERT_EQ(obj_int_val(obj_arr_elems(a)[1000]), -1);
+    ASSERT_EQ(obj_arr_len(obj_arr_rest(rest)), 0);
+    PASS();
+}
+
+TEST test_hash_put_get(void) {
+    obj_Object *hash = obj_alloc_object(obj_HASH);
+    int n = 100000;
+    for (int i = 0; i < n; ++i) {
+        obj_hash_put(hash, obj_int(i), obj_int(i * 2));
+    }
+    obj_Object *str = obj_alloc_cstr("key");
+    obj_hash_put(hash, str, obj_native_bool_object(true));
+    obj_hash_put(hash, obj_native_bool_object(false), obj_int(-1));
+
+    ASSERT_EQ(hash->m_hash->len, n + 2);
+    for (int i = 0; i < n; ++i) {
+        ASSERT(obj_is_same(obj_hash_get(hash, obj_int(i)), obj_int(i * 2)));
+    }
+    obj_Object *key = obj_alloc_cstr("key");
+    ASSERT_EQ(obj_hash_get(hash, key), obj_native_bool_object(true));
+    ASSERT_EQ(obj_hash_key(key), obj_hash_key(str));
+    ASSERT(obj_is_same(
+        obj_hash_get(hash, obj_native_bool_object(false)),
+        obj_int(-1)
+    ));
+    ASSERT_EQ(obj_hash_get(hash, obj_int(n)), NULL);
+    ASSERT_EQ(obj_hash_get(hash, obj_native_bool_object(true)), NULL);
+
+    // Putting an existing key replaces its value in place
+    obj_hash_put(hash, obj_int(7), obj_int(0));
+    ASSERT_EQ(hash->m_hash->len, n + 2);
+    ASSERT(obj_is_same(obj_hash_get(hash, obj_int(7)), obj_int(0)));
+
+    PASS();
+}
+
+TEST test_hash_str_keys(void) {
+    obj_Object *hash = obj_alloc_object(obj_HASH);
+    obj_Object *lit = obj_alloc_interned_str(util_intern("firstName", 9), 9);
+    obj_Object *built = obj_str_concat(
+        obj_alloc_cstr("first"),
+        obj_alloc_cstr("Name")
+    );
+    obj_hash_put(hash, built, obj_int(1));
+
+    // Keys made at run time aren't interned, they're found by their chars
+    ASSERT_FALSE(built->interned);
+    ASSERT(obj_is_same(obj_hash_get(hash, lit), obj_int(1)));
+    obj_Object *lookup = obj_alloc_cstr("firstName");
+    ASSERT(obj_is_same(obj_hash_get(hash, lookup), obj_int(1)));
+
+    // Interned keys are found by ptr
+    obj_hash_put(hash, lit, obj_int(3));
+    ASSERT_EQ(hash->m_hash->len, 1);
+    ASSERT(obj_is_same(obj_hash_get(hash, built), obj_int(3)));
+    obj_Object *other = obj_alloc_interned_str(util_intern("firstName", 9), 9);
+    ASSERT_EQ(obj_str(other), obj_str(lit));
+    ASSERT(obj_is_same(obj_hash_get(hash, other), obj_int(3)));
+
+    obj_hash_put(hash, obj_alloc_cstr("lastName"), obj_int(2));
+    ASSERT_EQ(obj_hash_get(hash, obj_alloc_cstr("lastNames")), NULL);
+    ASSERT_EQ(hash->m_hash->len, 2);
+    PASS();
+}
+
+TEST test_hash_is_same(void) {
+    obj_Object *a = obj_alloc_object(obj_HASH);
+    obj_Object *b = obj_alloc_object(obj_HASH);
+    obj_Object *c = obj_alloc_object(obj_HASH);
+    for (int i = 0; i < 100; ++i) {
+        obj_hash_put(a, obj_int(i), obj_int(i));
+        obj_hash_put(b, obj_int(99 - i), obj_int(99 - i));
+        obj_hash_put(c, obj_int(i), obj_int(i + 1));
+    }
 
+    // Insertion order doesn't matter, values do
+    ASSERT(obj_is_same(a, b));
+    ASSERT_FALSE(obj_is_same(a, c));
     PASS();
 }
 
@@ -112,10 +301,84 @@ TEST test_null_and_type_comparison(void) {
     PASS();
 }
 
+TEST test_gc_collect(void) {
+    int roots = gc_save_roots();
+    struct gc_Stats before = gc_stats();
+
+    obj_Object *str = obj_alloc_cstr("kept");
+    obj_Object *arr = obj_arr_push(obj_alloc_object(obj_ARRAY), str);
+    obj_Env *env = obj_alloc_enclosed_env(NULL, 1);
+    obj_env_set(env, 0, arr);
+    gc_push_env_root(env);
+
+    // Unreachable objects and cycles of them are swept
+    for (int i = 0; i < 100; ++i) {
+        obj_alloc_cstr("a string too long to be kept inline");
+    }
+    obj_Object *cycle = obj_alloc_arr(NULL, 1);
+    obj_arr_elems(cycle)[0] = cycle;
+
+    gc_collect();
+    struct gc_Stats after = gc_stats();
+    ASSERT_EQ(after.collections, before.collections + 1);
+    ASSERT(after.freed_objects - before.freed_objects >= 101);
+    ASSERT(after.heap_bytes > 0);
+
+    // Reachable ones survive, also through a later collection
+    gc_collect();
+    ASSERT_EQ(obj_env_get(env, 0, 0), arr);
+    ASSERT_STR_EQ("kept", obj_str(obj_arr_elems(arr)[0]));
+
+    gc_restore_roots(roots);
+    PASS();
+}
+
+TEST test_gc_buffer_bytes(void) {
+    int roots = gc_save_roots();
+    gc_collect();
+    struct gc_Stats before = gc_stats();
+
+    // Strings and arrays appended in place share one buffer
+    obj_Object *str = obj_alloc_cstr("a longer string");
+    obj_Object *arr = obj_alloc_object(obj_ARRAY);
+    for (int i = 0; i < 10; ++i) {
+        str = obj_str_concat(str, obj_alloc_cstr(" and more"));
+        arr = obj_arr_push(arr, str);
+    }
+    gc_push_root(arr);
+
+    // the last ones keep the buffers, whichever are swept first
+    gc_collect();
+    struct gc_Stats kept = gc_stats();
+    gc_collect();
+    ASSERT_EQ(kept.heap_bytes, gc_stats().heap_bytes);
+
+    // every byte counted when allocated is counted once when freed
+    gc_restore_roots(roots);
+    gc_collect();
+    struct gc_Stats after = gc_stats();
+    ASSERT_EQ(before.heap_bytes, after.heap_bytes);
+    ASSERT_EQ(
+        kept.heap_bytes - before.heap_bytes,
+        after.freed_bytes - kept.freed_bytes
+    );
+    PASS();
+}
+
 SUITE(obj_suite) {
     RUN_TEST(test_string_is_same);
+    RUN_TEST(test_object_size);
+    RUN_TEST(test_str_concat);
     RUN_TEST(test_boolean_is_same);
     RUN_TEST(test_integer_is_same);
+    RUN_TEST(test_immediate_integer);
     RUN_TEST(test_array_is_same);
+    RUN_TEST(test_deep_nesting);
+    RUN_TEST(test_array_push_rest);
+    RUN_TEST(test_hash_put_get);
+    RUN_TEST(test_hash_str_keys);
+    RUN_TEST(test_hash_is_same);
+    RUN_TEST(test_gc_collect);
+    RUN_TEST(test_gc_buffer_bytes);
     RUN_TEST(test_null_and_type_comparison);
 }
@@ -0,0 +1,97 @@
+#pragma once
+#include "greatest.h"
+
+#include "../src/optimizer.c"
+#include "../src/parser.c"
+#include "eval_test.c"
+
+SUITE(optimizer_suite);
+
+TEST optimizer_test_program_str(void) {
+    struct {
+        char *input;
+        char *expected;
+        int optimized;
+    } tests[] = {
+        { "2 * 60 * 60", "7200", 2 },
+        { "-(4 / 2) + 1", "-1", 3 },
+        { "!5; !!false; true != false", "falsefalsetrue", 4 },
+        { "\"foo\" + \"bar\" + \"baz\"", "foobarbaz", 2 },
+        { "1 < 2 == true", "true", 2 },
+        { "fn(x) { x * (3 - 1) }", "fn(x) (x * 2)", 1 },
+        { "if (1 > 2) { 10 } else { 20 }", "20", 2 },
+        { "if (true) { 10 } else { 20 }", "10", 1 },
+        { "if (false) { 10 }", "null", 1 },
+        { "if (x) { 1 + 1 } else { 2 }", "ifx 2else 2", 1 },
+        { "[if (0) { 1 }, if (!true) { 1 }]", "[1, null]", 3 },
+        { "if (true) { 1; 2 }; 3", "123", 1 },
+        { "if (false) { 1 } else { let a = 2; }; a", "let a = 2;a", 1 },
+        { "fn() { if (true) { 1; 2 } }", "fn() 12", 1 },
+        // the value of the last statement would change
+        { "if (true) { let a = 2; }", "iftrue let a = 2;", 0 },
+        // errors and overflows are left to the evaluator
+        { "1 + true", "(1 + true)", 0 },
+        { "-true", "(-true)", 0 },
+        { "5 / 0", "(5 / 0)", 0 },
+        { "2147483647 + 1", "(2147483647 + 1)", 0 },
+        { "true < false", "(true < false)", 0 },
+        { "\"a\" == \"a\"", "(a == a)", 0 },
+        { "1 == true", "(1 == true)", 0 },
+    };
+    int n = sizeof(tests) / sizeof(tests[0]);
+
+    for (int i = 0; i < n; ++i) {
+        struct lex_Lexer lexer = lex_Lexer_create(tests[i].input);
+        struct par_Parser *parser = par_alloc_parser(&lexer);
+        struct ast_Program *program = ast_alloc_program();
+        par_parse_program(parser, program);
+        ASSERT_EQ(0, stbds_arrlen(parser->errors_da));
+
+        ASSERT_EQ(tests[i].optimized, opt_optimize_program(program));
+        gbString received = ast_make_program_str(program);
+        ASSERT_STR_EQ(tests[i].expected, received);
+
+        gb_free_string(received);
+        par_free_parser(parser);
+        ast_free_program(program);
+    }
+    PASS();
+}
+
+TEST optimizer_test_errors(void) {
+    // the same error as without folding
+    struct {
+        char *input;
+        char *expected;
+    } tests[] = {
+        { "2 * 3 + true", "type mismatch: obj_INTEGER + obj_BOOLEAN" },
+        { "-(1 == 1)", "unknown operator: -obj_BOOLEAN" },
+        { "\"a\" - \"b\"", "unknown operator: obj_STRING - obj_STRING" },
+        {
+            "if (true) { true + false; 1 } else { 2 }",
+            "unknown operator: obj_BOOLEAN + obj_BOOLEAN",
+        },
+    };
+    int n = sizeof(tests) / sizeof(tests[0]);
+
+    TEST_ENGINE = test_ENGINE_OPTIMIZED;
+    for (int i = 0; i < n; ++i) {
+        obj_Object *evaluated = test_eval(tests[i].input);
+        ASSERT_EQ(obj_ERROR, obj_type(evaluated));
+        ASSERT_STR_EQ(tests[i].expected, evaluated->m_err_msg);
+    }
+    TEST_ENGINE = test_ENGINE_EVAL;
+    PASS();
+}
+
+SUITE(optimizer_suite) {
+    RUN_TEST(optimizer_test_program_str);
+    RUN_TEST(optimizer_test_errors);
+}
+
+// the whole eval suite, on optimized programs
+SUITE(eval_optimized_suite) {
+    TEST_ENGINE = test_ENGINE_OPTIMIZED;
+    eval_suite();
+    TEST_ENGINE = test_ENGINE_EVAL;
+}
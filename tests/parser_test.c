@@ -9,7 +9,7 @@ bool test_identifier(struct ast_Expr *ident, const char *val) {
     assert(ident != NULL);
     assert(ident->tag == ast_IDENT_EXPR);
     assert(strcmp(ident->data.ident.value, val) == 0);
-    assert(strcmp(ident->token.literal, val) == 0);
+    assert(ident->data.ident.value == util_intern(val, strlen(val)));
     return true;
 }
 
@@ -21,10 +21,10 @@ bool test_int_literal(struct ast_Expr *il_expr, int val) {
 
     char str[32]; // for max_int
     sprintf(str, "%d", val);
-    if (strcmp(str, il_expr->token.literal) != 0) {
-        return false;
-    }
-    return true;
+    gbString lit_str = ast_make_expr_str(il_expr);
+    bool same = strcmp(str, lit_str) == 0;
+    gb_free_string(lit_str);
+    return same;
 }
 
 bool test_str_literal(struct ast_Expr *str_expr, char *val) {
@@ -32,10 +32,6 @@ bool test_str_literal(struct ast_Expr *str_expr, char *val) {
     if (strcmp(val, str_expr->data.str.value) != 0) {
         return false;
     }
-
-    if (strcmp(val, str_expr->token.literal) != 0) {
-        return false;
-    }
     return true;
 }
 
@@ -43,7 +39,9 @@ bool test_bool_literal(struct ast_Expr *bool_expr, bool val) {
     assert(bool_expr != NULL);
     assert(bool_expr->tag == ast_BOOL_EXPR);
     assert(bool_expr->data.boolean.value == val);
-    assert(strcmp(bool_expr->token.literal, (val ? "true" : "false")) == 0);
+    gbString lit_str = ast_make_expr_str(bool_expr);
+    assert(strcmp(lit_str, (val ? "true" : "false")) == 0);
+    gb_free_string(lit_str);
     return true;
 }
 
@@ -69,7 +67,7 @@ bool test_infix_expr(
 ) {
     assert(inf_expr->tag == ast_INFIX_EXPR);
     assert(test_lit_expr(inf_expr->data.inf.left, left));
-    assert(strcmp(inf_expr->data.inf.operator, operator) == 0);
+    assert(strcmp(ast_operator_str(inf_expr->data.inf.op), operator) == 0);
     assert(test_lit_expr(inf_expr->data.inf.right, right));
     return true;
 }
@@ -78,16 +76,11 @@ bool test_let_statement(struct ast_Stmt *let_stmt, const char *name) {
     assert(let_stmt != NULL);
     assert(let_stmt->tag == ast_LET_STMT);
 
-    assert(0 == strcmp(let_stmt->token.literal, "let"));
-    assert(let_stmt->token.type == tok_LET);
-
     struct ast_Expr *let_ident = let_stmt->data.let.name;
     assert(let_ident->tag == ast_IDENT_EXPR);
 
     assert(0 == strcmp(let_ident->data.ident.value, name));
-
-    assert(0 == strcmp(let_ident->token.literal, name));
-    assert(let_ident->token.type == tok_IDENT);
+    assert(let_ident->data.ident.value == util_intern(name, strlen(name)));
 
     return true;
 }
@@ -165,7 +158,7 @@ return 993322;\
         struct ast_Stmt *stmt = program->statement_ptrs_da[i];
         ASSERT(stmt != NULL);
         ASSERT(stmt->tag == ast_RET_STMT);
-        ASSERT_STR_EQ("return", stmt->token.literal);
+        ASSERT_EQ(0, strncmp("return ", ast_make_stmt_str(stmt), 7));
     }
 
     par_free_parser(parser);
@@ -198,7 +191,7 @@ TEST parser_test_identifier_expression(void) {
     ASSERT(ident_expr != NULL);
     ASSERT(ident_expr->tag == ast_IDENT_EXPR);
     ASSERT_STR_EQ("foobar", ident_expr->data.ident.value);
-    ASSERT_STR_EQ("foobar", ident_expr->token.literal);
+    ASSERT_EQ(util_intern("foobar", 6), ident_expr->data.ident.value);
 
     par_free_parser(parser);
     ast_free_program(program);
@@ -226,7 +219,7 @@ TEST parser_test_int_literal_expression(void) {
     ASSERT(int_lit_expr != NULL);
     ASSERT(int_lit_expr->tag == ast_INT_LIT_EXPR);
     ASSERT_EQ_FMT(5, int_lit_expr->data.int_lit.value, "%d");
-    ASSERT_STR_EQ("5", int_lit_expr->token.literal);
+    ASSERT_STR_EQ("5", ast_make_expr_str(int_lit_expr));
 
     PASS();
 }
@@ -264,7 +257,10 @@ TEST parser_test_prefix_expressions(void) {
         struct ast_Expr *prefix_expr = stmt->data.expr.expr;
         ASSERT(prefix_expr != NULL);
         ASSERT(prefix_expr->tag == ast_PREFIX_EXPR);
-        ASSERT_STR_EQ(prefix_tests[i].operator, prefix_expr->data.pf.operator);
+        ASSERT_STR_EQ(
+            prefix_tests[i].operator,
+            ast_operator_str(prefix_expr->data.pf.op)
+        );
         ASSERT(test_lit_expr(prefix_expr->data.pf.right, prefix_tests[i].val));
 
         par_free_parser(parser);
@@ -850,6 +846,118 @@ TEST parser_test_hash_lit_with_expressions(void) {
     PASS();
 }
 
+TEST parser_test_token_array(void) {
+    char input[] = "let add = fn(a, b) { a + b; };\n"
+                   "let xs = [1, add(2, 3) * 4, {\"k\": !true}[\"k\"]];\n"
+                   "if (xs[0] < 2) { return -xs[1]; } else { \"no\" }";
+
+    struct lex_Lexer stream_lexer = lex_Lexer_create(input);
+    struct par_Parser *stream_parser = par_alloc_parser(&stream_lexer);
+    struct ast_Program *stream_program = ast_alloc_program();
+    par_parse_program(stream_parser, stream_program);
+    ASSERT(check_parser_errors(stream_parser) == false);
+
+    // the same tree as streaming from the lexer
+    struct lex_Lexer lexer = lex_Lexer_create(input);
+    struct par_Parser *parser = par_alloc_token_parser(&lexer);
+    ASSERT_EQ(tok_LET, par_lookahead(parser, 0).type);
+    ASSERT_EQ(tok_FUNCTION, par_lookahead(parser, 3).type);
+
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+    ASSERT(check_parser_errors(parser) == false);
+    ASSERT_EQ(tok_EOF, par_lookahead(parser, 0).type);
+    ASSERT_EQ(tok_EOF, par_lookahead(parser, 5).type);
+
+    gbString expected = ast_make_program_str(stream_program);
+    gbString received = ast_make_program_str(program);
+    ASSERT_STR_EQ(expected, received);
+
+    gb_free_string(expected);
+    gb_free_string(received);
+    par_free_parser(stream_parser);
+    par_free_parser(parser);
+    ast_free_program(stream_program);
+    ast_free_program(program);
+    PASS();
+}
+
+// open n times, then mid, then close n times
+char *parser_test_nest(char *open, char *mid, char *close, int n) {
+    size_t open_len = strlen(open);
+    size_t mid_len = strlen(mid);
+    size_t close_len = strlen(close);
+    char *str = malloc(n * (open_len + close_len) + mid_len + 1);
+    char *end = str;
+    for (int i = 0; i < n; ++i, end += open_len) {
+        memcpy(end, open, open_len);
+    }
+    memcpy(end, mid, mid_len);
+    end += mid_len;
+    for (int i = 0; i < n; ++i, end += close_len) {
+        memcpy(end, close, close_len);
+    }
+    *end = '\0';
+    return str;
+}
+
+TEST parser_test_nesting_depth(void) {
+    struct {
+        char *open;
+        char *mid;
+        char *close;
+    } tests[] = {
+        { "(", "1", ")" },
+        { "[", "1", "]" },
+        { "-", "1", "" },
+        { "1 + ", "1", "" },
+        { "", "f", "(1)" },
+        { "if (true) { ", "1", " }" },
+        { "fn() { ", "1", " }" },
+        { "{1: ", "1", "}" },
+    };
+    int n_tests = sizeof(tests) / sizeof(tests[0]);
+    char too_deep[64];
+    sprintf(too_deep, "Expression nested deeper than %d", PAR_MAX_DEPTH);
+    struct par_Parser *(*alloc_parser[])(struct lex_Lexer *) = {
+        par_alloc_parser,
+        par_alloc_token_parser,
+    };
+
+    for (int i = 0; i < n_tests; ++i) {
+        for (int k = 0; k < 2; ++k) {
+            // deep but in the limit parses, far past it is one error
+            int depths[] = { PAR_MAX_DEPTH / 4, 100000 };
+            for (int j = 0; j < 2; ++j) {
+                char *input = parser_test_nest(
+                    tests[i].open,
+                    tests[i].mid,
+                    tests[i].close,
+                    depths[j]
+                );
+                struct lex_Lexer lexer = lex_Lexer_create(input);
+                struct par_Parser *parser = alloc_parser[k](&lexer);
+                struct ast_Program *program = ast_alloc_program();
+                par_parse_program(parser, program);
+
+                char **errors_da = par_parser_errors(parser);
+                if (j == 0) {
+                    ASSERT(check_parser_errors(parser) == false);
+                    ASSERT_EQ(1, stbds_arrlen(program->statement_ptrs_da));
+                } else {
+                    ASSERT_EQ(1, stbds_arrlen(errors_da));
+                    ASSERT_STR_EQ(too_deep, errors_da[0]);
+                }
+
+                par_free_parser(parser);
+                ast_free_program(program);
+                free(input);
+            }
+        }
+    }
+    PASS();
+}
+
 SUITE(parser_suite) {
     RUN_TEST(parser_test_let_statement);
     RUN_TEST(parser_test_ret_statement);
@@ -870,4 +978,6 @@ SUITE(parser_suite) {
     RUN_TEST(parser_test_hash_lit_empty);
     RUN_TEST(parser_test_hash_lit_with_int_keys);
     RUN_TEST(parser_test_hash_lit_with_expressions);
+    RUN_TEST(parser_test_token_array);
+    RUN_TEST(parser_test_nesting_depth);
 }
@@ -0,0 +1,207 @@
+#include "greatest.h"
+
+#include "../src/parser.c"
+#include "../src/resolver.c"
+
+SUITE(resolver_suite);
+
+struct ast_Program *test_parse(char *input) {
+    struct lex_Lexer lexer = lex_Lexer_create(input);
+    struct par_Parser *parser = par_alloc_parser(&lexer);
+    struct ast_Program *program = ast_alloc_program();
+    par_parse_program(parser, program);
+    assert(stbds_arrlen(parser->errors_da) == 0);
+    par_free_parser(parser);
+    return program;
+}
+
+// idents of a left-leaning infix chain, in source order
+void test_infix_idents(struct ast_Expr *expr, struct ast_Ident ***idents_da) {
+    if (expr->tag == ast_INFIX_EXPR) {
+        test_infix_idents(expr->data.inf.left, idents_da);
+        test_infix_idents(expr->data.inf.right, idents_da);
+        return;
+    }
+    assert(expr->tag == ast_IDENT_EXPR);
+    stbds_arrput(*idents_da, &expr->data.ident);
+}
+
+TEST resolver_test_addresses(void) {
+    char *input = "let a = 1;"
+                  "let f = fn(x) {"
+                  "    let y = x;"
+                  "    fn(z) { a + x + y + z + len }"
+                  "};";
+    struct ast_Program *program = test_parse(input);
+
+    struct res_Scope *globals = res_alloc_scope(NULL);
+    struct res_Resolver *resolver = res_alloc_resolver(globals);
+    res_resolve_program(resolver, program);
+    ASSERT_EQ(0, stbds_arrlen(resolver->errors_da));
+
+    struct ast_Stmt **stmts = program->statement_ptrs_da;
+    ASSERT_EQ(0, stmts[0]->data.let.name->data.ident.slot);
+    ASSERT_EQ(1, stmts[1]->data.let.name->data.ident.slot);
+
+    struct ast_Expr *outer = stmts[1]->data.let.value;
+    ASSERT_EQ(2, outer->data.fn_lit.num_slots);
+
+    struct ast_Stmt **body = outer->data.fn_lit.body->data.block.stmts_da;
+    struct ast_Expr *inner = body[1]->data.expr.expr;
+    ASSERT_EQ(1, inner->data.fn_lit.num_slots);
+
+    struct ast_Ident **idents_da = NULL;
+    struct ast_Stmt *inner_body = inner->data.fn_lit.body;
+    test_infix_idents(
+        inner_body->data.block.stmts_da[0]->data.expr.expr,
+        &idents_da
+    );
+
+    struct {
+        int depth;
+        int slot;
+    } expected[] = {
+        { 2, 0 }, // a
+        { 1, 0 }, // x
+        { 1, 1 }, // y
+        { 0, 0 }, // z
+        { AST_IDENT_BUILTIN, BUILTIN_LEN }, // len
+    };
+    int n = sizeof(expected) / sizeof(expected[0]);
+    ASSERT_EQ(n, stbds_arrlen(idents_da));
+    for (int i = 0; i < n; ++i) {
+        ASSERT_EQ(expected[i].depth, idents_da[i]->depth);
+        ASSERT_EQ(expected[i].slot, idents_da[i]->slot);
+    }
+
+    stbds_arrfree(idents_da);
+    res_free_resolver(resolver);
+    res_free_scope(globals);
+    ast_free_program(program);
+    PASS();
+}
+
+TEST resolver_test_globals(void) {
+    struct res_Scope *globals = res_alloc_scope(NULL);
+
+    // globals persist across programs like repl lines, redefining keeps slot
+    char *inputs[] = {
+        "let a = 1; let b = 2;",
+        "let c = a; let a = 3;",
+    };
+    int expected_slots[][2] = { { 0, 1 }, { 2, 0 } };
+    for (int i = 0; i < 2; ++i) {
+        struct ast_Program *program = test_parse(inputs[i]);
+        struct res_Resolver *resolver = res_alloc_resolver(globals);
+        res_resolve_program(resolver, program);
+        ASSERT_EQ(0, stbds_arrlen(resolver->errors_da));
+
+        for (int j = 0; j < 2; ++j) {
+            struct ast_Ident *name =
+                &program->statement_ptrs_da[j]->data.let.name->data.ident;
+            ASSERT_EQ(expected_slots[i][j], name->slot);
+        }
+        res_free_resolver(resolver);
+        ast_free_program(program);
+    }
+    ASSERT_EQ(3, res_scope_num_slots(globals));
+
+    res_free_scope(globals);
+    PASS();
+}
+
+TEST resolver_test_errors(void) {
+    char *input = "let f = fn() { g() };"
+                  "let g = fn() { f() };"
+                  "let r = fn(n) { if (n > 0) { r(n - 1) } else { n } };"
+                  "let h = fn() { let a = fn() { b() }; let b = 1; a() };"
+                  "foobar;";
+    struct ast_Program *program = test_parse(input);
+
+    struct res_Scope *globals = res_alloc_scope(NULL);
+    struct res_Resolver *resolver = res_alloc_resolver(globals);
+    res_resolve_program(resolver, program);
+
+    // globals are defined up front, fns can refer to later ones - locals
+    // must still be defined before the fn literal using them
+    ASSERT_EQ(2, stbds_arrlen(resolver->errors_da));
+    ASSERT_STR_EQ("identifier not found: b", resolver->errors_da[0]);
+    ASSERT_STR_EQ("identifier not found: foobar", resolver->errors_da[1]);
+
+    res_free_resolver(resolver);
+    res_free_scope(globals);
+    ast_free_program(program);
+    PASS();
+}
+
+// the call in the expr stmt at idx in the block
+struct ast_Call *test_block_call(struct ast_Stmt *block, int idx) {
+    struct ast_Stmt *stmt = block->data.block.stmts_da[idx];
+    struct ast_Expr *expr = stmt->tag == ast_RET_STMT ? stmt->data.ret.ret_val
+                                                      : stmt->data.expr.expr;
+    assert(expr->tag == ast_CALL_EXPR);
+    return &expr->data.call;
+}
+
+TEST resolver_test_tail_calls(void) {
+    char *input = "let f = fn(x) {"
+                  "    if (x) { return f(x); f(x) } else { f(x) };"
+                  "    f(x);"
+                  "    let y = f(x);"
+                  "    if (x) { f(x) } else { f(x) }"
+                  "};"
+                  "f(1);";
+    struct ast_Program *program = test_parse(input);
+    struct res_Scope *globals = res_alloc_scope(NULL);
+    struct res_Resolver *resolver = res_alloc_resolver(globals);
+    res_resolve_program(resolver, program);
+    ASSERT_EQ(0, stbds_arrlen(resolver->errors_da));
+
+    struct ast_Stmt *body =
+        program->statement_ptrs_da[0]->data.let.value->data.fn_lit.body;
+    struct ast_Stmt **stmts = body->data.block.stmts_da;
+    struct ast_If *first = &stmts[0]->data.expr.expr->data.ife;
+    struct ast_If *last = &stmts[3]->data.expr.expr->data.ife;
+
+    // returns are tail calls anywhere, the rest only at the end of the body
+    ASSERT(test_block_call(first->conseq, 0)->tail);
+    ASSERT_FALSE(test_block_call(first->conseq, 1)->tail);
+    ASSERT_FALSE(test_block_call(first->alt, 0)->tail);
+    ASSERT_FALSE(test_block_call(body, 1)->tail);
+    ASSERT_FALSE(stmts[2]->data.let.value->data.call.tail);
+    ASSERT(test_block_call(last->conseq, 0)->tail);
+    ASSERT(test_block_call(last->alt, 0)->tail);
+
+    // outside of fns nothing is
+    struct ast_Expr *top = program->statement_ptrs_da[1]->data.expr.expr;
+    ASSERT_FALSE(top->data.call.tail);
+
+    res_free_resolver(resolver);
+    res_free_scope(globals);
+    ast_free_program(program);
+    PASS();
+}
+
+TEST resolver_test_builtin_words(void) {
+    // every builtin name hashes to its own builtin
+    for (int i = 0; i < BUILTIN_COUNT; ++i) {
+        const char *name = builtin_names[i];
+        obj_Object *builtin = builtin_from_keyword(name, strlen(name));
+        ASSERT_EQ(&BUILTIN_OBJECTS[i], builtin);
+    }
+
+    const char *not_builtins[] = { "lens", "pus", "gc", "Len", "let", "x" };
+    for (int i = 0; i < 6; ++i) {
+        const char *name = not_builtins[i];
+        ASSERT_EQ(NULL, builtin_from_keyword(name, strlen(name)));
+    }
+    PASS();
+}
+
+SUITE(resolver_suite) {
+    RUN_TEST(resolver_test_addresses);
+    RUN_TEST(resolver_test_globals);
+    RUN_TEST(resolver_test_errors);
+    RUN_TEST(resolver_test_tail_calls);
+    RUN_TEST(resolver_test_builtin_words);
+}
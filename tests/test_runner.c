@@ -1,8 +1,12 @@
 #include "ast_test.c"
+#include "compiler_test.c"
 #include "eval_test.c"
 #include "lexer_test.c"
 #include "object_test.c"
+#include "optimizer_test.c"
 #include "parser_test.c"
+#include "resolver_test.c"
+#include "vm_test.c"
 
 /* greatest test runner main file */
 
@@ -17,8 +21,14 @@ int main(int argc, char **argv) {
     RUN_SUITE(ast_suite);
     RUN_SUITE(lexer_suite);
     RUN_SUITE(parser_suite);
+    RUN_SUITE(resolver_suite);
     RUN_SUITE(eval_suite);
+    RUN_SUITE(optimizer_suite);
+    RUN_SUITE(eval_optimized_suite);
     RUN_SUITE(obj_suite);
+    RUN_SUITE(compiler_suite);
+    RUN_SUITE(vm_suite);
+    RUN_SUITE(eval_vm_suite);
 
     GREATEST_MAIN_END(); /* display results */
 }
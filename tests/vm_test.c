@@ -0,0 +1,128 @@
+#include "greatest.h"
+
+#include "../src/vm.c"
+#include "eval_test.c"
+
+SUITE(vm_suite);
+
+// the evaluator suite, run on the compiler and vm
+SUITE(eval_vm_suite) {
+    TEST_ENGINE = test_ENGINE_VM;
+    eval_suite();
+    TEST_ENGINE = test_ENGINE_EVAL;
+}
+
+TEST vm_test_inspect(void) {
+    struct {
+        char *input;
+        char *expected;
+    } tests[] = {
+        {
+            "let map = fn(arr, f) {                                     \
+                 let iter = fn(arr, accumulated) {                      \
+                     if (len(arr) == 0) {                               \
+                         return accumulated;                            \
+                     } else {                                           \
+                         return iter(rest(arr), push(accumulated,       \
+                                                     f(first(arr))));   \
+                     }                                                  \
+                 };                                                     \
+                 iter(arr, []);                                         \
+             };                                                         \
+             let double = fn(x) { return x * 2; };                      \
+             map([1, 2, 3, 4], double);",
+            "[2, 4, 6, 8]",
+        },
+        {
+            "let fib = fn(n) {                                          \
+                 if (n < 2) { return n; }                               \
+                 fib(n - 1) + fib(n - 2)                                \
+             };                                                         \
+             fib(15);",
+            "610",
+        },
+        {
+            "let wrapper = fn() {                                       \
+                 let countDown = fn(x) {                                \
+                     if (x == 0) { 0 } else { countDown(x - 1) }        \
+                 };                                                     \
+                 countDown(1);                                          \
+             };                                                         \
+             wrapper();",
+            "0",
+        },
+        {
+            "let newAdderOuter = fn(a, b) {                             \
+                 let c = a + b;                                         \
+                 fn(d) { let e = d + c; fn(f) { e + f; }; };            \
+             };                                                         \
+             newAdderOuter(1, 2)(3)(8);",
+            "14",
+        },
+        { "let x = 1; let x = x + 1; x;", "2" },
+        { "if (true) { let a = 1; }", "null" },
+        { "fn() { }()", "null" },
+        { "fn(a) { a }()", "ERROR: wrong number of arguments: want=1, got=0" },
+        { "1(2)", "ERROR: not a function: 0" },
+        { "if (false) { foo }", "ERROR: identifier not found: foo" },
+        { "let a = 1;", "" },
+    };
+
+    int n = sizeof(tests) / sizeof(tests[0]);
+    for (int i = 0; i < n; ++i) {
+        obj_Object *evaluated = test_eval(tests[i].input);
+        gbString str = obj_object_inspect(evaluated);
+        ASSERT_STR_EQ(tests[i].expected, str != NULL ? str : "");
+    }
+    PASS();
+}
+
+TEST vm_test_global_state(void) {
+    // globals, symbols and constants outlive a single compile like in the repl
+    struct cmp_Symbol_table *symbols = cmp_alloc_global_symbol_table();
+    obj_Object **constants_da = NULL;
+    obj_Object **globals = vm_alloc_globals();
+
+    char *lines[] = {
+        "let a = 5;",
+        "let add = fn(x) { x + a };",
+        "[add(1), len(\"abc\")]",
+    };
+    char *expected[] = { "", "", "[6, 3]" };
+
+    int n = sizeof(lines) / sizeof(lines[0]);
+    for (int i = 0; i < n; ++i) {
+        struct lex_Lexer lexer = lex_Lexer_create(lines[i]);
+        struct par_Parser *parser = par_alloc_parser(&lexer);
+        struct ast_Program *program = ast_alloc_program();
+        par_parse_program(parser, program);
+
+        struct cmp_Compiler *compiler =
+            cmp_alloc_compiler(symbols, constants_da);
+        cmp_compile_program(compiler, program);
+        constants_da = compiler->constants_da;
+        ASSERT_EQ(0, stbds_arrlen(compiler->errors_da));
+
+        struct vm_VM *vm = vm_alloc_vm(cmp_bytecode(compiler), globals);
+        obj_Object *evaluated = vm_run(vm);
+        gbString str = obj_object_inspect(evaluated);
+        ASSERT_STR_EQ(expected[i], str != NULL ? str : "");
+
+        vm_free_vm(vm);
+        cmp_free_compiler(compiler);
+        par_free_parser(parser);
+        ast_free_program(program);
+    }
+
+    free(globals);
+    stbds_arrfree(constants_da);
+    cmp_free_symbol_table(symbols);
+    PASS();
+}
+
+SUITE(vm_suite) {
+    TEST_ENGINE = test_ENGINE_VM;
+    RUN_TEST(vm_test_inspect);
+    TEST_ENGINE = test_ENGINE_EVAL;
+    RUN_TEST(vm_test_global_state);
+}